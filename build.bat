@@ -24,6 +24,91 @@ if %errorlevel% neq 0 (
     exit /b 1
 )
 
+gcc -Wall -Wextra -O3 -fopenmp -c src/gemm.c -o obj/gemm.o
+if %errorlevel% neq 0 (
+    echo Error building gemm.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -c src/vecops.c -o obj/vecops.o
+if %errorlevel% neq 0 (
+    echo Error building vecops.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -c src/workspace.c -o obj/workspace.o
+if %errorlevel% neq 0 (
+    echo Error building workspace.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -c src/random.c -o obj/random.o
+if %errorlevel% neq 0 (
+    echo Error building random.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -c src/quantize.c -o obj/quantize.o
+if %errorlevel% neq 0 (
+    echo Error building quantize.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -c src/sparse.c -o obj/sparse.o
+if %errorlevel% neq 0 (
+    echo Error building sparse.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -c src/cpu.c -o obj/cpu.o
+if %errorlevel% neq 0 (
+    echo Error building cpu.o
+    pause
+    exit /b 1
+)
+
+REM Kernel variants, one per instruction set (picked at runtime, see src/cpu.h)
+gcc -Wall -Wextra -O3 -fopenmp -c src/kernels/kernels_generic.c -o obj/kernels_generic.o
+if %errorlevel% neq 0 (
+    echo Error building kernels_generic.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -msse4.2 -mpopcnt -c src/kernels/kernels_sse42.c -o obj/kernels_sse42.o
+if %errorlevel% neq 0 (
+    echo Error building kernels_sse42.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -msse4.2 -mpopcnt -mavx2 -mfma -mf16c -c src/kernels/kernels_avx2.c -o obj/kernels_avx2.o
+if %errorlevel% neq 0 (
+    echo Error building kernels_avx2.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -msse4.2 -mpopcnt -mavx2 -mfma -mf16c -mavx512f -mavx512bw -mavx512dq -mavx512vl -c src/kernels/kernels_avx512.c -o obj/kernels_avx512.o
+if %errorlevel% neq 0 (
+    echo Error building kernels_avx512.o
+    pause
+    exit /b 1
+)
+
+gcc -Wall -Wextra -O3 -fopenmp -msse4.2 -mpopcnt -mavx2 -mfma -mf16c -mavx512f -mavx512bw -mavx512dq -mavx512vl -mavx512vnni -c src/kernels/kernels_avx512_vnni.c -o obj/kernels_avx512_vnni.o
+if %errorlevel% neq 0 (
+    echo Error building kernels_avx512_vnni.o
+    pause
+    exit /b 1
+)
+
 gcc -Wall -Wextra -O3 -fopenmp -c src/network.c -o obj/network.o
 if %errorlevel% neq 0 (
     echo Error building network.o
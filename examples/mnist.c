@@ -16,12 +16,11 @@ int main() {
     // Conv1: 1 -> 32 channels, 3x3 kernel
     network_add_layer(net, conv2d_layer(1, 32, 3, 1, 1, ACTIVATION_RELU));
     
-    // Conv2: 32 -> 64 channels, 3x3 kernel
-    network_add_layer(net, conv2d_layer(32, 64, 3, 1, 1, ACTIVATION_RELU));
+    // Conv2: 32 -> 64 channels, 3x3 kernel, stride 2
+    network_add_layer(net, conv2d_layer(32, 64, 3, 2, 1, ACTIVATION_RELU));
     
     // Dense layers
-    // After 2 conv layers with padding=1, size is still 28x28
-    // After pooling (not implemented yet), size becomes 14x14
+    // Conv1 keeps 28x28 (padding=1); the stride of conv2 halves it to 14x14
     // So: 14 * 14 * 64 = 12544
     network_add_layer(net, dense_layer(12544, 128, ACTIVATION_RELU));
     network_add_layer(net, dense_layer(128, 64, ACTIVATION_RELU));
@@ -29,13 +28,13 @@ int main() {
     
     // Set optimizer
     Optimizer* adam = adam_optimizer(0.001, 0.9, 0.999, 1e-8);
-    network_set_optimizer(net, adam);
+    network_compile(net, adam, 0.0f);
     
     printf("Network created successfully!\n");
     printf("Architecture:\n");
     printf("  Input: 1x28x28\n");
     printf("  Conv1: 32x28x28 (3x3 kernel, padding=1)\n");
-    printf("  Conv2: 64x28x28 (3x3 kernel, padding=1)\n");
+    printf("  Conv2: 64x14x14 (3x3 kernel, stride=2, padding=1)\n");
     printf("  Dense1: 128 neurons\n");
     printf("  Dense2: 64 neurons\n");
     printf("  Output: 10 neurons (softmax)\n");
@@ -53,10 +52,10 @@ int main() {
     for (int i = 0; i < 100; i++) {
         float sum = 0.0f;
         for (int j = 0; j < 10; j++) {
-            sum += train_labels->data[i * 10 + j];
+            sum += train_labels->data[i * train_labels->stride + j];
         }
         for (int j = 0; j < 10; j++) {
-            train_labels->data[i * 10 + j] /= sum;
+            train_labels->data[i * train_labels->stride + j] /= sum;
         }
     }
     
@@ -57,10 +57,10 @@ int main() {
     for (int i = 0; i < 50; i++) {
         float sum = 0.0f;
         for (int j = 0; j < 50; j++) {
-            sum += train_labels->data[i * 50 + j];
+            sum += train_labels->data[i * train_labels->stride + j];
         }
         for (int j = 0; j < 50; j++) {
-            train_labels->data[i * 50 + j] /= sum;
+            train_labels->data[i * train_labels->stride + j] /= sum;
         }
     }
     
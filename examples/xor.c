@@ -41,6 +41,7 @@ int main() {
     }
     
     // Test the network
+    network_set_training(net, 0);
     Matrix* output = network_forward(net, inputs);
     printf("\nFinal predictions:\n");
     matrix_print(output, "Output");
@@ -1,220 +1,377 @@
 #include "activation.h"
+#include "../parallel.h"
+#include "../kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <assert.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// Elements per parallel work item when activating a contiguous matrix
+#define ACTIVATION_CHUNK 1024
+
 // Activation function names
 static const char* activation_names[] = {
     "none", "sigmoid", "relu", "tanh", "softmax", 
     "leaky_relu", "elu", "selu", "swish", "mish", "gelu"
 };
 
-void activate(Matrix* m, ActivationType activation) {
-    switch (activation) {
-        case ACTIVATION_SIGMOID:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = 1.0f / (1.0f + expf(-m->data[i]));
-            }
-            break;
-            
-        case ACTIVATION_RELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = m->data[i] > 0 ? m->data[i] : 0;
-            }
-            break;
-            
-        case ACTIVATION_TANH:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = tanhf(m->data[i]);
+static const char* precision_names[] = {"precise", "accurate", "fast"};
+static int activation_precision = -1;  // -1: not read from the environment yet
+
+void activation_set_precision(VecMathPrecision precision) {
+    activation_precision = precision;
+}
+
+VecMathPrecision activation_get_precision(void) {
+    if (activation_precision < 0) {
+        int precision = VEC_MATH_ACCURATE;
+        const char* env = getenv("NEUROFORGE_ACTIVATION_PRECISION");
+        if (env && *env) {
+            int requested = -1;
+            for (int i = 0; i <= VEC_MATH_FAST; i++) {
+                if (strcmp(env, precision_names[i]) == 0) requested = i;
             }
-            break;
-            
-        case ACTIVATION_SOFTMAX: {
-            // For numerical stability, subtract the max value
-            for (size_t row = 0; row < m->rows; row++) {
-                float* row_data = &m->data[row * m->stride];
-                float max_val = row_data[0];
-                
-                for (size_t col = 1; col < m->cols; col++) {
-                    if (row_data[col] > max_val) {
-                        max_val = row_data[col];
-                    }
-                }
-                
-                float sum = 0;
-                for (size_t col = 0; col < m->cols; col++) {
-                    row_data[col] = expf(row_data[col] - max_val);
-                    sum += row_data[col];
-                }
-                
-                for (size_t col = 0; col < m->cols; col++) {
-                    row_data[col] /= sum;
-                }
+            if (requested < 0) {
+                fprintf(stderr, "Unknown NEUROFORGE_ACTIVATION_PRECISION: %s\n", env);
+            } else {
+                precision = requested;
             }
-            break;
         }
-            
-        case ACTIVATION_LEAKY_RELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = m->data[i] > 0 ? m->data[i] : 0.01f * m->data[i];
-            }
-            break;
-            
-        case ACTIVATION_ELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = m->data[i] > 0 ? m->data[i] : 1.0f * (expf(m->data[i]) - 1);
-            }
-            break;
-            
-        case ACTIVATION_SELU: {
-            float scale = 1.0507009873554804934193349852946f;  // λ
-            float alpha = 1.6732632423543772848170429916717f;  // α
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = m->data[i] > 0 ? scale * m->data[i] : scale * alpha * (expf(m->data[i]) - 1);
-            }
-            break;
+        activation_precision = precision;
+    }
+    return (VecMathPrecision)activation_precision;
+}
+
+void activate_array(float* x, size_t n, ActivationType activation) {
+    kernels()->activate(x, n, activation, activation_get_precision());
+}
+
+// log sum_j e^x[j], from the online (max, sum) statistics of the row
+static float softmax_log_sum(const KernelTable* table, const float* x, size_t n,
+                             VecMathPrecision precision) {
+    float max_val, sum;
+    table->softmax_stats(x, n, precision, &max_val, &sum);
+    return max_val + logf(sum);
+}
+
+static void softmax_rows(Matrix* m) {
+    const KernelTable* table = kernels();
+    VecMathPrecision precision = activation_get_precision();
+    
+    // e^(x - log sum e^x): the max is folded into the log-sum, so the row
+    // needs no separate max and normalization passes
+    #pragma omp parallel for if (m->rows * m->cols > NN_PARALLEL_THRESHOLD_HEAVY)
+    for (size_t row = 0; row < m->rows; row++) {
+        float* row_data = &m->data[row * m->stride];
+        float log_sum = softmax_log_sum(table, row_data, m->cols, precision);
+        table->vec_add_scalar(row_data, -log_sum, m->cols);
+        table->vec_exp(row_data, m->cols, precision);
+    }
+}
+
+void activate(Matrix* m, ActivationType activation) {
+    if (activation == ACTIVATION_NONE) return;
+    
+    if (activation == ACTIVATION_SOFTMAX) {
+        softmax_rows(m);
+        return;
+    }
+    
+    size_t n = m->rows * m->cols;
+    size_t threshold = (activation == ACTIVATION_RELU || activation == ACTIVATION_LEAKY_RELU)
+                           ? NN_PARALLEL_THRESHOLD : NN_PARALLEL_THRESHOLD_HEAVY;
+    
+    if (matrix_is_contiguous(m)) {
+        // Contiguous: split the flat range so even a single wide row is shared
+        #pragma omp parallel for if (n > threshold)
+        for (size_t start = 0; start < n; start += ACTIVATION_CHUNK) {
+            size_t len = n - start < ACTIVATION_CHUNK ? n - start : ACTIVATION_CHUNK;
+            activate_array(m->data + start, len, activation);
+        }
+    } else {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t i = 0; i < m->rows; i++) {
+            activate_array(m->data + i * m->stride, m->cols, activation);
         }
-            
-        case ACTIVATION_SWISH:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                m->data[i] = m->data[i] / (1.0f + expf(-m->data[i]));
-            }
-            break;
-            
-        case ACTIVATION_MISH:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float x = m->data[i];
-                m->data[i] = x * tanhf(logf(1.0f + expf(x)));
-            }
-            break;
-            
-        case ACTIVATION_GELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float x = m->data[i];
-                m->data[i] = 0.5f * x * (1.0f + tanhf(sqrtf(2.0f / M_PI) * (x + 0.044715f * x * x * x)));
-            }
-            break;
-            
-        case ACTIVATION_NONE:
-        default:
-            // No activation applied
-            break;
     }
 }
 
 void activate_derivative(const Matrix* m, Matrix* grad, ActivationType activation) {
+    if (activation == ACTIVATION_NONE || activation == ACTIVATION_SOFTMAX) return;
+    
+    const KernelTable* table = kernels();
+    VecMathPrecision precision = activation_get_precision();
+    size_t n = m->rows * m->cols;
+    size_t threshold = (activation == ACTIVATION_RELU || activation == ACTIVATION_LEAKY_RELU)
+                           ? NN_PARALLEL_THRESHOLD : NN_PARALLEL_THRESHOLD_HEAVY;
+    
+    if (matrix_is_contiguous(m) && matrix_is_contiguous(grad)) {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t start = 0; start < n; start += ACTIVATION_CHUNK) {
+            size_t len = n - start < ACTIVATION_CHUNK ? n - start : ACTIVATION_CHUNK;
+            table->activate_derivative(m->data + start, grad->data + start, len, activation,
+                                       precision);
+        }
+    } else {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t i = 0; i < m->rows; i++) {
+            table->activate_derivative(m->data + i * m->stride, grad->data + i * grad->stride,
+                                       m->cols, activation, precision);
+        }
+    }
+}
+
+ActivationBackward activation_backward_needs(ActivationType activation) {
     switch (activation) {
-        case ACTIVATION_SIGMOID:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float s = 1.0f / (1.0f + expf(-m->data[i]));
-                grad->data[i] *= s * (1 - s);
-            }
-            break;
-            
         case ACTIVATION_RELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                grad->data[i] *= m->data[i] > 0 ? 1 : 0;
-            }
-            break;
-            
-        case ACTIVATION_TANH:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float t = tanhf(m->data[i]);
-                grad->data[i] *= 1 - t * t;
-            }
-            break;
-            
         case ACTIVATION_LEAKY_RELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                grad->data[i] *= m->data[i] > 0 ? 1 : 0.01f;
-            }
-            break;
-            
+            return ACTIVATION_BACKWARD_MASK;
+        case ACTIVATION_SIGMOID:
+        case ACTIVATION_TANH:
         case ACTIVATION_ELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                grad->data[i] *= m->data[i] > 0 ? 1 : 1.0f * expf(m->data[i]);
-            }
-            break;
-            
-        case ACTIVATION_SELU: {
-            float scale = 1.0507009873554804934193349852946f;
-            float alpha = 1.6732632423543772848170429916717f;
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                grad->data[i] *= m->data[i] > 0 ? scale : scale * alpha * expf(m->data[i]);
-            }
-            break;
-        }
-            
+        case ACTIVATION_SELU:
+            return ACTIVATION_BACKWARD_OUTPUT;
         case ACTIVATION_SWISH:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float x = m->data[i];
-                float sigmoid = 1.0f / (1.0f + expf(-x));
-                grad->data[i] *= sigmoid + x * sigmoid * (1 - sigmoid);
-            }
-            break;
-            
         case ACTIVATION_MISH:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float x = m->data[i];
-                float omega = 4.0f * (x + 1) + 4.0f * expf(2.0f * x) + expf(3.0f * x) + expf(x) * (4.0f * x + 6.0f);
-                float delta = 2.0f * expf(x) + expf(2.0f * x) + 2.0f;
-                float derivative = expf(x) * omega / (delta * delta);
-                grad->data[i] *= derivative;
-            }
-            break;
-            
         case ACTIVATION_GELU:
-            for (size_t i = 0; i < m->rows * m->cols; i++) {
-                float x = m->data[i];
-                float cdf = 0.5f * (1.0f + tanhf(sqrtf(2.0f / M_PI) * (x + 0.044715f * x * x * x)));
-                float pdf = expf(-0.5f * x * x) / sqrtf(2.0f * M_PI);
-                float derivative = cdf + x * pdf;
-                grad->data[i] *= derivative;
-            }
+            return ACTIVATION_BACKWARD_INPUT;
+        default:
+            return ACTIVATION_BACKWARD_NONE;
+    }
+}
+
+ActivationMask* activation_mask_ensure(ActivationMask* mask, size_t rows, size_t cols) {
+    size_t stride = (cols + 63) / 64;
+    if (!mask) {
+        mask = (ActivationMask*)calloc(1, sizeof(ActivationMask));
+    }
+    if (!mask->bits || rows * stride > mask->rows * mask->stride) {
+        free(mask->bits);
+        mask->bits = (uint64_t*)calloc(rows * stride + 1, sizeof(uint64_t));
+    }
+    mask->rows = rows;
+    mask->cols = cols;
+    mask->stride = stride;
+    return mask;
+}
+
+void activation_mask_free(ActivationMask* mask) {
+    if (!mask) return;
+    free(mask->bits);
+    free(mask);
+}
+
+void activation_mask_store(ActivationMask* mask, const Matrix* m) {
+    assert(mask->rows == m->rows && mask->cols == m->cols);
+    
+    const KernelTable* table = kernels();
+    #pragma omp parallel for if (m->rows * m->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t i = 0; i < m->rows; i++) {
+        table->activation_mask_pack(m->data + i * m->stride, mask->bits + i * mask->stride,
+                                    m->cols);
+    }
+}
+
+void activate_derivative_mask(const ActivationMask* mask, Matrix* grad,
+                              ActivationType activation) {
+    assert(mask->rows == grad->rows && mask->cols == grad->cols);
+    
+    float negative_slope = activation == ACTIVATION_LEAKY_RELU ? 0.01f : 0.0f;
+    const KernelTable* table = kernels();
+    #pragma omp parallel for if (grad->rows * grad->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t i = 0; i < grad->rows; i++) {
+        table->activate_derivative_mask(mask->bits + i * mask->stride,
+                                        grad->data + i * grad->stride, grad->cols,
+                                        negative_slope);
+    }
+}
+
+void activate_derivative_output(const Matrix* output, Matrix* grad, ActivationType activation) {
+    if (activation_backward_needs(activation) != ACTIVATION_BACKWARD_OUTPUT) return;
+    
+    const KernelTable* table = kernels();
+    size_t n = output->rows * output->cols;
+    
+    if (matrix_is_contiguous(output) && matrix_is_contiguous(grad)) {
+        #pragma omp parallel for if (n > NN_PARALLEL_THRESHOLD)
+        for (size_t start = 0; start < n; start += ACTIVATION_CHUNK) {
+            size_t len = n - start < ACTIVATION_CHUNK ? n - start : ACTIVATION_CHUNK;
+            table->activate_derivative_output(output->data + start, grad->data + start, len,
+                                              activation);
+        }
+    } else {
+        #pragma omp parallel for if (n > NN_PARALLEL_THRESHOLD)
+        for (size_t i = 0; i < output->rows; i++) {
+            table->activate_derivative_output(output->data + i * output->stride,
+                                              grad->data + i * grad->stride, output->cols,
+                                              activation);
+        }
+    }
+}
+
+void activate_derivative_saved(ActivationType activation, const Matrix* pre_activation,
+                               const Matrix* output, const ActivationMask* mask, Matrix* grad) {
+    switch (activation_backward_needs(activation)) {
+        case ACTIVATION_BACKWARD_MASK:
+            if (mask) activate_derivative_mask(mask, grad, activation);
+            break;
+        case ACTIVATION_BACKWARD_OUTPUT:
+            if (output) activate_derivative_output(output, grad, activation);
             break;
-            
-        case ACTIVATION_SOFTMAX:
-            // For softmax, the derivative is usually combined with cross-entropy loss
-            // So we don't implement it separately here
+        case ACTIVATION_BACKWARD_INPUT:
+            if (pre_activation) activate_derivative(pre_activation, grad, activation);
             break;
-            
-        case ACTIVATION_NONE:
         default:
-            // No derivative applied
             break;
     }
 }
 
-float cross_entropy_loss(const Matrix* output, const Matrix* target) {
-    float loss = 0;
-    for (size_t i = 0; i < output->rows; i++) {
-        for (size_t j = 0; j < output->cols; j++) {
-            size_t idx = i * output->stride + j;
-            loss += -target->data[idx] * logf(output->data[idx] + 1e-10f);
+// Losses are reduced per row: each row is summed in float, then rows are
+// accumulated in double and the ranges combined through matrix_reduce
+typedef struct {
+    const Matrix* output;
+    const Matrix* target;
+} LossArgs;
+
+static float cross_entropy_rows(size_t begin, size_t end, const void* ctx) {
+    const LossArgs* args = (const LossArgs*)ctx;
+    double loss = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        const float* y_hat = args->output->data + i * args->output->stride;
+        const float* y = args->target->data + i * args->target->stride;
+        float row = 0.0f;
+        for (size_t j = 0; j < args->output->cols; j++) {
+            row += -y[j] * logf(y_hat[j] + 1e-10f);
+        }
+        loss += row;
+    }
+    return (float)loss;
+}
+
+static float squared_error_rows(size_t begin, size_t end, const void* ctx) {
+    const LossArgs* args = (const LossArgs*)ctx;
+    double loss = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        const float* y_hat = args->output->data + i * args->output->stride;
+        const float* y = args->target->data + i * args->target->stride;
+        float row = 0.0f;
+        for (size_t j = 0; j < args->output->cols; j++) {
+            float diff = y_hat[j] - y[j];
+            row += diff * diff;
         }
+        loss += row;
     }
+    return (float)loss;
+}
+
+static float binary_cross_entropy_rows(size_t begin, size_t end, const void* ctx) {
+    const LossArgs* args = (const LossArgs*)ctx;
+    double loss = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        const float* out_row = args->output->data + i * args->output->stride;
+        const float* target_row = args->target->data + i * args->target->stride;
+        float row = 0.0f;
+        for (size_t j = 0; j < args->output->cols; j++) {
+            float y = target_row[j];
+            float y_hat = out_row[j];
+            row += -y * logf(y_hat + 1e-10f) - (1 - y) * logf(1 - y_hat + 1e-10f);
+        }
+        loss += row;
+    }
+    return (float)loss;
+}
+
+typedef struct {
+    const Matrix* logits;
+    const Matrix* target;  // One-hot (or soft) targets, or NULL
+    const int* labels;     // Class of every row when target is NULL
+    Matrix* grad;          // May be NULL
+    const KernelTable* table;
+    VecMathPrecision precision;
+} SoftmaxLossArgs;
+
+// Loss of each row from its log-sum L: -sum_j y[j] (x[j] - L), or L - x[c]
+// for a label c. The gradient row softmax(x) - y is e^(x - L) - y.
+static float softmax_cross_entropy_rows(size_t begin, size_t end, const void* ctx) {
+    const SoftmaxLossArgs* args = (const SoftmaxLossArgs*)ctx;
+    size_t cols = args->logits->cols;
+    double loss = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        const float* x = args->logits->data + i * args->logits->stride;
+        float log_sum = softmax_log_sum(args->table, x, cols, args->precision);
+        
+        const float* y = NULL;
+        int label = 0;
+        if (args->target) {
+            y = args->target->data + i * args->target->stride;
+            float mass = 0.0f, dot = 0.0f;
+            for (size_t j = 0; j < cols; j++) {
+                mass += y[j];
+                dot += y[j] * x[j];
+            }
+            loss += log_sum * mass - dot;
+        } else {
+            label = args->labels[i];
+            assert(label >= 0 && (size_t)label < cols);
+            loss += log_sum - x[label];
+        }
+        
+        if (args->grad) {
+            float* g = args->grad->data + i * args->grad->stride;
+            args->table->vec_copy(g, x, cols);
+            args->table->vec_add_scalar(g, -log_sum, cols);
+            args->table->vec_exp(g, cols, args->precision);
+            if (y) {
+                args->table->vec_sub(g, y, cols);
+            } else {
+                g[label] -= 1.0f;
+            }
+        }
+    }
+    return (float)loss;
+}
+
+static float softmax_cross_entropy_run(SoftmaxLossArgs* args) {
+    const Matrix* logits = args->logits;
+    assert(!args->grad || (args->grad->rows == logits->rows && args->grad->cols == logits->cols));
+    args->table = kernels();
+    args->precision = activation_get_precision();
+    
+    float loss = matrix_reduce(logits->rows, logits->cols, softmax_cross_entropy_rows, args);
+    return loss / logits->rows;
+}
+
+float softmax_cross_entropy(const Matrix* logits, const Matrix* target, Matrix* grad) {
+    assert(target->rows == logits->rows && target->cols == logits->cols);
+    SoftmaxLossArgs args = {logits, target, NULL, grad, NULL, VEC_MATH_ACCURATE};
+    return softmax_cross_entropy_run(&args);
+}
+
+float softmax_cross_entropy_labels(const Matrix* logits, const int* labels, Matrix* grad) {
+    SoftmaxLossArgs args = {logits, NULL, labels, grad, NULL, VEC_MATH_ACCURATE};
+    return softmax_cross_entropy_run(&args);
+}
+
+float cross_entropy_loss(const Matrix* output, const Matrix* target) {
+    LossArgs args = {output, target};
+    float loss = matrix_reduce(output->rows, output->cols, cross_entropy_rows, &args);
     return loss / output->rows;
 }
 
 float mse_loss(const Matrix* output, const Matrix* target) {
-    float loss = 0;
-    for (size_t i = 0; i < output->rows * output->cols; i++) {
-        float diff = output->data[i] - target->data[i];
-        loss += diff * diff;
-    }
+    LossArgs args = {output, target};
+    float loss = matrix_reduce(output->rows, output->cols, squared_error_rows, &args);
     return loss / (output->rows * output->cols);
 }
 
 float binary_cross_entropy_loss(const Matrix* output, const Matrix* target) {
-    float loss = 0;
-    for (size_t i = 0; i < output->rows * output->cols; i++) {
-        float y = target->data[i];
-        float y_hat = output->data[i];
-        loss += -y * logf(y_hat + 1e-10f) - (1 - y) * logf(1 - y_hat + 1e-10f);
-    }
+    LossArgs args = {output, target};
+    float loss = matrix_reduce(output->rows, output->cols, binary_cross_entropy_rows, &args);
     return loss / (output->rows * output->cols);
 }
 
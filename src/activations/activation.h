@@ -1,7 +1,9 @@
 #ifndef ACTIVATION_H
 #define ACTIVATION_H
 
+#include <stdint.h>
 #include "../matrix.h"
+#include "../vecops.h"
 
 // Activation function types
 typedef enum {
@@ -27,6 +29,18 @@ typedef enum {
  */
 void activate(Matrix* m, ActivationType activation);
 
+/**
+ * @brief Apply an elementwise activation function to a contiguous array in-place
+ * 
+ * Used by fused kernels that activate a tile while it is still in cache.
+ * Softmax is row-wise and is left untouched; apply it with activate().
+ * 
+ * @param x Values to activate
+ * @param n Number of values
+ * @param activation Type of activation function to apply
+ */
+void activate_array(float* x, size_t n, ActivationType activation);
+
 /**
  * @brief Apply derivative of activation function to gradient matrix in-place
  * 
@@ -36,6 +50,118 @@ void activate(Matrix* m, ActivationType activation);
  */
 void activate_derivative(const Matrix* m, Matrix* grad, ActivationType activation);
 
+// What the backward pass of an activation needs to keep from the forward pass
+typedef enum {
+    ACTIVATION_BACKWARD_NONE,    // Nothing (linear; softmax is combined with the loss)
+    ACTIVATION_BACKWARD_MASK,    // The sign of the input, one bit per element (ReLU family)
+    ACTIVATION_BACKWARD_OUTPUT,  // The output: f' is a function of f (sigmoid, tanh, ELU, SELU)
+    ACTIVATION_BACKWARD_INPUT    // The pre-activation values (swish, mish, GELU)
+} ActivationBackward;
+
+// One bit per element of a rows x cols matrix. Every row starts on a new
+// word: element j of row i is bit j % 64 of bits[i * stride + j / 64].
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t stride;   // Words per row
+    uint64_t* bits;
+} ActivationMask;
+
+/**
+ * @brief Get what the backward pass of an activation needs
+ * 
+ * @param activation Activation function type
+ * @return ActivationBackward The state to keep from the forward pass
+ */
+ActivationBackward activation_backward_needs(ActivationType activation);
+
+/**
+ * @brief Resize a mask, reusing its storage when it is large enough
+ * 
+ * @param mask Existing mask or NULL
+ * @param rows Number of rows
+ * @param cols Number of columns
+ * @return ActivationMask* The mask to use from now on
+ */
+ActivationMask* activation_mask_ensure(ActivationMask* mask, size_t rows, size_t cols);
+
+/**
+ * @brief Free a mask (NULL is ignored)
+ * 
+ * @param mask Mask to free
+ */
+void activation_mask_free(ActivationMask* mask);
+
+/**
+ * @brief Record where the elements of a matrix are positive
+ * 
+ * For ReLU and leaky ReLU the output is positive exactly where the input
+ * is, so the mask can be taken from either.
+ * 
+ * @param mask Mask of the same shape as m
+ * @param m Values to test
+ */
+void activation_mask_store(ActivationMask* mask, const Matrix* m);
+
+/**
+ * @brief Apply the derivative of a ReLU-family activation from its mask
+ * 
+ * @param mask Signs recorded by activation_mask_store()
+ * @param grad Gradient matrix to modify
+ * @param activation ACTIVATION_RELU or ACTIVATION_LEAKY_RELU
+ */
+void activate_derivative_mask(const ActivationMask* mask, Matrix* grad,
+                              ActivationType activation);
+
+/**
+ * @brief Apply the derivative of an activation from its output
+ * 
+ * For the activations with ACTIVATION_BACKWARD_OUTPUT; the others are left
+ * untouched.
+ * 
+ * @param output Activation output f(z)
+ * @param grad Gradient matrix to modify
+ * @param activation Type of activation function
+ */
+void activate_derivative_output(const Matrix* output, Matrix* grad, ActivationType activation);
+
+/**
+ * @brief Apply the derivative of an activation from what its forward pass kept
+ * 
+ * Picks the mask, the output or the pre-activation values according to
+ * activation_backward_needs(); nothing happens if the one needed is NULL.
+ * 
+ * @param activation Type of activation function
+ * @param pre_activation Pre-activation values (ACTIVATION_BACKWARD_INPUT)
+ * @param output Activation output (ACTIVATION_BACKWARD_OUTPUT)
+ * @param mask Signs of the output (ACTIVATION_BACKWARD_MASK)
+ * @param grad Gradient matrix to modify
+ */
+void activate_derivative_saved(ActivationType activation, const Matrix* pre_activation,
+                               const Matrix* output, const ActivationMask* mask, Matrix* grad);
+
+/**
+ * @brief Set the accuracy of the exponentials behind the activations
+ * 
+ * Applies to activate(), activate_array() and activate_derivative() of
+ * sigmoid, tanh, ELU, SELU, swish, mish, GELU and softmax.
+ * VEC_MATH_ACCURATE (the default) uses vectorized polynomials within ~1e-6
+ * relative error of libm, VEC_MATH_FAST shorter ones within ~1e-3, and
+ * VEC_MATH_PRECISE calls libm per element. The environment variable
+ * NEUROFORGE_ACTIVATION_PRECISION (precise, accurate or fast) sets the
+ * initial value.
+ * 
+ * @param precision Accuracy tier
+ */
+void activation_set_precision(VecMathPrecision precision);
+
+/**
+ * @brief Get the accuracy tier used by the activations
+ * 
+ * @return VecMathPrecision Current tier
+ */
+VecMathPrecision activation_get_precision(void);
+
 /**
  * @brief Calculate cross-entropy loss between output and target
  * 
@@ -63,6 +189,35 @@ float mse_loss(const Matrix* output, const Matrix* target);
  */
 float binary_cross_entropy_loss(const Matrix* output, const Matrix* target);
 
+/**
+ * @brief Softmax cross-entropy computed from logits, with its gradient
+ * 
+ * Equivalent to softmax followed by cross_entropy_loss(), but the loss
+ * comes from log-sum-exp of the logits (one pass over each row with an
+ * online max and sum) and the gradient softmax(logits) - target is written
+ * in the same sweep. Like network_backward(), the gradient is not divided
+ * by the batch size.
+ * 
+ * @param logits Pre-softmax values, one row per sample
+ * @param target Target distributions (one-hot encoded)
+ * @param grad Gradient w.r.t. the logits, same shape as logits (may be NULL)
+ * @return float Mean cross-entropy loss over the rows
+ */
+float softmax_cross_entropy(const Matrix* logits, const Matrix* target, Matrix* grad);
+
+/**
+ * @brief Softmax cross-entropy from logits against class labels
+ * 
+ * Same as softmax_cross_entropy() with target row i one-hot at labels[i],
+ * without building the one-hot matrix.
+ * 
+ * @param logits Pre-softmax values, one row per sample
+ * @param labels Class index of every row, in [0, logits->cols)
+ * @param grad Gradient w.r.t. the logits, same shape as logits (may be NULL)
+ * @return float Mean cross-entropy loss over the rows
+ */
+float softmax_cross_entropy_labels(const Matrix* logits, const int* labels, Matrix* grad);
+
 /**
  * @brief Get string representation of activation function
  * 
@@ -0,0 +1,382 @@
+#include "conv.h"
+#include "gemm.h"
+#include "parallel.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+ConvGeometry conv_geometry(size_t channels, size_t height, size_t width, size_t filters,
+                           size_t kernel, size_t stride, size_t padding) {
+    assert(kernel > 0 && stride > 0);
+    assert(height + 2 * padding >= kernel && width + 2 * padding >= kernel);
+
+    ConvGeometry g;
+    g.channels = channels;
+    g.height = height;
+    g.width = width;
+    g.filters = filters;
+    g.kernel = kernel;
+    g.stride = stride;
+    g.padding = padding;
+    g.out_height = (height + 2 * padding - kernel) / stride + 1;
+    g.out_width = (width + 2 * padding - kernel) / stride + 1;
+    return g;
+}
+
+// Output coordinates o in [*lo, *hi) whose input coordinate
+// o * stride + tap - padding lies inside [0, in)
+static void conv_valid_range(size_t out, size_t in, size_t stride, size_t padding, size_t tap,
+                             size_t* lo, size_t* hi) {
+    size_t first = tap >= padding ? 0 : (padding - tap + stride - 1) / stride;
+    size_t end = in + padding > tap ? (in + padding - tap + stride - 1) / stride : 0;
+    *hi = end < out ? end : out;
+    *lo = first < *hi ? first : *hi;
+}
+
+// Row (c, ki, kj) of the patch matrix, out_height * out_width values
+static void conv_im2col_row(const ConvGeometry* g, const float* image, size_t c, size_t ki,
+                            size_t kj, float* dst) {
+    size_t y_lo, y_hi, x_lo, x_hi;
+    conv_valid_range(g->out_height, g->height, g->stride, g->padding, ki, &y_lo, &y_hi);
+    conv_valid_range(g->out_width, g->width, g->stride, g->padding, kj, &x_lo, &x_hi);
+
+    const float* plane = image + c * g->height * g->width;
+    for (size_t oy = 0; oy < g->out_height; oy++) {
+        float* out = dst + oy * g->out_width;
+        if (oy < y_lo || oy >= y_hi) {
+            memset(out, 0, g->out_width * sizeof(float));
+            continue;
+        }
+
+        const float* row = plane + (oy * g->stride + ki - g->padding) * g->width;
+        memset(out, 0, x_lo * sizeof(float));
+        if (g->stride == 1) {
+            memcpy(out + x_lo, row + x_lo + kj - g->padding, (x_hi - x_lo) * sizeof(float));
+        } else {
+            for (size_t ox = x_lo; ox < x_hi; ox++) {
+                out[ox] = row[ox * g->stride + kj - g->padding];
+            }
+        }
+        memset(out + x_hi, 0, (g->out_width - x_hi) * sizeof(float));
+    }
+}
+
+// Adds row (c, ki, kj) of a patch matrix back onto the image
+static void conv_col2im_row(const ConvGeometry* g, const float* src, size_t c, size_t ki,
+                            size_t kj, float* image) {
+    size_t y_lo, y_hi, x_lo, x_hi;
+    conv_valid_range(g->out_height, g->height, g->stride, g->padding, ki, &y_lo, &y_hi);
+    conv_valid_range(g->out_width, g->width, g->stride, g->padding, kj, &x_lo, &x_hi);
+
+    float* plane = image + c * g->height * g->width;
+    for (size_t oy = y_lo; oy < y_hi; oy++) {
+        const float* in = src + oy * g->out_width;
+        float* row = plane + (oy * g->stride + ki - g->padding) * g->width;
+        for (size_t ox = x_lo; ox < x_hi; ox++) {
+            row[ox * g->stride + kj - g->padding] += in[ox];
+        }
+    }
+}
+
+void conv_im2col(const ConvGeometry* g, const float* image, float* col) {
+    size_t positions = conv_out_positions(g);
+    for (size_t c = 0; c < g->channels; c++) {
+        for (size_t ki = 0; ki < g->kernel; ki++) {
+            for (size_t kj = 0; kj < g->kernel; kj++) {
+                size_t r = (c * g->kernel + ki) * g->kernel + kj;
+                conv_im2col_row(g, image, c, ki, kj, col + r * positions);
+            }
+        }
+    }
+}
+
+void conv_col2im(const ConvGeometry* g, const float* col, float* image) {
+    size_t positions = conv_out_positions(g);
+    for (size_t c = 0; c < g->channels; c++) {
+        for (size_t ki = 0; ki < g->kernel; ki++) {
+            for (size_t kj = 0; kj < g->kernel; kj++) {
+                size_t r = (c * g->kernel + ki) * g->kernel + kj;
+                conv_col2im_row(g, col + r * positions, c, ki, kj, image);
+            }
+        }
+    }
+}
+
+// Images whose patch matrices fit in CONV_COL_FLOATS (at least one)
+static size_t conv_group_size(const ConvGeometry* g, size_t batch) {
+    size_t per_image = conv_patch_size(g) * conv_out_positions(g);
+    size_t group = per_image > 0 ? CONV_COL_FLOATS / per_image : batch;
+    if (group == 0) group = 1;
+    return group < batch ? group : batch;
+}
+
+// Patch matrices of images n0 .. n0 + count - 1: row r of image n starts at
+// col + n * image_stride + r * ld, so the images can be stacked (ld =
+// positions) or side by side (image_stride = positions)
+static void conv_im2col_group(const ConvGeometry* g, const Matrix* input, size_t n0,
+                              size_t count, float* col, size_t ld, size_t image_stride) {
+    size_t rows = conv_patch_size(g);
+    size_t kk = g->kernel * g->kernel;
+
+    #pragma omp parallel for collapse(2) if (count * rows * conv_out_positions(g) > NN_PARALLEL_THRESHOLD)
+    for (size_t n = 0; n < count; n++) {
+        for (size_t r = 0; r < rows; r++) {
+            const float* image = input->data + (n0 + n) * input->stride;
+            conv_im2col_row(g, image, r / kk, r % kk / g->kernel, r % g->kernel,
+                            col + n * image_stride + r * ld);
+        }
+    }
+}
+
+// Adjoint of conv_im2col_group with image_stride = positions, added onto
+// the rows n0 .. of grad_input
+static void conv_col2im_group(const ConvGeometry* g, const float* col, size_t ld,
+                              Matrix* grad_input, size_t n0, size_t count) {
+    size_t positions = conv_out_positions(g);
+
+    // Taps of one channel add onto the same pixels, so work is split by
+    // image and channel only
+    #pragma omp parallel for collapse(2) if (count * conv_patch_size(g) * positions > NN_PARALLEL_THRESHOLD)
+    for (size_t n = 0; n < count; n++) {
+        for (size_t c = 0; c < g->channels; c++) {
+            float* image = grad_input->data + (n0 + n) * grad_input->stride;
+            for (size_t ki = 0; ki < g->kernel; ki++) {
+                for (size_t kj = 0; kj < g->kernel; kj++) {
+                    size_t r = (c * g->kernel + ki) * g->kernel + kj;
+                    conv_col2im_row(g, col + r * ld + n * positions, c, ki, kj, image);
+                }
+            }
+        }
+    }
+}
+
+void conv_forward_gemm(const ConvGeometry* g, const Matrix* input, const Matrix* weights,
+                       const float* bias, Matrix* output, Workspace* ws) {
+    size_t k = conv_patch_size(g);
+    size_t positions = conv_out_positions(g);
+    size_t batch = input->rows;
+    assert(input->cols == g->channels * g->height * g->width);
+    assert(output->rows == batch && output->cols == g->filters * positions);
+    assert(weights->rows == g->filters && weights->cols == k);
+    assert(weights->dtype == MATRIX_F32);
+
+    // A 1 x 1 convolution with unit stride and no padding multiplies the
+    // image itself: its channels x pixels layout is the patch matrix
+    int pointwise = g->kernel == 1 && g->stride == 1 && g->padding == 0;
+    size_t group = conv_group_size(g, batch);
+    Matrix* col = pointwise ? NULL : workspace_matrix(ws, group, k * positions);
+
+    for (size_t n0 = 0; n0 < batch; n0 += group) {
+        size_t count = batch - n0 < group ? batch - n0 : group;
+        const float* b = input->data + n0 * input->stride;
+        size_t stride_b = input->stride;
+        if (!pointwise) {
+            conv_im2col_group(g, input, n0, count, col->data, positions, col->stride);
+            b = col->data;
+            stride_b = col->stride;
+        }
+
+        // One product per image: filters x positions = weights * patches
+        gemm_sgemm_strided_batched(0, 0, g->filters, positions, k,
+                                   1.0f, weights->data, weights->stride, 0,
+                                   b, positions, stride_b,
+                                   0.0f, output->data + n0 * output->stride, positions,
+                                   output->stride, count);
+    }
+    if (col) matrix_free(col);
+
+    if (!bias) return;
+    const KernelTable* table = kernels();
+    #pragma omp parallel for collapse(2) if (batch * g->filters * positions > NN_PARALLEL_THRESHOLD)
+    for (size_t n = 0; n < batch; n++) {
+        for (size_t f = 0; f < g->filters; f++) {
+            table->vec_add_scalar(output->data + n * output->stride + f * positions, bias[f],
+                                  positions);
+        }
+    }
+}
+
+void conv_backward_gemm(const ConvGeometry* g, const Matrix* input, const Matrix* weights,
+                        const Matrix* output_grad, Matrix* grad_weights, float* grad_bias,
+                        Matrix* grad_input, Workspace* ws) {
+    size_t k = conv_patch_size(g);
+    size_t positions = conv_out_positions(g);
+    size_t batch = input->rows;
+    assert(output_grad->rows == batch && output_grad->cols == g->filters * positions);
+    assert(grad_weights->rows == g->filters && grad_weights->cols == k);
+    assert(!grad_input || (grad_input->rows == batch && grad_input->cols == input->cols));
+
+    // The images of a group are laid side by side, patches as k x
+    // (count * positions) and the output gradient as filters x (count *
+    // positions), so each gradient is one GEMM whose inner dimension runs
+    // over the whole group instead of one small product per image
+    size_t group = conv_group_size(g, batch);
+    size_t ld = group * positions;
+    Matrix* col = workspace_matrix(ws, k, ld);
+    Matrix* dy = workspace_matrix(ws, g->filters, ld);
+    Matrix* dcol = grad_input ? workspace_matrix(ws, k, ld) : NULL;
+    if (grad_input) matrix_fill(grad_input, 0.0f);
+
+    const KernelTable* table = kernels();
+    for (size_t n0 = 0; n0 < batch; n0 += group) {
+        size_t count = batch - n0 < group ? batch - n0 : group;
+        size_t width = count * positions;
+        float beta = n0 == 0 ? 0.0f : 1.0f;
+
+        #pragma omp parallel for collapse(2) if (count * g->filters * positions > NN_PARALLEL_THRESHOLD)
+        for (size_t n = 0; n < count; n++) {
+            for (size_t f = 0; f < g->filters; f++) {
+                memcpy(dy->data + f * dy->stride + n * positions,
+                       output_grad->data + (n0 + n) * output_grad->stride + f * positions,
+                       positions * sizeof(float));
+            }
+        }
+        for (size_t f = 0; f < g->filters; f++) {
+            float sum = table->vec_sum(dy->data + f * dy->stride, width);
+            grad_bias[f] = beta * grad_bias[f] + sum;
+        }
+
+        // grad_weights (+)= dy * patches^T
+        conv_im2col_group(g, input, n0, count, col->data, col->stride, positions);
+        gemm_sgemm(0, 1, g->filters, k, width,
+                   1.0f, dy->data, dy->stride, col->data, col->stride,
+                   beta, grad_weights->data, grad_weights->stride);
+
+        // grad_input = col2im(weights^T * dy)
+        if (grad_input) {
+            gemm_sgemm(1, 0, k, width, g->filters,
+                       1.0f, weights->data, weights->stride, dy->data, dy->stride,
+                       0.0f, dcol->data, dcol->stride);
+            conv_col2im_group(g, dcol->data, dcol->stride, grad_input, n0, count);
+        }
+    }
+
+    matrix_free(col);
+    matrix_free(dy);
+    if (dcol) matrix_free(dcol);
+}
+
+ConvPlan* conv_plan_create(ConvAlgorithm requested, ConvLayout input_layout,
+                           ConvLayout output_layout) {
+    assert(output_layout != CONV_LAYOUT_NCHW || input_layout == CONV_LAYOUT_NCHW);
+    ConvPlan* plan = (ConvPlan*)calloc(1, sizeof(ConvPlan));
+    plan->requested = requested;
+    plan->input_layout = input_layout;
+    plan->output_layout = output_layout;
+    return plan;
+}
+
+void conv_plan_free(ConvPlan* plan) {
+    if (!plan) return;
+    if (plan->filters) matrix_free(plan->filters);
+    free(plan);
+}
+
+static size_t conv_winograd_tile(ConvAlgorithm algorithm) {
+    return algorithm == CONV_ALGO_WINOGRAD_4X4 ? 4 : 2;
+}
+
+static int conv_same_geometry(const ConvGeometry* a, const ConvGeometry* b) {
+    return a->channels == b->channels && a->height == b->height && a->width == b->width &&
+           a->filters == b->filters && a->kernel == b->kernel && a->stride == b->stride &&
+           a->padding == b->padding;
+}
+
+static double conv_seconds(void) {
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Run one algorithm, transforming the filters first if the plan's copy is
+// missing or stale
+static void conv_plan_run(ConvPlan* plan, ConvAlgorithm algorithm, const ConvGeometry* g,
+                          const Matrix* input, const Matrix* weights, const float* bias,
+                          Matrix* output, Workspace* ws) {
+    if (algorithm == CONV_ALGO_IM2COL) {
+        conv_forward_gemm(g, input, weights, bias, output, ws);
+        return;
+    }
+
+    if (algorithm == CONV_ALGO_DIRECT) {
+        size_t in_block = conv_layout_block(plan->input_layout);
+        size_t out_block = conv_layout_block(plan->output_layout);
+        if (!plan->filters_valid || plan->algorithm != algorithm) {
+            plan->filters = matrix_ensure(plan->filters, (g->filters + out_block - 1) / out_block,
+                                          conv_direct_filter_cols(g, in_block, out_block));
+            conv_direct_filters(g, in_block, out_block, weights, plan->filters);
+            plan->algorithm = algorithm;
+            plan->filters_valid = 1;
+        }
+        conv_forward_direct(g, in_block, out_block, input, plan->filters, bias, output);
+        return;
+    }
+
+    size_t m = conv_winograd_tile(algorithm);
+    if (!plan->filters_valid || plan->algorithm != algorithm) {
+        plan->filters = matrix_ensure(plan->filters, conv_winograd_filter_rows(g, m),
+                                      g->channels);
+        conv_winograd_filters(g, m, weights, plan->filters);
+        plan->algorithm = algorithm;
+        plan->filters_valid = 1;
+    }
+    conv_forward_winograd(g, m, input, plan->filters, bias, output, ws);
+}
+
+void conv_plan_forward(ConvPlan* plan, const ConvGeometry* g, const Matrix* input,
+                       const Matrix* weights, const float* bias, Matrix* output,
+                       Workspace* ws) {
+    if (plan->planned && conv_same_geometry(&plan->geometry, g)) {
+        conv_plan_run(plan, plan->algorithm, g, input, weights, bias, output, ws);
+        return;
+    }
+
+    // New geometry: the cached filters and the choice no longer apply
+    plan->geometry = *g;
+    plan->planned = 1;
+    plan->filters_valid = 0;
+
+    ConvAlgorithm choice = plan->requested;
+    if (plan->output_layout != CONV_LAYOUT_NCHW) {
+        choice = CONV_ALGO_DIRECT;
+    } else if (choice == CONV_ALGO_DIRECT) {
+        choice = CONV_ALGO_IM2COL;
+    } else if (choice != CONV_ALGO_IM2COL && !conv_winograd_supported(g)) {
+        choice = CONV_ALGO_IM2COL;
+    } else if (choice == CONV_ALGO_AUTO && matrix_get_deterministic()) {
+        choice = CONV_ALGO_IM2COL;
+    }
+
+    if (choice == CONV_ALGO_AUTO) {
+        // Time every candidate on this batch, the second of two runs so
+        // workspace growth and cold caches are not counted
+        ConvAlgorithm candidates[] = {CONV_ALGO_IM2COL, CONV_ALGO_WINOGRAD_2X2,
+                                      CONV_ALGO_WINOGRAD_4X4};
+        double best = 0.0;
+        for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+            double elapsed = 0.0;
+            for (int run = 0; run < 2; run++) {
+                double start = conv_seconds();
+                conv_plan_run(plan, candidates[i], g, input, weights, bias, output, ws);
+                elapsed = conv_seconds() - start;
+            }
+            if (i == 0 || elapsed < best) {
+                best = elapsed;
+                choice = candidates[i];
+            }
+        }
+    }
+
+    // The plan's filters were last transformed for the final candidate
+    if (choice != plan->algorithm) plan->filters_valid = 0;
+    plan->algorithm = choice;
+    conv_plan_run(plan, choice, g, input, weights, bias, output, ws);
+}
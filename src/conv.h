@@ -0,0 +1,172 @@
+#ifndef CONV_H
+#define CONV_H
+
+#include <stddef.h>
+#include "matrix.h"
+#include "workspace.h"
+
+// Scratch budget for the im2col patch matrices of one group of images, in
+// floats; larger batches are convolved group by group
+#define CONV_COL_FLOATS (4u << 20)
+
+// Geometry of a 2D convolution with square kernels over NCHW images. A
+// batch is a Matrix with one image per row, stored as channels x height x
+// width; the output rows hold filters x out_height x out_width.
+typedef struct {
+    size_t channels;    // Input channels
+    size_t height;
+    size_t width;
+    size_t filters;     // Output channels
+    size_t kernel;      // kernel x kernel taps
+    size_t stride;
+    size_t padding;     // Zero rows/columns added on every side
+    size_t out_height;
+    size_t out_width;
+} ConvGeometry;
+
+ConvGeometry conv_geometry(size_t channels, size_t height, size_t width, size_t filters,
+                           size_t kernel, size_t stride, size_t padding);
+
+// Rows of the patch matrix: one per (channel, kernel row, kernel column)
+static inline size_t conv_patch_size(const ConvGeometry* g) {
+    return g->channels * g->kernel * g->kernel;
+}
+
+// Output positions of one image: the columns of the patch matrix
+static inline size_t conv_out_positions(const ConvGeometry* g) {
+    return g->out_height * g->out_width;
+}
+
+// Patch matrix of one image (conv_patch_size x conv_out_positions): row
+// (c, ki, kj) holds, for every output position, the input pixel under that
+// kernel tap, or 0 where the tap falls into the padding
+void conv_im2col(const ConvGeometry* g, const float* image, float* col);
+
+// Adjoint of conv_im2col: adds every entry of col onto the pixel it was
+// read from (taps in the padding are dropped)
+void conv_col2im(const ConvGeometry* g, const float* col, float* image);
+
+// output = weights * im2col(image) + bias for every image of the batch.
+// weights is filters x conv_patch_size (one row per output channel, taps
+// in (c, ki, kj) order) and bias has one value per filter. The patch
+// matrices of a group of images are built in the workspace (ws may be
+// NULL) and multiplied with one batched GEMM; 1 x 1 convolutions with
+// stride 1 and no padding read the images in place.
+void conv_forward_gemm(const ConvGeometry* g, const Matrix* input, const Matrix* weights,
+                       const float* bias, Matrix* output, Workspace* ws);
+
+// Gradients of conv_forward_gemm for the gradient w.r.t. its output:
+// grad_weights and grad_bias are overwritten with their sums over the
+// batch, and grad_input (if not NULL) receives col2im(weights^T * grad).
+void conv_backward_gemm(const ConvGeometry* g, const Matrix* input, const Matrix* weights,
+                        const Matrix* output_grad, Matrix* grad_weights, float* grad_bias,
+                        Matrix* grad_input, Workspace* ws);
+
+// Winograd F(m x m, 3 x 3): every m x m output tile comes from a
+// (m + 2) x (m + 2) input tile through (m + 2)^2 elementwise products, one
+// batched GEMM over channels per product, instead of 9 m^2 multiplications
+// per channel. Needs a 3 x 3 kernel with stride 1; m is 2 or 4 (F(4x4)
+// saves more multiplications and loses a little more precision).
+int conv_winograd_supported(const ConvGeometry* g);
+
+// Input tile of F(4x4), and the number of tiles transformed together: the
+// kernels hold element e of tile l at [e * CONV_WINOGRAD_LANES + l]
+#define CONV_WINOGRAD_ALPHA_MAX 6
+#define CONV_WINOGRAD_LANES 16
+
+// Rows of conv_winograd_filters' result: (m + 2)^2 * filters
+size_t conv_winograd_filter_rows(const ConvGeometry* g, size_t m);
+
+// Filters in the Winograd domain, u = G w G^T for every (filter, channel):
+// row xi * filters + f of u (conv_winograd_filter_rows x channels) holds
+// element xi of filter f for every channel
+void conv_winograd_filters(const ConvGeometry* g, size_t m, const Matrix* weights, Matrix* u);
+
+// Same result as conv_forward_gemm from filters transformed with
+// conv_winograd_filters for the same m
+void conv_forward_winograd(const ConvGeometry* g, size_t m, const Matrix* input,
+                           const Matrix* u, const float* bias, Matrix* output, Workspace* ws);
+
+// Channel-blocked layouts (NCHWc): an image is stored as ceil(C / c)
+// blocks of c channels, each height x width x c with the c channels of a
+// pixel adjacent, so one SIMD vector holds a pixel's channels. Channels
+// past C in the last block are zero. NCHW is the case c = 1.
+typedef enum {
+    CONV_LAYOUT_NCHW,
+    CONV_LAYOUT_NCHW8C,
+    CONV_LAYOUT_NCHW16C
+} ConvLayout;
+
+static inline size_t conv_layout_block(ConvLayout layout) {
+    return layout == CONV_LAYOUT_NCHW16C ? 16 : layout == CONV_LAYOUT_NCHW8C ? 8 : 1;
+}
+
+// Floats of one image with `channels` channels of `plane` pixels in blocks
+// of `block` channels
+static inline size_t conv_blocked_size(size_t channels, size_t plane, size_t block) {
+    return (channels + block - 1) / block * block * plane;
+}
+
+// The blocked layout matching the selected instruction set: 16 channels
+// with AVX-512, 8 otherwise
+ConvLayout conv_layout_native(void);
+
+// Copy a batch of images with `channels` channels from one layout to
+// another (dst is resized by the caller), zeroing the padding channels
+void conv_layout_convert(size_t channels, ConvLayout from, ConvLayout to, const Matrix* src,
+                         Matrix* dst);
+
+// Direct convolution without im2col, from input in blocks of in_block
+// channels (1, 8 or 16) to output in blocks of out_block channels (8 or
+// 16). Each output block's filters are one row of conv_direct_filters:
+// ceil(channels / in_block) * kernel^2 * in_block * out_block weights,
+// the out_block output channels innermost.
+size_t conv_direct_filter_cols(const ConvGeometry* g, size_t in_block, size_t out_block);
+void conv_direct_filters(const ConvGeometry* g, size_t in_block, size_t out_block,
+                         const Matrix* weights, Matrix* filters);
+void conv_forward_direct(const ConvGeometry* g, size_t in_block, size_t out_block,
+                         const Matrix* input, const Matrix* filters, const float* bias,
+                         Matrix* output);
+
+typedef enum {
+    CONV_ALGO_AUTO,          // Timed on the first batch of each geometry
+    CONV_ALGO_IM2COL,
+    CONV_ALGO_WINOGRAD_2X2,
+    CONV_ALGO_WINOGRAD_4X4,
+    CONV_ALGO_DIRECT         // Blocked output layouts, always
+} ConvAlgorithm;
+
+// Forward algorithm of one convolution and the filters transformed for it.
+// With CONV_ALGO_AUTO each supported algorithm is timed on the first batch
+// of a new geometry and the fastest is kept; deterministic mode (see
+// matrix_set_deterministic) always takes im2col, so results do not depend
+// on timing. A blocked output layout always runs the direct convolution.
+typedef struct {
+    ConvAlgorithm requested;
+    ConvLayout input_layout;   // Layouts of the batches
+    ConvLayout output_layout;
+    ConvAlgorithm algorithm;   // In use for `geometry`
+    ConvGeometry geometry;     // Geometry the choice was made for
+    int planned;               // 0 until the first forward
+    Matrix* filters;           // Weights transformed for `algorithm`, or NULL
+    int filters_valid;         // 0 once the weights may have changed
+} ConvPlan;
+
+// A blocked output layout needs a blocked or NCHW input; NCHW output needs
+// NCHW input
+ConvPlan* conv_plan_create(ConvAlgorithm requested, ConvLayout input_layout,
+                           ConvLayout output_layout);
+void conv_plan_free(ConvPlan* plan);
+
+// The weights changed: transform them again on the next forward
+static inline void conv_plan_invalidate(ConvPlan* plan) {
+    plan->filters_valid = 0;
+}
+
+// conv_forward_gemm through the planned algorithm, on batches in the
+// plan's layouts; an unsupported request falls back to im2col
+void conv_plan_forward(ConvPlan* plan, const ConvGeometry* g, const Matrix* input,
+                       const Matrix* weights, const float* bias, Matrix* output,
+                       Workspace* ws);
+
+#endif // CONV_H
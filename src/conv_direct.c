@@ -0,0 +1,92 @@
+#include "conv.h"
+#include "cpu.h"
+#include "kernels.h"
+#include "parallel.h"
+#include <string.h>
+#include <assert.h>
+
+ConvLayout conv_layout_native(void) {
+    return cpu_get_isa() >= CPU_ISA_AVX512 ? CONV_LAYOUT_NCHW16C : CONV_LAYOUT_NCHW8C;
+}
+
+void conv_layout_convert(size_t channels, ConvLayout from, ConvLayout to, const Matrix* src,
+                         Matrix* dst) {
+    size_t from_block = conv_layout_block(from);
+    size_t to_block = conv_layout_block(to);
+    size_t plane = src->cols / conv_blocked_size(channels, 1, from_block);
+    assert(src->cols == conv_blocked_size(channels, plane, from_block));
+    assert(dst->rows == src->rows && dst->cols == conv_blocked_size(channels, plane, to_block));
+
+    #pragma omp parallel for if (src->rows * src->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t n = 0; n < src->rows; n++) {
+        const float* in = src->data + n * src->stride;
+        float* out = dst->data + n * dst->stride;
+        if (channels % to_block != 0) memset(out, 0, dst->cols * sizeof(float));
+
+        // Channel c of pixel p is at (c / block * plane + p) * block + c % block
+        for (size_t c = 0; c < channels; c++) {
+            const float* s = in + (c / from_block * plane) * from_block + c % from_block;
+            float* d = out + (c / to_block * plane) * to_block + c % to_block;
+            for (size_t p = 0; p < plane; p++) d[p * to_block] = s[p * from_block];
+        }
+    }
+}
+
+size_t conv_direct_filter_cols(const ConvGeometry* g, size_t in_block, size_t out_block) {
+    return conv_blocked_size(g->channels, g->kernel * g->kernel, in_block) * out_block;
+}
+
+void conv_direct_filters(const ConvGeometry* g, size_t in_block, size_t out_block,
+                         const Matrix* weights, Matrix* filters) {
+    size_t k2 = g->kernel * g->kernel;
+    assert(filters->rows == (g->filters + out_block - 1) / out_block);
+    assert(filters->cols == conv_direct_filter_cols(g, in_block, out_block));
+
+    // Row ob, column ((cb * k^2 + tap) * in_block + ci) * out_block + o holds
+    // the weight from channel cb * in_block + ci to filter ob * out_block + o
+    matrix_fill(filters, 0.0f);
+    for (size_t f = 0; f < g->filters; f++) {
+        float* dst = filters->data + f / out_block * filters->stride + f % out_block;
+        const float* w = weights->data + f * weights->stride;
+        for (size_t c = 0; c < g->channels; c++) {
+            for (size_t tap = 0; tap < k2; tap++) {
+                size_t col = ((c / in_block * k2 + tap) * in_block + c % in_block) * out_block;
+                dst[col] = w[c * k2 + tap];
+            }
+        }
+    }
+}
+
+void conv_forward_direct(const ConvGeometry* g, size_t in_block, size_t out_block,
+                         const Matrix* input, const Matrix* filters, const float* bias,
+                         Matrix* output) {
+    size_t positions = conv_out_positions(g);
+    size_t out_blocks = (g->filters + out_block - 1) / out_block;
+    assert(out_block == 8 || out_block == 16);
+    assert(input->cols == conv_blocked_size(g->channels, g->height * g->width, in_block));
+    assert(output->rows == input->rows &&
+           output->cols == conv_blocked_size(g->filters, positions, out_block));
+    assert(filters->rows == out_blocks &&
+           filters->cols == conv_direct_filter_cols(g, in_block, out_block));
+
+    const KernelTable* k = kernels();
+    size_t rows = input->rows * out_blocks * g->out_height;
+
+    // One task per output row of one channel block of one image
+    #pragma omp parallel for schedule(static) if (rows * g->out_width * filters->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t r = 0; r < rows; r++) {
+        size_t oh = r % g->out_height;
+        size_t ob = r / g->out_height % out_blocks;
+        size_t n = r / g->out_height / out_blocks;
+
+        // Bias of the block, zero for the padding channels
+        float b[16] = {0};
+        for (size_t o = 0; o < out_block && ob * out_block + o < g->filters; o++) {
+            b[o] = bias ? bias[ob * out_block + o] : 0.0f;
+        }
+
+        k->conv_direct_row(g, in_block, out_block, input->data + n * input->stride,
+                           filters->data + ob * filters->stride, b,
+                           output->data + n * output->stride + ob * positions * out_block, oh);
+    }
+}
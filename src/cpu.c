@@ -0,0 +1,139 @@
+#include "cpu.h"
+#include "kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_X86 1
+#endif
+
+const KernelTable* kernels_active = NULL;
+static CpuIsa cpu_isa = CPU_ISA_GENERIC;
+
+static const KernelTable* cpu_isa_table(CpuIsa isa) {
+    switch (isa) {
+        case CPU_ISA_GENERIC:     return kernels_generic();
+        case CPU_ISA_SSE42:       return kernels_sse42();
+        case CPU_ISA_AVX2:        return kernels_avx2();
+        case CPU_ISA_AVX512:      return kernels_avx512();
+        case CPU_ISA_AVX512_VNNI: return kernels_avx512_vnni();
+        default:                  return NULL;
+    }
+}
+
+#ifdef CPU_X86
+
+// Register state the OS saves on context switches (XCR0)
+static uint64_t cpu_xgetbv(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Highest level the processor and OS support, whatever the build includes
+static CpuIsa cpu_hardware_isa(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return CPU_ISA_GENERIC;
+
+    // Leaf 1 ECX: SSE4.2 (20), POPCNT (23), FMA (12), OSXSAVE (27), AVX (28), F16C (29)
+    uint32_t sse42 = (1u << 20) | (1u << 23);
+    uint32_t avx = (1u << 12) | (1u << 27) | (1u << 28) | (1u << 29);
+    if ((ecx & sse42) != sse42) return CPU_ISA_GENERIC;
+    if ((ecx & avx) != avx) return CPU_ISA_SSE42;
+
+    // The OS has to save the YMM registers (XCR0 bits 1-2) for AVX code to
+    // survive a context switch, and the opmask and ZMM state (bits 5-7)
+    // for AVX-512
+    uint64_t xcr0 = cpu_xgetbv();
+    if ((xcr0 & 0x6) != 0x6) return CPU_ISA_SSE42;
+
+    if (__get_cpuid_max(0, NULL) < 7) return CPU_ISA_SSE42;
+    unsigned int ebx7, ecx7;
+    __cpuid_count(7, 0, eax, ebx7, ecx7, edx);
+
+    // Leaf 7 EBX: AVX2 (5), AVX512F (16), AVX512DQ (17), AVX512BW (30), AVX512VL (31)
+    if (!(ebx7 & (1u << 5))) return CPU_ISA_SSE42;
+    uint32_t avx512 = (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);
+    if ((ebx7 & avx512) != avx512 || (xcr0 & 0xE6) != 0xE6) return CPU_ISA_AVX2;
+
+    // Leaf 7 ECX: AVX512_VNNI (11)
+    return (ecx7 & (1u << 11)) ? CPU_ISA_AVX512_VNNI : CPU_ISA_AVX512;
+}
+
+#else
+
+static CpuIsa cpu_hardware_isa(void) {
+    return CPU_ISA_GENERIC;
+}
+
+#endif
+
+static int cpu_isa_available(CpuIsa isa) {
+    return isa >= CPU_ISA_GENERIC && isa < CPU_ISA_COUNT &&
+           isa <= cpu_hardware_isa() && cpu_isa_table(isa) != NULL;
+}
+
+CpuIsa cpu_detect_isa(void) {
+    CpuIsa isa = cpu_hardware_isa();
+    while (isa > CPU_ISA_GENERIC && !cpu_isa_table(isa)) {
+        isa = (CpuIsa)(isa - 1);
+    }
+    return isa;
+}
+
+// Detected level, overridable by NEUROFORGE_ISA
+const KernelTable* kernels_select(void) {
+    #pragma omp critical(kernels_select)
+    if (!kernels_active) {
+        CpuIsa isa = cpu_detect_isa();
+
+        const char* env = getenv("NEUROFORGE_ISA");
+        if (env && *env) {
+            int requested = -1;
+            for (int i = 0; i < CPU_ISA_COUNT; i++) {
+                if (strcmp(env, cpu_isa_name((CpuIsa)i)) == 0) requested = i;
+            }
+            if (requested < 0) {
+                fprintf(stderr, "Unknown NEUROFORGE_ISA: %s\n", env);
+            } else if (!cpu_isa_available((CpuIsa)requested)) {
+                fprintf(stderr, "ISA '%s' not supported here, using '%s'\n",
+                        env, cpu_isa_name(isa));
+            } else {
+                isa = (CpuIsa)requested;
+            }
+        }
+
+        cpu_isa = isa;
+        kernels_active = cpu_isa_table(isa);
+    }
+    return kernels_active;
+}
+
+int cpu_set_isa(CpuIsa isa) {
+    kernels();
+    if (!cpu_isa_available(isa)) {
+        return -1;
+    }
+    cpu_isa = isa;
+    kernels_active = cpu_isa_table(isa);
+    return 0;
+}
+
+CpuIsa cpu_get_isa(void) {
+    kernels();
+    return cpu_isa;
+}
+
+const char* cpu_isa_name(CpuIsa isa) {
+    switch (isa) {
+        case CPU_ISA_GENERIC:     return "generic";
+        case CPU_ISA_SSE42:       return "sse4.2";
+        case CPU_ISA_AVX2:        return "avx2";
+        case CPU_ISA_AVX512:      return "avx512";
+        case CPU_ISA_AVX512_VNNI: return "avx512-vnni";
+        default:                  return "unknown";
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Instruction-set levels the hot kernels (GEMM, elementwise operations,
+// activations, int8 and sparse products) are compiled for. Each level
+// implies the ones before it.
+typedef enum {
+    CPU_ISA_GENERIC,      // The compiler's default target (SSE2 on x86-64)
+    CPU_ISA_SSE42,        // SSE4.2 and POPCNT
+    CPU_ISA_AVX2,         // AVX2, FMA and F16C
+    CPU_ISA_AVX512,       // AVX-512 F, BW, DQ and VL
+    CPU_ISA_AVX512_VNNI,  // AVX-512 with VNNI int8 dot products
+    CPU_ISA_COUNT
+} CpuIsa;
+
+// Highest level that both this CPU (and its OS) supports and the build
+// includes. Detected with cpuid; other architectures always get
+// CPU_ISA_GENERIC.
+CpuIsa cpu_detect_isa(void);
+
+// Kernel selection. The level is detected on first use and can be lowered
+// with NEUROFORGE_ISA=generic|sse4.2|avx2|avx512|avx512-vnni, e.g. to test
+// the narrower code paths, and then with cpu_set_isa(). Returns -1 if the
+// CPU does not support the level or the build left it out. Switch levels
+// between calls into the library, not while other threads are in it.
+int cpu_set_isa(CpuIsa isa);
+CpuIsa cpu_get_isa(void);
+const char* cpu_isa_name(CpuIsa isa);
+
+#endif // CPU_H
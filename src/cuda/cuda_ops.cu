@@ -81,7 +81,7 @@ __global__ void cuda_matrix_softmax_kernel(float* m, size_t rows, size_t cols, s
 
 // Allocate matrix on GPU
 void cuda_matrix_alloc(Matrix* m) {
-    CHECK_CUDA(cudaMalloc(&m->data, m->rows * m->cols * sizeof(float)));
+    CHECK_CUDA(cudaMalloc(&m->data, m->rows * m->stride * sizeof(float)));
 }
 
 // Free matrix from GPU
@@ -92,14 +92,14 @@ void cuda_matrix_free(Matrix* m) {
 // Copy matrix from host to device
 void cuda_matrix_copy_to_gpu(const Matrix* host_src, Matrix* device_dst) {
     CHECK_CUDA(cudaMemcpy(device_dst->data, host_src->data, 
-                         host_src->rows * host_src->cols * sizeof(float),
+                         host_src->rows * host_src->stride * sizeof(float),
                          cudaMemcpyHostToDevice));
 }
 
 // Copy matrix from device to host
 void cuda_matrix_copy_to_cpu(const Matrix* device_src, Matrix* host_dst) {
     CHECK_CUDA(cudaMemcpy(host_dst->data, device_src->data,
-                         device_src->rows * device_src->cols * sizeof(float),
+                         device_src->rows * device_src->stride * sizeof(float),
                          cudaMemcpyDeviceToHost));
 }
 
@@ -0,0 +1,734 @@
+#include "gemm.h"
+#include "parallel.h"
+#include "kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef NN_HAVE_CBLAS
+#include <cblas.h>
+#include <limits.h>
+#endif
+
+#ifndef NN_DEFAULT_GEMM_BACKEND
+#define NN_DEFAULT_GEMM_BACKEND MATRIX_GEMM_BUILTIN
+#endif
+
+// Blocking parameters (in elements). KC x NR panels of B stay in L1 while a
+// micro-kernel runs, the MC x KC block of A stays in L2 and the KC x NC
+// block of B is shared through L3.
+#define GEMM_KC 256
+#define GEMM_MC_PANELS 16
+#define GEMM_NC_PANELS 128
+#define GEMM_ALIGNMENT 64
+
+// Below this many multiply-adds packing costs more than it saves
+#define GEMM_SMALL_FLOPS (32 * 32 * 32)
+
+// Below this many multiply-adds a single core finishes before a thread
+// team could be woken up
+#define GEMM_PARALLEL_FLOPS (128 * 128 * 128)
+
+static float* gemm_alloc(size_t count) {
+    void* ptr = NULL;
+#ifdef _WIN32
+    ptr = _aligned_malloc(count * sizeof(float), GEMM_ALIGNMENT);
+#else
+    if (posix_memalign(&ptr, GEMM_ALIGNMENT, count * sizeof(float)) != 0) {
+        ptr = NULL;
+    }
+#endif
+    return (float*)ptr;
+}
+
+static void gemm_release(float* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// Pack buffers are kept between calls so steady-state GEMMs never touch the
+// allocator. One caller at a time owns the cache; a concurrent caller (a GEMM
+// issued from a user thread or an enclosing parallel region) gets its own.
+// The busy flag is taken and released with seq_cst atomics, so the next
+// owner sees the previous owner's writes to gemm_cache and its size.
+static float* gemm_cache = NULL;
+static size_t gemm_cache_count = 0;
+static int gemm_cache_busy = 0;
+
+static float* gemm_acquire(size_t count, int* cached) {
+    int was_busy;
+    #pragma omp atomic capture seq_cst
+    { was_busy = gemm_cache_busy; gemm_cache_busy = 1; }
+
+    if (!was_busy) {
+        if (gemm_cache_count < count) {
+            gemm_release(gemm_cache);
+            gemm_cache = gemm_alloc(count);
+            gemm_cache_count = gemm_cache ? count : 0;
+        }
+        if (gemm_cache) {
+            *cached = 1;
+            return gemm_cache;
+        }
+        #pragma omp atomic write seq_cst
+        gemm_cache_busy = 0;
+    }
+
+    *cached = 0;
+    return gemm_alloc(count);
+}
+
+static void gemm_return(float* ptr, int cached) {
+    if (cached) {
+        #pragma omp atomic write seq_cst
+        gemm_cache_busy = 0;
+    } else {
+        gemm_release(ptr);
+    }
+}
+
+// Address of element `offset` of an operand stored as `type`
+static const void* gemm_offset(const void* p, MatrixDType type, size_t offset) {
+    return (const char*)p + offset * matrix_dtype_size(type);
+}
+
+// Reduced-precision A: rows (or, transposed, columns) of the block are
+// contiguous in memory, so they are widened a whole run at a time
+static void gemm_pack_a_widen(size_t mc, size_t kc, const void* a, MatrixDType type,
+                              size_t lda, int trans, float alpha, float* dst, size_t mr) {
+    float run[GEMM_KC];
+    for (size_t ir = 0; ir < mc; ir += mr) {
+        size_t rows = mc - ir < mr ? mc - ir : mr;
+        if (trans) {
+            for (size_t p = 0; p < kc; p++) {
+                matrix_dtype_to_f32(dst, gemm_offset(a, type, p * lda + ir), type, rows);
+                for (size_t i = 0; i < mr; i++) {
+                    dst[i] = i < rows ? alpha * dst[i] : 0.0f;
+                }
+                dst += mr;
+            }
+        } else {
+            for (size_t i = 0; i < mr; i++) {
+                if (i < rows) {
+                    matrix_dtype_to_f32(run, gemm_offset(a, type, (ir + i) * lda), type, kc);
+                }
+                for (size_t p = 0; p < kc; p++) {
+                    dst[p * mr + i] = i < rows ? alpha * run[p] : 0.0f;
+                }
+            }
+            dst += kc * mr;
+        }
+    }
+}
+
+// Pack an mc x kc block of op(A) into MR-row panels stored column by column,
+// zero-padding the last panel so the micro-kernel never reads out of bounds.
+// alpha is folded in here so the micro-kernel never has to scale.
+static void gemm_pack_a(size_t mc, size_t kc, const void* a_data, MatrixDType type,
+                        size_t lda, int trans, float alpha, float* dst, size_t mr) {
+    if (type != MATRIX_F32) {
+        gemm_pack_a_widen(mc, kc, a_data, type, lda, trans, alpha, dst, mr);
+        return;
+    }
+
+    const float* a = (const float*)a_data;
+    for (size_t ir = 0; ir < mc; ir += mr) {
+        size_t rows = mc - ir < mr ? mc - ir : mr;
+        for (size_t p = 0; p < kc; p++) {
+            size_t i = 0;
+            if (trans) {
+                const float* src = a + p * lda + ir;
+                for (; i < rows; i++) {
+                    dst[i] = alpha * src[i];
+                }
+            } else {
+                const float* src = a + ir * lda + p;
+                for (; i < rows; i++) {
+                    dst[i] = alpha * src[i * lda];
+                }
+            }
+            for (; i < mr; i++) {
+                dst[i] = 0.0f;
+            }
+            dst += mr;
+        }
+    }
+}
+
+// Reduced-precision B, widened a contiguous run at a time like A
+static void gemm_pack_b_widen(size_t kc, size_t nc, const void* b, MatrixDType type,
+                              size_t ldb, int trans, float* dst, size_t nr) {
+    float run[GEMM_KC];
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        size_t cols = nc - jr < nr ? nc - jr : nr;
+        if (trans) {
+            for (size_t j = 0; j < nr; j++) {
+                if (j < cols) {
+                    matrix_dtype_to_f32(run, gemm_offset(b, type, (jr + j) * ldb), type, kc);
+                }
+                for (size_t p = 0; p < kc; p++) {
+                    dst[p * nr + j] = j < cols ? run[p] : 0.0f;
+                }
+            }
+        } else {
+            for (size_t p = 0; p < kc; p++) {
+                matrix_dtype_to_f32(dst + p * nr, gemm_offset(b, type, p * ldb + jr), type, cols);
+                if (cols < nr) {
+                    memset(dst + p * nr + cols, 0, (nr - cols) * sizeof(float));
+                }
+            }
+        }
+        dst += kc * nr;
+    }
+}
+
+// Pack a kc x nc block of op(B) into NR-column panels stored row by row
+static void gemm_pack_b(size_t kc, size_t nc, const void* b_data, MatrixDType type,
+                        size_t ldb, int trans, float* dst, size_t nr) {
+    if (type != MATRIX_F32) {
+        gemm_pack_b_widen(kc, nc, b_data, type, ldb, trans, dst, nr);
+        return;
+    }
+
+    const float* b = (const float*)b_data;
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        size_t cols = nc - jr < nr ? nc - jr : nr;
+        for (size_t p = 0; p < kc; p++) {
+            if (trans) {
+                const float* src = b + jr * ldb + p;
+                for (size_t j = 0; j < cols; j++) {
+                    dst[j] = src[j * ldb];
+                }
+            } else {
+                memcpy(dst, b + p * ldb + jr, cols * sizeof(float));
+            }
+            if (cols < nr) {
+                memset(dst + cols, 0, (nr - cols) * sizeof(float));
+            }
+            dst += nr;
+        }
+    }
+}
+
+// Apply the epilogue to a rows x cols region of C whose top-left element is
+// C(row0, col0); c points at that element
+static void gemm_apply_epilogue(const GemmEpilogue* ep, float* c, size_t ldc,
+                                size_t rows, size_t cols, size_t row0, size_t col0) {
+    for (size_t i = 0; i < rows; i++) {
+        float* crow = c + i * ldc;
+        if (ep->bias) {
+            const float* bias = ep->bias + col0;
+            for (size_t j = 0; j < cols; j++) {
+                crow[j] += bias[j];
+            }
+        }
+        if (ep->pre_activation) {
+            memcpy(ep->pre_activation + (row0 + i) * ep->ld_pre + col0, crow,
+                   cols * sizeof(float));
+        }
+        activate_array(crow, cols, ep->activation);
+    }
+}
+
+// Epilogue as a separate pass, for paths that do not go through the
+// micro-kernel (tiny products, k == 0, external BLAS)
+static void gemm_apply_epilogue_full(const GemmEpilogue* ep, size_t m, size_t n,
+                                     float* c, size_t ldc) {
+    #pragma omp parallel for if (m * n > NN_PARALLEL_THRESHOLD_HEAVY)
+    for (size_t i = 0; i < m; i++) {
+        gemm_apply_epilogue(ep, c + i * ldc, ldc, 1, n, i, 0);
+    }
+}
+
+// Run the micro-kernel over every MR x NR tile of an mc x nc block of C.
+// row0/col0 locate the block in C for the epilogue, which is only applied
+// on the last K block (ep == NULL otherwise).
+static void gemm_macro_kernel(const GemmKernel* uk, size_t mc, size_t nc, size_t kc,
+                              const float* apack, const float* bpack,
+                              float* c, size_t ldc, int accumulate,
+                              const GemmEpilogue* ep, size_t row0, size_t col0) {
+    float tile[KERNEL_GEMM_TILE_MAX] __attribute__((aligned(GEMM_ALIGNMENT)));
+    size_t mr = uk->mr;
+    size_t nr = uk->nr;
+
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        size_t cols = nc - jr < nr ? nc - jr : nr;
+        const float* bp = bpack + jr * kc;
+
+        for (size_t ir = 0; ir < mc; ir += mr) {
+            size_t rows = mc - ir < mr ? mc - ir : mr;
+            const float* ap = apack + ir * kc;
+            float* cp = c + ir * ldc + jr;
+
+            if (rows == mr && cols == nr) {
+                uk->kernel(kc, ap, bp, cp, ldc, accumulate);
+            } else {
+                // Edge tile: compute the full tile into scratch and copy the valid part
+                uk->kernel(kc, ap, bp, tile, nr, 0);
+                for (size_t i = 0; i < rows; i++) {
+                    for (size_t j = 0; j < cols; j++) {
+                        cp[i * ldc + j] = accumulate ? cp[i * ldc + j] + tile[i * nr + j]
+                                                     : tile[i * nr + j];
+                    }
+                }
+            }
+
+            if (ep) {
+                gemm_apply_epilogue(ep, cp, ldc, rows, cols, row0 + ir, col0 + jr);
+            }
+        }
+    }
+}
+
+// C = beta * C, treating beta == 0 as an assignment so NaNs in an
+// uninitialized C do not propagate
+static void gemm_scale_c(size_t m, size_t n, float beta, float* c, size_t ldc) {
+    if (beta == 1.0f) return;
+    for (size_t i = 0; i < m; i++) {
+        float* crow = c + i * ldc;
+        if (beta == 0.0f) {
+            memset(crow, 0, n * sizeof(float));
+        } else {
+            for (size_t j = 0; j < n; j++) {
+                crow[j] *= beta;
+            }
+        }
+    }
+}
+
+// Unpacked loops for tiny products where packing does not pay off
+static void gemm_small(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                       float alpha, const float* a, size_t lda,
+                       const float* b, size_t ldb,
+                       float beta, float* c, size_t ldc) {
+    gemm_scale_c(m, n, beta, c, ldc);
+
+    for (size_t i = 0; i < m; i++) {
+        float* crow = c + i * ldc;
+        if (!trans_b) {
+            // i-k-j: stream rows of B into the row of C
+            for (size_t p = 0; p < k; p++) {
+                float aip = alpha * (trans_a ? a[p * lda + i] : a[i * lda + p]);
+                const float* brow = b + p * ldb;
+                for (size_t j = 0; j < n; j++) {
+                    crow[j] += aip * brow[j];
+                }
+            }
+        } else {
+            // i-j-k: rows of B^T are contiguous, so use dot products
+            for (size_t j = 0; j < n; j++) {
+                const float* bcol = b + j * ldb;
+                float sum = 0.0f;
+                for (size_t p = 0; p < k; p++) {
+                    sum += (trans_a ? a[p * lda + i] : a[i * lda + p]) * bcol[p];
+                }
+                crow[j] += alpha * sum;
+            }
+        }
+    }
+}
+
+// Tiny products with a reduced-precision operand: widen both operands into
+// one temporary float copy and run the unpacked loops on that
+static void gemm_small_widen(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                             float alpha, const void* a, MatrixDType a_type, size_t lda,
+                             const void* b, MatrixDType b_type, size_t ldb,
+                             float beta, float* c, size_t ldc) {
+    size_t a_rows = trans_a ? k : m, a_cols = trans_a ? m : k;
+    size_t b_rows = trans_b ? n : k, b_cols = trans_b ? k : n;
+    float* wa = (float*)malloc((a_rows * a_cols + b_rows * b_cols) * sizeof(float));
+    if (!wa) {
+        fprintf(stderr, "gemm: out of memory widening %s/%s operands\n",
+                matrix_dtype_name(a_type), matrix_dtype_name(b_type));
+        return;
+    }
+    float* wb = wa + a_rows * a_cols;
+
+    for (size_t r = 0; r < a_rows; r++) {
+        matrix_dtype_to_f32(wa + r * a_cols, gemm_offset(a, a_type, r * lda), a_type, a_cols);
+    }
+    for (size_t r = 0; r < b_rows; r++) {
+        matrix_dtype_to_f32(wb + r * b_cols, gemm_offset(b, b_type, r * ldb), b_type, b_cols);
+    }
+    gemm_small(trans_a, trans_b, m, n, k, alpha, wa, a_cols, wb, b_cols, beta, c, ldc);
+    free(wa);
+}
+
+static void gemm_small_any(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                           float alpha, const void* a, MatrixDType a_type, size_t lda,
+                           const void* b, MatrixDType b_type, size_t ldb,
+                           float beta, float* c, size_t ldc) {
+    if (a_type == MATRIX_F32 && b_type == MATRIX_F32) {
+        gemm_small(trans_a, trans_b, m, n, k, alpha, (const float*)a, lda,
+                   (const float*)b, ldb, beta, c, ldc);
+    } else {
+        gemm_small_widen(trans_a, trans_b, m, n, k, alpha, a, a_type, lda,
+                         b, b_type, ldb, beta, c, ldc);
+    }
+}
+
+// Pack buffer sizes for an m x n x k product: a_size floats per thread for
+// blocks of A (a multiple of the alignment) and b_size for the shared block of B
+static void gemm_pack_sizes(size_t m, size_t n, size_t k, size_t* a_size, size_t* b_size) {
+    const GemmKernel* uk = &kernels()->gemm;
+    size_t mc_max = uk->mr * GEMM_MC_PANELS;
+    size_t nc_max = uk->nr * GEMM_NC_PANELS;
+    size_t kc_max = k < GEMM_KC ? k : GEMM_KC;
+
+    // Size the pack buffers for the actual problem, rounded up to whole panels
+    size_t mc_alloc = (m < mc_max ? m : mc_max);
+    size_t nc_alloc = (n < nc_max ? n : nc_max);
+    mc_alloc = (mc_alloc + uk->mr - 1) / uk->mr * uk->mr;
+    nc_alloc = (nc_alloc + uk->nr - 1) / uk->nr * uk->nr;
+
+    size_t align = GEMM_ALIGNMENT / sizeof(float);
+    *a_size = (mc_alloc * kc_max + align - 1) / align * align;
+    *b_size = kc_max * nc_alloc;
+}
+
+// Blocked product on nthreads threads. apack holds apack_size floats for
+// every thread, bpack the shared block of B (see gemm_pack_sizes).
+static void gemm_packed(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                        float alpha, const void* a, MatrixDType a_type, size_t lda,
+                        const void* b, MatrixDType b_type, size_t ldb,
+                        float beta, float* c, size_t ldc,
+                        const GemmEpilogue* ep, int nthreads,
+                        float* apack, size_t apack_size, float* bpack) {
+    const GemmKernel* uk = &kernels()->gemm;
+    size_t mc_max = uk->mr * GEMM_MC_PANELS;
+    size_t nc_max = uk->nr * GEMM_NC_PANELS;
+
+    // With beta == 0 the first K block overwrites C; otherwise C is scaled
+    // once up front and every K block accumulates into it
+    int overwrite = (beta == 0.0f);
+    if (!overwrite) {
+        gemm_scale_c(m, n, beta, c, ldc);
+    }
+
+    // Work items are (row block, column slice) pairs. When there are fewer
+    // row blocks than threads (small batches), the columns of each block
+    // are split so that every core still gets a share of the tiles.
+    size_t m_blocks = (m + mc_max - 1) / mc_max;
+    size_t n_splits = 1;
+    if ((size_t)nthreads > m_blocks) {
+        n_splits = ((size_t)nthreads + m_blocks - 1) / m_blocks;
+    }
+
+    #pragma omp parallel num_threads(nthreads) if (nthreads > 1)
+    {
+#ifdef _OPENMP
+        float* my_apack = apack + apack_size * omp_get_thread_num();
+#else
+        float* my_apack = apack;
+#endif
+
+        for (size_t jc = 0; jc < n; jc += nc_max) {
+            size_t nc = n - jc < nc_max ? n - jc : nc_max;
+            size_t panels = (nc + uk->nr - 1) / uk->nr;
+            size_t split_panels = (panels + n_splits - 1) / n_splits;
+
+            for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                size_t kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+                const void* bblock = gemm_offset(b, b_type, trans_b ? jc * ldb + pc : pc * ldb + jc);
+
+                #pragma omp for schedule(static)
+                for (size_t panel = 0; panel < panels; panel++) {
+                    size_t jr = panel * uk->nr;
+                    size_t cols = nc - jr < uk->nr ? nc - jr : uk->nr;
+                    const void* src = gemm_offset(bblock, b_type, trans_b ? jr * ldb : jr);
+                    gemm_pack_b(kc, cols, src, b_type, ldb, trans_b, bpack + jr * kc, uk->nr);
+                }
+
+                #pragma omp for schedule(dynamic)
+                for (size_t item = 0; item < m_blocks * n_splits; item++) {
+                    size_t ic = (item / n_splits) * mc_max;
+                    size_t j0 = (item % n_splits) * split_panels * uk->nr;
+                    if (j0 >= nc) continue;
+
+                    size_t mc = m - ic < mc_max ? m - ic : mc_max;
+                    size_t width = split_panels * uk->nr;
+                    if (width > nc - j0) width = nc - j0;
+
+                    const void* ablock = gemm_offset(a, a_type, trans_a ? pc * lda + ic : ic * lda + pc);
+                    gemm_pack_a(mc, kc, ablock, a_type, lda, trans_a, alpha, my_apack, uk->mr);
+                    gemm_macro_kernel(uk, mc, width, kc, my_apack, bpack + j0 * kc,
+                                      c + ic * ldc + jc + j0, ldc,
+                                      !(overwrite && pc == 0),
+                                      pc + kc == k ? ep : NULL, ic, jc + j0);
+                }
+            }
+        }
+    }
+}
+
+// Products that need no packing are finished here; returns 0 otherwise
+static int gemm_trivial(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                        float alpha, const void* a, MatrixDType a_type, size_t lda,
+                        const void* b, MatrixDType b_type, size_t ldb,
+                        float beta, float* c, size_t ldc,
+                        const GemmEpilogue* ep) {
+    if (k == 0 || alpha == 0.0f) {
+        gemm_scale_c(m, n, beta, c, ldc);
+    } else if (m * n * k <= GEMM_SMALL_FLOPS) {
+        gemm_small_any(trans_a, trans_b, m, n, k, alpha, a, a_type, lda, b, b_type, ldb,
+                       beta, c, ldc);
+    } else {
+        return 0;
+    }
+    if (ep) gemm_apply_epilogue_full(ep, m, n, c, ldc);
+    return 1;
+}
+
+static void gemm_builtin(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                         float alpha, const void* a, MatrixDType a_type, size_t lda,
+                         const void* b, MatrixDType b_type, size_t ldb,
+                         float beta, float* c, size_t ldc,
+                         const GemmEpilogue* ep) {
+    if (gemm_trivial(trans_a, trans_b, m, n, k, alpha, a, a_type, lda, b, b_type, ldb,
+                     beta, c, ldc, ep)) {
+        return;
+    }
+
+    int nthreads = 1;
+#ifdef _OPENMP
+    if (m * n * k >= GEMM_PARALLEL_FLOPS && !omp_in_parallel()) {
+        nthreads = omp_get_max_threads();
+    }
+#endif
+
+    // Every thread packs its own block of A; the packed B block is shared
+    size_t apack_size, bpack_size;
+    gemm_pack_sizes(m, n, k, &apack_size, &bpack_size);
+    int cached = 0;
+    float* apack = gemm_acquire(apack_size * nthreads + bpack_size, &cached);
+    if (!apack) {
+        gemm_small_any(trans_a, trans_b, m, n, k, alpha, a, a_type, lda, b, b_type, ldb,
+                       beta, c, ldc);
+        if (ep) gemm_apply_epilogue_full(ep, m, n, c, ldc);
+        return;
+    }
+
+    gemm_packed(trans_a, trans_b, m, n, k, alpha, a, a_type, lda, b, b_type, ldb,
+                beta, c, ldc, ep, nthreads, apack, apack_size, apack + apack_size * nthreads);
+    gemm_return(apack, cached);
+}
+
+#ifdef NN_HAVE_CBLAS
+// CBLAS takes int dimensions and strides; larger problems stay built-in
+static int gemm_cblas_fits(size_t m, size_t n, size_t k, size_t lda, size_t ldb, size_t ldc) {
+    size_t max = m > n ? m : n;
+    if (k > max) max = k;
+    if (lda > max) max = lda;
+    if (ldb > max) max = ldb;
+    if (ldc > max) max = ldc;
+    return max <= (size_t)INT_MAX;
+}
+
+static void gemm_cblas(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                       float alpha, const float* a, size_t lda,
+                       const float* b, size_t ldb,
+                       float beta, float* c, size_t ldc) {
+    cblas_sgemm(CblasRowMajor,
+                trans_a ? CblasTrans : CblasNoTrans,
+                trans_b ? CblasTrans : CblasNoTrans,
+                (int)m, (int)n, (int)k,
+                alpha, a, (int)lda, b, (int)ldb,
+                beta, c, (int)ldc);
+}
+#endif
+
+static int gemm_backend_available(MatrixGemmBackend backend) {
+    switch (backend) {
+        case MATRIX_GEMM_BUILTIN:
+            return 1;
+        case MATRIX_GEMM_BLAS:
+#ifdef NN_HAVE_CBLAS
+            return 1;
+#else
+            return 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+// Backend chosen at build time, overridable by NEUROFORGE_GEMM_BACKEND
+// ("builtin" or "blas") and then by matrix_set_gemm_backend()
+static MatrixGemmBackend gemm_backend = NN_DEFAULT_GEMM_BACKEND;
+static int gemm_backend_initialized = 0;
+
+static void gemm_backend_init(void) {
+    if (gemm_backend_initialized) return;
+    gemm_backend_initialized = 1;
+
+    if (!gemm_backend_available(gemm_backend)) {
+        gemm_backend = MATRIX_GEMM_BUILTIN;
+    }
+
+    const char* env = getenv("NEUROFORGE_GEMM_BACKEND");
+    if (!env || !*env) return;
+
+    MatrixGemmBackend requested;
+    if (strcmp(env, "builtin") == 0) {
+        requested = MATRIX_GEMM_BUILTIN;
+    } else if (strcmp(env, "blas") == 0) {
+        requested = MATRIX_GEMM_BLAS;
+    } else {
+        fprintf(stderr, "Unknown NEUROFORGE_GEMM_BACKEND: %s\n", env);
+        return;
+    }
+
+    if (!gemm_backend_available(requested)) {
+        fprintf(stderr, "GEMM backend '%s' not compiled in, using '%s'\n",
+                env, matrix_gemm_backend_name(gemm_backend));
+        return;
+    }
+    gemm_backend = requested;
+}
+
+int matrix_set_gemm_backend(MatrixGemmBackend backend) {
+    gemm_backend_init();
+    if (!gemm_backend_available(backend)) {
+        return -1;
+    }
+    gemm_backend = backend;
+    return 0;
+}
+
+MatrixGemmBackend matrix_get_gemm_backend(void) {
+    gemm_backend_init();
+    return gemm_backend;
+}
+
+const char* matrix_gemm_backend_name(MatrixGemmBackend backend) {
+    switch (backend) {
+        case MATRIX_GEMM_BUILTIN: return "builtin";
+        case MATRIX_GEMM_BLAS:    return "blas";
+        default:                  return "unknown";
+    }
+}
+
+void gemm_mixed_ex(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                   float alpha, const void* a, MatrixDType a_type, size_t lda,
+                   const void* b, MatrixDType b_type, size_t ldb,
+                   float beta, float* c, size_t ldc,
+                   const GemmEpilogue* epilogue) {
+    if (m == 0 || n == 0) return;
+
+    // Nothing to fuse: skip the per-tile hook entirely
+    if (epilogue && !epilogue->bias && !epilogue->pre_activation &&
+        (epilogue->activation == ACTIVATION_NONE || epilogue->activation == ACTIVATION_SOFTMAX)) {
+        epilogue = NULL;
+    }
+
+    gemm_backend_init();
+#ifdef NN_HAVE_CBLAS
+    // External BLAS libraries may split K across threads, which changes
+    // the summation order with the thread count. sgemm takes floats only,
+    // and int sizes.
+    if (gemm_backend == MATRIX_GEMM_BLAS && !matrix_get_deterministic() &&
+        a_type == MATRIX_F32 && b_type == MATRIX_F32 &&
+        gemm_cblas_fits(m, n, k, lda, ldb, ldc)) {
+        gemm_cblas(trans_a, trans_b, m, n, k, alpha, (const float*)a, lda,
+                   (const float*)b, ldb, beta, c, ldc);
+        if (epilogue) gemm_apply_epilogue_full(epilogue, m, n, c, ldc);
+        return;
+    }
+#endif
+    gemm_builtin(trans_a, trans_b, m, n, k, alpha, a, a_type, lda, b, b_type, ldb,
+                 beta, c, ldc, epilogue);
+}
+
+void gemm_sgemm_ex(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                   float alpha, const float* a, size_t lda,
+                   const float* b, size_t ldb,
+                   float beta, float* c, size_t ldc,
+                   const GemmEpilogue* epilogue) {
+    gemm_mixed_ex(trans_a, trans_b, m, n, k, alpha, a, MATRIX_F32, lda,
+                  b, MATRIX_F32, ldb, beta, c, ldc, epilogue);
+}
+
+void gemm_sgemm(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                float alpha, const float* a, size_t lda,
+                const float* b, size_t ldb,
+                float beta, float* c, size_t ldc) {
+    gemm_sgemm_ex(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, NULL);
+}
+
+void gemm_sgemm_strided_batched(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                                float alpha, const float* a, size_t lda, size_t stride_a,
+                                const float* b, size_t ldb, size_t stride_b,
+                                float beta, float* c, size_t ldc, size_t stride_c,
+                                size_t batch) {
+    if (m == 0 || n == 0 || batch == 0) return;
+
+    gemm_backend_init();
+    int nthreads = 1;
+#ifdef _OPENMP
+    if (!omp_in_parallel()) nthreads = omp_get_max_threads();
+#endif
+
+    // Products are spread over the threads when there are enough of them to
+    // go around or they are too small to split; otherwise they run one
+    // after another, each on all threads
+    int sequential = batch < (size_t)nthreads && m * n * k >= GEMM_PARALLEL_FLOPS;
+#ifdef NN_HAVE_CBLAS
+    sequential |= gemm_backend == MATRIX_GEMM_BLAS && !matrix_get_deterministic();
+#endif
+
+    // One set of pack buffers per thread for the whole batch
+    size_t apack_size = 0, bpack_size = 0;
+    size_t per_thread = 0;
+    float* pack = NULL;
+    int cached = 0;
+    if (!sequential && m * n * k > GEMM_SMALL_FLOPS) {
+        size_t align = GEMM_ALIGNMENT / sizeof(float);
+        gemm_pack_sizes(m, n, k, &apack_size, &bpack_size);
+        per_thread = apack_size + (bpack_size + align - 1) / align * align;
+        pack = gemm_acquire(per_thread * nthreads, &cached);
+        sequential = (pack == NULL);
+    }
+
+    if (sequential) {
+        for (size_t i = 0; i < batch; i++) {
+            gemm_sgemm(trans_a, trans_b, m, n, k, alpha, a + i * stride_a, lda,
+                       b + i * stride_b, ldb, beta, c + i * stride_c, ldc);
+        }
+        return;
+    }
+
+    #pragma omp parallel num_threads(nthreads) if (nthreads > 1 && batch > 1)
+    {
+#ifdef _OPENMP
+        float* my_pack = pack ? pack + per_thread * omp_get_thread_num() : NULL;
+#else
+        float* my_pack = pack;
+#endif
+
+        #pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < batch; i++) {
+            const float* ai = a + i * stride_a;
+            const float* bi = b + i * stride_b;
+            float* ci = c + i * stride_c;
+            if (!gemm_trivial(trans_a, trans_b, m, n, k, alpha, ai, MATRIX_F32, lda,
+                              bi, MATRIX_F32, ldb, beta, ci, ldc, NULL)) {
+                gemm_packed(trans_a, trans_b, m, n, k, alpha, ai, MATRIX_F32, lda,
+                            bi, MATRIX_F32, ldb, beta, ci, ldc, NULL, 1,
+                            my_pack, apack_size, my_pack + apack_size);
+            }
+        }
+    }
+
+    if (pack) gemm_return(pack, cached);
+}
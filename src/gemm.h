@@ -0,0 +1,64 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stddef.h>
+#include "matrix.h"
+#include "activations/activation.h"
+
+// Post-processing fused into the GEMM. It is applied to each tile of C
+// right after its last K block is accumulated, while the tile is still in
+// registers/L1, instead of in separate sweeps over the whole output.
+typedef struct {
+    const float* bias;          // n values added to every row of C, or NULL
+    float* pre_activation;      // Receives C + bias before activation, or NULL
+    size_t ld_pre;              // Leading dimension of pre_activation
+    ActivationType activation;  // Elementwise activation; softmax is skipped
+} GemmEpilogue;
+
+// Single precision GEMM on row-major storage:
+//
+//   C = alpha * op(A) * op(B) + beta * C
+//
+// op(A) is m x k and op(B) is k x n; a non-zero trans flag means the operand
+// is stored transposed (A as k x m, B as n x k) and is read in place. The
+// leading dimensions are given in elements, so Matrix views (stride > cols)
+// can be passed directly without copying. The call is routed to the backend
+// selected with matrix_set_gemm_backend().
+void gemm_sgemm(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                float alpha, const float* a, size_t lda,
+                const float* b, size_t ldb,
+                float beta, float* c, size_t ldc);
+
+// gemm_sgemm followed by a fused epilogue (may be NULL)
+void gemm_sgemm_ex(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                   float alpha, const float* a, size_t lda,
+                   const float* b, size_t ldb,
+                   float beta, float* c, size_t ldc,
+                   const GemmEpilogue* epilogue);
+
+// gemm_sgemm_ex with operands of any MatrixDType. BF16/F16 values are
+// widened to float while A and B are packed, so the micro-kernels and the
+// accumulation in C run in single precision and the reduced format only
+// saves memory traffic.
+void gemm_mixed_ex(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                   float alpha, const void* a, MatrixDType a_type, size_t lda,
+                   const void* b, MatrixDType b_type, size_t ldb,
+                   float beta, float* c, size_t ldc,
+                   const GemmEpilogue* epilogue);
+
+// batch independent products of the same shape,
+//
+//   C_i = alpha * op(A_i) * op(B_i) + beta * C_i,   i = 0 .. batch - 1
+//
+// with A_i = a + i * stride_a, B_i = b + i * stride_b and C_i = c + i * stride_c
+// (strides in elements), e.g. the heads of an attention layer or the
+// sequences of a batch. The products are spread over the threads, each one
+// running single-threaded on that thread's pack buffers, so a batch of
+// small GEMMs costs one parallel region instead of one call per product.
+void gemm_sgemm_strided_batched(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                                float alpha, const float* a, size_t lda, size_t stride_a,
+                                const float* b, size_t ldb, size_t stride_b,
+                                float beta, float* c, size_t ldc, size_t stride_c,
+                                size_t batch);
+
+#endif // GEMM_H
@@ -0,0 +1,128 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vecops.h"
+#include "activations/activation.h"
+#include "sparse.h"
+#include "conv.h"
+
+// The hot loops of the library are compiled once per instruction set (see
+// src/kernels/) and reached through the table of the level cpu.h selected,
+// so one build runs with the widest vectors of whatever CPU it lands on.
+
+// Largest tile and row block of any variant, for scratch on the stack
+#define KERNEL_GEMM_TILE_MAX (6 * 32)
+#define KERNEL_QUANT_M_MAX 4
+
+// GEMM micro-kernel: C[MR x NR] (+)= packed A panel (kc x MR) * packed B panel (kc x NR)
+typedef void (*GemmMicroKernel)(size_t kc, const float* a, const float* b,
+                                float* c, size_t ldc, int accumulate);
+
+typedef struct {
+    size_t mr;
+    size_t nr;
+    GemmMicroKernel kernel;
+} GemmKernel;
+
+// int8 micro-kernel: int32 dot products of m_block rows of activations
+// (a[r], each k long) with QUANT_N_BLOCK weight rows (w, ldw apart), k a
+// multiple of QUANT_K_ALIGN. out[r * QUANT_N_BLOCK + j] receives row r
+// times weight row j. input_offset is added to every activation by
+// kernels whose multiply takes an unsigned left operand; the caller
+// subtracts input_offset * sum(w).
+typedef struct {
+    size_t m_block;
+    int32_t input_offset;
+    void (*kernel)(const int8_t* const* a, const int8_t* w, size_t ldw, size_t k,
+                   int32_t* out);
+} QuantKernel;
+
+typedef struct {
+    // vecops.h
+    void (*vec_copy)(float* dst, const float* src, size_t n);
+    void (*vec_fill)(float* x, float value, size_t n);
+    void (*vec_add)(float* x, const float* y, size_t n);
+    void (*vec_sub)(float* x, const float* y, size_t n);
+    void (*vec_mul)(float* x, const float* y, size_t n);
+    void (*vec_scale)(float* x, float scalar, size_t n);
+    void (*vec_add_scalar)(float* x, float scalar, size_t n);
+    void (*vec_sqrt)(float* x, size_t n);
+    void (*vec_exp)(float* x, size_t n, VecMathPrecision precision);
+    void (*vec_tanh)(float* x, size_t n, VecMathPrecision precision);
+    void (*vec_sigmoid)(float* x, size_t n, VecMathPrecision precision);
+    void (*vec_log1p)(float* x, size_t n, VecMathPrecision precision);
+    void (*vec_erf)(float* x, size_t n, VecMathPrecision precision);
+    float (*vec_sum)(const float* x, size_t n);
+    float (*vec_max)(const float* x, size_t n);
+    float (*vec_min)(const float* x, size_t n);
+    void (*vec_axpy)(float* y, float alpha, const float* x, size_t n);
+    void (*vec_axpby)(float* y, float alpha, const float* x, float beta, size_t n);
+    void (*vec_fma)(float* y, float alpha, const float* a, const float* b, float beta, size_t n);
+    void (*vec_addcdiv)(float* y, float value, const float* a, const float* b, float eps,
+                        size_t n);
+    void (*vec_bf16_to_f32)(float* dst, const uint16_t* src, size_t n);
+    void (*vec_f32_to_bf16)(uint16_t* dst, const float* src, size_t n);
+    void (*vec_f16_to_f32)(float* dst, const uint16_t* src, size_t n);
+    void (*vec_f32_to_f16)(uint16_t* dst, const float* src, size_t n);
+    void (*vec_transpose_8x8)(float* dst, size_t ldd, const float* src, size_t lds);
+    void (*vec_transpose_swap_8x8)(float* a, float* b, size_t ld);
+
+    GemmKernel gemm;
+    QuantKernel quant;
+
+    // activate_array, and grad[i] *= f'(z[i]) for activate_derivative
+    void (*activate)(float* x, size_t n, ActivationType activation,
+                     VecMathPrecision precision);
+    void (*activate_derivative)(const float* z, float* grad, size_t n,
+                                ActivationType activation, VecMathPrecision precision);
+    // grad[i] *= f'(z[i]) from y = f(z), for ACTIVATION_BACKWARD_OUTPUT
+    void (*activate_derivative_output)(const float* y, float* grad, size_t n,
+                                       ActivationType activation);
+    // ReLU-family masks (see ActivationMask): pack x > 0 into bits, and
+    // grad[i] *= bit i ? 1 : negative_slope
+    void (*activation_mask_pack)(const float* x, uint64_t* bits, size_t n);
+    void (*activate_derivative_mask)(const uint64_t* bits, float* grad, size_t n,
+                                     float negative_slope);
+    // Online softmax statistics: *max = max x[i], *sum = sum e^(x[i] - *max)
+    void (*softmax_stats)(const float* x, size_t n, VecMathPrecision precision,
+                          float* max, float* sum);
+
+    // Outputs P * block_rows .. of sparse_gemm for one group of
+    // SPARSE_ROW_GROUP rows: a_t is the transposed group, out the group's
+    // n x SPARSE_ROW_GROUP results
+    void (*sparse_block_row)(const SparseMatrix* s, size_t P, const float* a_t,
+                             const float* bias, float* out);
+    // Winograd transforms of CONV_WINOGRAD_LANES tiles for m = 2 or 4:
+    // v = B^T d B of the (m + 2)^2 inputs, y = A^T p A of the products
+    void (*winograd_input)(size_t m, const float* d, float* v);
+    void (*winograd_output)(size_t m, const float* p, float* y);
+    // Output row oh of one output channel block of a direct convolution:
+    // input is one image in blocks of in_block channels, filters the
+    // block's row of conv_direct_filters, bias out_block values and output
+    // the block's out_height x out_width x out_block values
+    void (*conv_direct_row)(const ConvGeometry* g, size_t in_block, size_t out_block,
+                            const float* input, const float* filters, const float* bias,
+                            float* output, size_t oh);
+} KernelTable;
+
+// Tables of the individual variants. A variant returns NULL when the build
+// did not compile it with its instruction set (other architectures, or a
+// compiler without the flags); the generic one always exists.
+const KernelTable* kernels_generic(void);
+const KernelTable* kernels_sse42(void);
+const KernelTable* kernels_avx2(void);
+const KernelTable* kernels_avx512(void);
+const KernelTable* kernels_avx512_vnni(void);
+
+// Table of the selected level, picked on first use
+extern const KernelTable* kernels_active;
+const KernelTable* kernels_select(void);
+
+static inline const KernelTable* kernels(void) {
+    const KernelTable* table = kernels_active;
+    return table ? table : kernels_select();
+}
+
+#endif // KERNELS_H
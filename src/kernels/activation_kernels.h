@@ -0,0 +1,446 @@
+#ifndef ACTIVATION_KERNELS_H
+#define ACTIVATION_KERNELS_H
+
+// Elementwise activations and their derivatives, compiled once per ISA
+// variant (see kernel_table.h)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include "../activations/activation.h"
+#include "math_kernels.h"
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SELU_SCALE 1.0507009873554804934193349852946f  // λ
+#define SELU_ALPHA 1.6732632423543772848170429916717f  // α
+#define GELU_K 0.7978845608028654f                     // sqrt(2 / pi)
+
+// mish(x) = x tanh(log(1 + e^x)) = x n (n + 2) / (n (n + 2) + 2), n = e^x:
+// one exponential instead of three transcendentals. Above 20 the ratio is 1.
+static inline float math_mish(float x, int fast) {
+    float e = math_exp(math_clamp(x, -INFINITY, 20.0f), fast);
+    float t = e * (e + 2.0f);
+    return x * t / (t + 2.0f);
+}
+
+static inline float math_mish_derivative(float x, int fast) {
+    x = math_keep_nan(math_clamp(x, -INFINITY, 20.0f), x);
+    float e = math_exp(x, fast);
+    float e2 = e * e;
+    float omega = 4.0f * (x + 1.0f) + 4.0f * e2 + e2 * e + e * (4.0f * x + 6.0f);
+    float delta = 2.0f * e + e2 + 2.0f;
+    return e * omega / (delta * delta);
+}
+
+// 0.5 (1 + tanh(u)) = sigmoid(2 u)
+static inline float math_gelu_cdf(float x, int fast) {
+    return math_sigmoid(2.0f * GELU_K * (x + 0.044715f * x * x * x), fast);
+}
+
+// Below VEC_MATH_PRECISE the exponential cases run on math_kernels.h
+static void activate_kernel(float* x, size_t n, ActivationType activation,
+                            VecMathPrecision precision) {
+    int precise = precision == VEC_MATH_PRECISE;
+    switch (activation) {
+        case ACTIVATION_SIGMOID:
+            if (!precise) {
+                MATH_LOOP(precision, n, x[i] = math_sigmoid(x[i], fast));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                x[i] = 1.0f / (1.0f + expf(-x[i]));
+            }
+            break;
+            
+        case ACTIVATION_RELU:
+            for (size_t i = 0; i < n; i++) {
+                x[i] = x[i] > 0 ? x[i] : 0;
+            }
+            break;
+            
+        case ACTIVATION_TANH:
+            if (!precise) {
+                MATH_LOOP(precision, n, x[i] = math_tanh(x[i], fast));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                x[i] = tanhf(x[i]);
+            }
+            break;
+            
+        case ACTIVATION_LEAKY_RELU:
+            for (size_t i = 0; i < n; i++) {
+                x[i] = x[i] > 0 ? x[i] : 0.01f * x[i];
+            }
+            break;
+            
+        case ACTIVATION_ELU:
+            if (!precise) {
+                MATH_LOOP(precision, n,
+                          x[i] = math_select(math_mask(x[i] > 0), x[i], math_expm1(x[i], fast)));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                x[i] = x[i] > 0 ? x[i] : 1.0f * (expf(x[i]) - 1);
+            }
+            break;
+            
+        case ACTIVATION_SELU:
+            if (!precise) {
+                MATH_LOOP(precision, n,
+                          x[i] = SELU_SCALE * math_select(math_mask(x[i] > 0), x[i],
+                                                          SELU_ALPHA * math_expm1(x[i], fast)));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                x[i] = x[i] > 0 ? SELU_SCALE * x[i] : SELU_SCALE * SELU_ALPHA * (expf(x[i]) - 1);
+            }
+            break;
+            
+        case ACTIVATION_SWISH:
+            if (!precise) {
+                MATH_LOOP(precision, n, x[i] = x[i] * math_sigmoid(x[i], fast));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                x[i] = x[i] / (1.0f + expf(-x[i]));
+            }
+            break;
+            
+        case ACTIVATION_MISH:
+            if (!precise) {
+                MATH_LOOP(precision, n, x[i] = math_mish(x[i], fast));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float v = x[i];
+                x[i] = v * tanhf(logf(1.0f + expf(v)));
+            }
+            break;
+            
+        case ACTIVATION_GELU:
+            if (!precise) {
+                MATH_LOOP(precision, n, x[i] = x[i] * math_gelu_cdf(x[i], fast));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float v = x[i];
+                x[i] = 0.5f * v * (1.0f + tanhf(sqrtf(2.0f / M_PI) * (v + 0.044715f * v * v * v)));
+            }
+            break;
+            
+        case ACTIVATION_SOFTMAX:  // Row-wise, handled by activate()
+        case ACTIVATION_NONE:
+        default:
+            // No activation applied
+            break;
+    }
+}
+
+// grad[i] *= f'(z[i]) over n contiguous elements
+static void activate_derivative_kernel(const float* z, float* grad, size_t n,
+                                       ActivationType activation, VecMathPrecision precision) {
+    int precise = precision == VEC_MATH_PRECISE;
+    switch (activation) {
+        case ACTIVATION_SIGMOID:
+            if (!precise) {
+                MATH_LOOP(precision, n, {
+                    float s = math_sigmoid(z[i], fast);
+                    grad[i] *= s * (1 - s);
+                });
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float s = 1.0f / (1.0f + expf(-z[i]));
+                grad[i] *= s * (1 - s);
+            }
+            break;
+            
+        case ACTIVATION_RELU:
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= z[i] > 0 ? 1 : 0;
+            }
+            break;
+            
+        case ACTIVATION_TANH:
+            if (!precise) {
+                MATH_LOOP(precision, n, {
+                    float t = math_tanh(z[i], fast);
+                    grad[i] *= 1 - t * t;
+                });
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float t = tanhf(z[i]);
+                grad[i] *= 1 - t * t;
+            }
+            break;
+            
+        case ACTIVATION_LEAKY_RELU:
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= z[i] > 0 ? 1 : 0.01f;
+            }
+            break;
+            
+        case ACTIVATION_ELU:
+            if (!precise) {
+                MATH_LOOP(precision, n,
+                          grad[i] *= math_select(math_mask(z[i] > 0), 1.0f, math_exp(z[i], fast)));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= z[i] > 0 ? 1 : 1.0f * expf(z[i]);
+            }
+            break;
+            
+        case ACTIVATION_SELU:
+            if (!precise) {
+                MATH_LOOP(precision, n,
+                          grad[i] *= SELU_SCALE * math_select(math_mask(z[i] > 0), 1.0f,
+                                                              SELU_ALPHA * math_exp(z[i], fast)));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= z[i] > 0 ? SELU_SCALE : SELU_SCALE * SELU_ALPHA * expf(z[i]);
+            }
+            break;
+            
+        case ACTIVATION_SWISH:
+            if (!precise) {
+                MATH_LOOP(precision, n, {
+                    float s = math_sigmoid(z[i], fast);
+                    grad[i] *= s + z[i] * s * (1 - s);
+                });
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float x = z[i];
+                float sigmoid = 1.0f / (1.0f + expf(-x));
+                grad[i] *= sigmoid + x * sigmoid * (1 - sigmoid);
+            }
+            break;
+            
+        case ACTIVATION_MISH:
+            if (!precise) {
+                MATH_LOOP(precision, n, grad[i] *= math_mish_derivative(z[i], fast));
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float x = z[i];
+                float omega = 4.0f * (x + 1) + 4.0f * expf(2.0f * x) + expf(3.0f * x) + expf(x) * (4.0f * x + 6.0f);
+                float delta = 2.0f * expf(x) + expf(2.0f * x) + 2.0f;
+                float derivative = expf(x) * omega / (delta * delta);
+                grad[i] *= derivative;
+            }
+            break;
+            
+        case ACTIVATION_GELU:
+            if (!precise) {
+                MATH_LOOP(precision, n, {
+                    float x = z[i];
+                    float pdf = math_exp(-0.5f * x * x, fast) * 0.3989422804014327f;
+                    grad[i] *= math_gelu_cdf(x, fast) + x * pdf;
+                });
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                float x = z[i];
+                float cdf = 0.5f * (1.0f + tanhf(sqrtf(2.0f / M_PI) * (x + 0.044715f * x * x * x)));
+                float pdf = expf(-0.5f * x * x) / sqrtf(2.0f * M_PI);
+                float derivative = cdf + x * pdf;
+                grad[i] *= derivative;
+            }
+            break;
+            
+        case ACTIVATION_SOFTMAX:
+            // For softmax, the derivative is usually combined with cross-entropy loss
+            // So we don't implement it separately here
+            break;
+            
+        case ACTIVATION_NONE:
+        default:
+            // No derivative applied
+            break;
+    }
+}
+
+// grad[i] *= f'(z[i]) for the ACTIVATION_BACKWARD_OUTPUT activations, from
+// y[i] = f(z[i])
+static void activate_derivative_output_kernel(const float* y, float* grad, size_t n,
+                                              ActivationType activation) {
+    switch (activation) {
+        case ACTIVATION_SIGMOID:
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= y[i] * (1 - y[i]);
+            }
+            break;
+            
+        case ACTIVATION_TANH:
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= 1 - y[i] * y[i];
+            }
+            break;
+            
+        case ACTIVATION_ELU:  // y = e^z - 1 below 0
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= y[i] > 0 ? 1 : y[i] + 1.0f;
+            }
+            break;
+            
+        case ACTIVATION_SELU:  // y = λα (e^z - 1) below 0
+            for (size_t i = 0; i < n; i++) {
+                grad[i] *= y[i] > 0 ? SELU_SCALE : y[i] + SELU_SCALE * SELU_ALPHA;
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+// Bit i % 64 of bits[i / 64] = x[i] > 0; bits past n in the last word are 0
+static void activation_mask_pack_kernel(const float* x, uint64_t* bits, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (size_t q = 0; q < 4; q++) {
+            __mmask16 k = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i + 16 * q),
+                                             _mm512_setzero_ps(), _CMP_GT_OQ);
+            word |= (uint64_t)k << (16 * q);
+        }
+        bits[i / 64] = word;
+    }
+#elif defined(__AVX__)
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (size_t q = 0; q < 8; q++) {
+            __m256 gt = _mm256_cmp_ps(_mm256_loadu_ps(x + i + 8 * q), _mm256_setzero_ps(),
+                                      _CMP_GT_OQ);
+            word |= (uint64_t)_mm256_movemask_ps(gt) << (8 * q);
+        }
+        bits[i / 64] = word;
+    }
+#elif defined(__SSE2__)
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (size_t q = 0; q < 16; q++) {
+            __m128 gt = _mm_cmpgt_ps(_mm_loadu_ps(x + i + 4 * q), _mm_setzero_ps());
+            word |= (uint64_t)_mm_movemask_ps(gt) << (4 * q);
+        }
+        bits[i / 64] = word;
+    }
+#endif
+    for (; i < n; i += 64) {
+        size_t len = n - i < 64 ? n - i : 64;
+        uint64_t word = 0;
+        for (size_t j = 0; j < len; j++) {
+            word |= (uint64_t)(x[i + j] > 0.0f) << j;
+        }
+        bits[i / 64] = word;
+    }
+}
+
+// grad[i] *= bit i ? 1 : negative_slope, the ReLU-family derivative
+static void activate_derivative_mask_kernel(const uint64_t* bits, float* grad, size_t n,
+                                            float negative_slope) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    __m512 slope = _mm512_set1_ps(negative_slope);
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 k = (__mmask16)(bits[i / 64] >> (i % 64));
+        __m512 g = _mm512_loadu_ps(grad + i);
+        _mm512_storeu_ps(grad + i, _mm512_mask_mov_ps(_mm512_mul_ps(g, slope), k, g));
+    }
+#elif defined(__AVX2__)
+    const __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256 slope = _mm256_set1_ps(negative_slope);
+    for (; i + 8 <= n; i += 8) {
+        __m256i b = _mm256_set1_epi32((int)((bits[i / 64] >> (i % 64)) & 0xff));
+        __m256 keep = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(b, lane), lane));
+        __m256 g = _mm256_loadu_ps(grad + i);
+        _mm256_storeu_ps(grad + i, _mm256_blendv_ps(_mm256_mul_ps(g, slope), g, keep));
+    }
+#elif defined(__SSE2__)
+    const __m128i lane = _mm_setr_epi32(1, 2, 4, 8);
+    __m128 slope = _mm_set1_ps(negative_slope);
+    for (; i + 4 <= n; i += 4) {
+        __m128i b = _mm_set1_epi32((int)((bits[i / 64] >> (i % 64)) & 0xf));
+        __m128 keep = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, lane), lane));
+        __m128 g = _mm_loadu_ps(grad + i);
+        _mm_storeu_ps(grad + i, _mm_or_ps(_mm_and_ps(keep, g),
+                                          _mm_andnot_ps(keep, _mm_mul_ps(g, slope))));
+    }
+#endif
+    for (; i < n; i++) {
+        grad[i] *= (bits[i / 64] >> (i % 64)) & 1 ? 1.0f : negative_slope;
+    }
+}
+
+// Independent running (max, sum) pairs per row in softmax_stats_kernel,
+// one vector's worth or more on every variant
+#define SOFTMAX_LANES 16
+
+// Online softmax update: with d = x - m, either x is the new maximum and
+// the sum is rescaled by e^-d, or e^d is added. One exponential either way.
+static inline void softmax_stats_step(float* m, float* s, float x, int fast, int precise) {
+    float d = x - *m;
+    float e = precise ? expf(-fabsf(d)) : math_exp(-fabsf(d), fast);
+    int32_t up = math_mask(d > 0.0f);
+    *s = math_select(up, *s * e + 1.0f, *s + e);
+    *m = math_select(up, x, *m);
+}
+
+static inline void softmax_stats_lanes(const float* x, size_t n, float* m, float* s,
+                                       int fast, int precise) {
+    size_t i = 0;
+    for (; i + SOFTMAX_LANES <= n; i += SOFTMAX_LANES) {
+        #pragma omp simd
+        for (size_t j = 0; j < SOFTMAX_LANES; j++) {
+            softmax_stats_step(&m[j], &s[j], x[i + j], fast, precise);
+        }
+    }
+    for (size_t j = 0; i + j < n; j++) {
+        softmax_stats_step(&m[j], &s[j], x[i + j], fast, precise);
+    }
+}
+
+// *max = max x[i] and *sum = sum e^(x[i] - *max) in one pass over x
+static void softmax_stats_kernel(const float* x, size_t n, VecMathPrecision precision,
+                                 float* max, float* sum) {
+    float m[SOFTMAX_LANES];
+    float s[SOFTMAX_LANES];
+    for (size_t j = 0; j < SOFTMAX_LANES; j++) {
+        m[j] = -FLT_MAX;
+        s[j] = 0.0f;
+    }
+    
+    if (precision == VEC_MATH_PRECISE) {
+        softmax_stats_lanes(x, n, m, s, 0, 1);
+    } else if (precision == VEC_MATH_FAST) {
+        softmax_stats_lanes(x, n, m, s, 1, 0);
+    } else {
+        softmax_stats_lanes(x, n, m, s, 0, 0);
+    }
+    
+    float row_max = m[0];
+    for (size_t j = 1; j < SOFTMAX_LANES; j++) {
+        row_max = m[j] > row_max ? m[j] : row_max;
+    }
+    float row_sum = 0.0f;
+    for (size_t j = 0; j < SOFTMAX_LANES; j++) {
+        row_sum += s[j] * expf(m[j] - row_max);
+    }
+    *max = row_max;
+    *sum = row_sum;
+}
+
+#endif // ACTIVATION_KERNELS_H
@@ -0,0 +1,193 @@
+#ifndef CONV_KERNELS_H
+#define CONV_KERNELS_H
+
+// Direct convolution on channel-blocked batches (see conv_forward_direct),
+// compiled once per ISA variant (see kernel_table.h). The out_block output
+// channels of one position fill the SIMD lanes; each input value is
+// broadcast against a vector of weights and accumulated into a tile of
+// CONV_DIRECT_TILE positions, which stays in registers. Tiles at the left
+// and right edges, and variants without a vector kernel for the block,
+// take the portable loop.
+
+#include <stddef.h>
+#include "../conv.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#define CONV_DIRECT_TILE 8
+
+// Stands in for input pixels outside the image
+static const float conv_direct_zeros[16] = {0};
+
+// Accumulates the taps of kernel row ki, column kj of one input channel
+// block into the tile; xt[t] is the input pixel of position t. The
+// accumulators are named individually, as in the GEMM micro-kernels.
+#define CONV_DIRECT_TAPS(vec, set1, load, fmadd, out_block)                     \
+    for (size_t ci = 0; ci < in_block; ci++) {                                  \
+        vec wv = load(w + ci * (out_block));                                   \
+        c0 = fmadd(set1(xt[0][ci]), wv, c0);                                   \
+        c1 = fmadd(set1(xt[1][ci]), wv, c1);                                   \
+        c2 = fmadd(set1(xt[2][ci]), wv, c2);                                   \
+        c3 = fmadd(set1(xt[3][ci]), wv, c3);                                   \
+        c4 = fmadd(set1(xt[4][ci]), wv, c4);                                   \
+        c5 = fmadd(set1(xt[5][ci]), wv, c5);                                   \
+        c6 = fmadd(set1(xt[6][ci]), wv, c6);                                   \
+        c7 = fmadd(set1(xt[7][ci]), wv, c7);                                   \
+    }
+
+// Every tap of a tile of n <= CONV_DIRECT_TILE positions; rows above and
+// below the image are skipped, columns beyond it and positions past n
+// read zeros
+#define CONV_DIRECT_TILE_LOOP(vec, set1, load, fmadd, out_block)                \
+    for (size_t cb = 0; cb < in_blocks; cb++) {                                 \
+        for (size_t ki = 0; ki < k; ki++) {                                     \
+            long ih = (long)(oh * s + ki) - pad;                                \
+            if (ih < 0 || ih >= (long)g->height) continue;                      \
+            const float* row = input + cb * plane + (size_t)ih * g->width * in_block; \
+            for (size_t kj = 0; kj < k; kj++) {                                 \
+                const float* w = filters +                                      \
+                                 ((cb * k + ki) * k + kj) * in_block * (out_block); \
+                const float* xt[CONV_DIRECT_TILE];                              \
+                for (size_t t = 0; t < CONV_DIRECT_TILE; t++) {                 \
+                    long iw = (long)((ow0 + t) * s + kj) - pad;                 \
+                    int valid = t < n && iw >= 0 && iw < (long)g->width;        \
+                    xt[t] = valid ? row + (size_t)iw * in_block : conv_direct_zeros; \
+                }                                                               \
+                CONV_DIRECT_TAPS(vec, set1, load, fmadd, out_block)             \
+            }                                                                   \
+        }                                                                       \
+    }
+
+#if defined(__AVX512F__)
+static void conv_direct_tile_16(const ConvGeometry* g, size_t in_block, const float* input,
+                                const float* filters, const float* bias, float* out,
+                                size_t oh, size_t ow0, size_t n) {
+    const size_t k = g->kernel, s = g->stride;
+    const long pad = (long)g->padding;
+    const size_t in_blocks = (g->channels + in_block - 1) / in_block;
+    const size_t plane = g->height * g->width * in_block;
+    __m512 b = _mm512_loadu_ps(bias);
+    __m512 c0 = b, c1 = b, c2 = b, c3 = b, c4 = b, c5 = b, c6 = b, c7 = b;
+
+    CONV_DIRECT_TILE_LOOP(__m512, _mm512_set1_ps, _mm512_loadu_ps, _mm512_fmadd_ps, 16)
+
+    __m512 c[CONV_DIRECT_TILE] = {c0, c1, c2, c3, c4, c5, c6, c7};
+    for (size_t t = 0; t < n; t++) _mm512_storeu_ps(out + (ow0 + t) * 16, c[t]);
+}
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+static void conv_direct_tile_8(const ConvGeometry* g, size_t in_block, const float* input,
+                               const float* filters, const float* bias, float* out,
+                               size_t oh, size_t ow0, size_t n) {
+    const size_t k = g->kernel, s = g->stride;
+    const long pad = (long)g->padding;
+    const size_t in_blocks = (g->channels + in_block - 1) / in_block;
+    const size_t plane = g->height * g->width * in_block;
+    __m256 b = _mm256_loadu_ps(bias);
+    __m256 c0 = b, c1 = b, c2 = b, c3 = b, c4 = b, c5 = b, c6 = b, c7 = b;
+
+    CONV_DIRECT_TILE_LOOP(__m256, _mm256_set1_ps, _mm256_loadu_ps, _mm256_fmadd_ps, 8)
+
+    __m256 c[CONV_DIRECT_TILE] = {c0, c1, c2, c3, c4, c5, c6, c7};
+    for (size_t t = 0; t < n; t++) _mm256_storeu_ps(out + (ow0 + t) * 8, c[t]);
+}
+#endif
+
+static inline void conv_direct_row_block(const ConvGeometry* g, size_t in_block,
+                                         const size_t out_block, const float* input,
+                                         const float* filters, const float* bias,
+                                         float* output, size_t oh) {
+    const size_t k = g->kernel, s = g->stride, width = g->width, out_width = g->out_width;
+    const long pad = (long)g->padding;
+    const size_t in_blocks = (g->channels + in_block - 1) / in_block;
+    const size_t plane = g->height * width * in_block;
+    float* out = output + oh * out_width * out_block;
+
+    // Output columns lo .. hi - 1 have every tap inside the row
+    size_t lo = ((size_t)pad + s - 1) / s;
+    size_t hi = width + (size_t)pad >= k ? (width + (size_t)pad - k) / s + 1 : 0;
+    if (hi > out_width) hi = out_width;
+
+    for (size_t ow0 = 0; ow0 < out_width; ow0 += CONV_DIRECT_TILE) {
+        size_t n = out_width - ow0 < CONV_DIRECT_TILE ? out_width - ow0 : CONV_DIRECT_TILE;
+        int inside = n == CONV_DIRECT_TILE && ow0 >= lo && ow0 + CONV_DIRECT_TILE <= hi;
+#if defined(__AVX512F__)
+        if (out_block == 16) {
+            conv_direct_tile_16(g, in_block, input, filters, bias, out, oh, ow0, n);
+            continue;
+        }
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+        if (out_block == 8) {
+            conv_direct_tile_8(g, in_block, input, filters, bias, out, oh, ow0, n);
+            continue;
+        }
+#endif
+
+        float acc[CONV_DIRECT_TILE * 16];
+        for (size_t t = 0; t < CONV_DIRECT_TILE; t++) {
+            #pragma omp simd
+            for (size_t o = 0; o < out_block; o++) acc[t * out_block + o] = bias[o];
+        }
+
+        for (size_t cb = 0; cb < in_blocks; cb++) {
+            for (size_t ki = 0; ki < k; ki++) {
+                long ih = (long)(oh * s + ki) - pad;
+                if (ih < 0 || ih >= (long)g->height) continue;
+                const float* row = input + cb * plane + (size_t)ih * width * in_block;
+
+                for (size_t kj = 0; kj < k; kj++) {
+                    const float* w = filters + ((cb * k + ki) * k + kj) * in_block * out_block;
+                    if (inside) {
+                        const float* x = row + (size_t)((long)(ow0 * s + kj) - pad) * in_block;
+                        for (size_t ci = 0; ci < in_block; ci++) {
+                            const float* wv = w + ci * out_block;
+                            for (size_t t = 0; t < CONV_DIRECT_TILE; t++) {
+                                float xv = x[t * s * in_block + ci];
+                                #pragma omp simd
+                                for (size_t o = 0; o < out_block; o++) {
+                                    acc[t * out_block + o] += xv * wv[o];
+                                }
+                            }
+                        }
+                    } else {
+                        for (size_t t = 0; t < n; t++) {
+                            long iw = (long)((ow0 + t) * s + kj) - pad;
+                            if (iw < 0 || iw >= (long)width) continue;
+                            const float* x = row + (size_t)iw * in_block;
+                            for (size_t ci = 0; ci < in_block; ci++) {
+                                float xv = x[ci];
+                                #pragma omp simd
+                                for (size_t o = 0; o < out_block; o++) {
+                                    acc[t * out_block + o] += xv * w[ci * out_block + o];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        for (size_t t = 0; t < n; t++) {
+            #pragma omp simd
+            for (size_t o = 0; o < out_block; o++) {
+                out[(ow0 + t) * out_block + o] = acc[t * out_block + o];
+            }
+        }
+    }
+}
+
+static void conv_direct_row_kernel(const ConvGeometry* g, size_t in_block, size_t out_block,
+                                   const float* input, const float* filters, const float* bias,
+                                   float* output, size_t oh) {
+    if (out_block == 16) {
+        conv_direct_row_block(g, in_block, 16, input, filters, bias, output, oh);
+    } else {
+        conv_direct_row_block(g, in_block, 8, input, filters, bias, output, oh);
+    }
+}
+
+#endif // CONV_KERNELS_H
@@ -0,0 +1,160 @@
+#ifndef GEMM_KERNELS_H
+#define GEMM_KERNELS_H
+
+// GEMM micro-kernels, compiled once per ISA variant (see kernel_table.h).
+// Each variant defines GEMM_MR x GEMM_NR and GEMM_MICRO_KERNEL, the
+// GemmMicroKernel for its widest vector unit.
+
+#include <stddef.h>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+
+#if defined(__AVX512F__)
+
+#define GEMM_MR 6
+#define GEMM_NR 32
+
+// Accumulators are named individually: GCC keeps an array of vectors in
+// memory across loop iterations, which halves kernel throughput.
+#define GEMM_ROW_FMA(r)                                          \
+    do {                                                         \
+        __m512 ai = _mm512_set1_ps(a[r]);                        \
+        c##r##0 = _mm512_fmadd_ps(ai, b0, c##r##0);              \
+        c##r##1 = _mm512_fmadd_ps(ai, b1, c##r##1);              \
+    } while (0)
+
+#define GEMM_ROW_STORE(r)                                        \
+    do {                                                         \
+        float* row = c + (r) * ldc;                              \
+        if (accumulate) {                                        \
+            c##r##0 = _mm512_add_ps(c##r##0, _mm512_loadu_ps(row));       \
+            c##r##1 = _mm512_add_ps(c##r##1, _mm512_loadu_ps(row + 16));  \
+        }                                                        \
+        _mm512_storeu_ps(row, c##r##0);                          \
+        _mm512_storeu_ps(row + 16, c##r##1);                     \
+    } while (0)
+
+static void gemm_kernel_6x32(size_t kc, const float* a, const float* b,
+                             float* c, size_t ldc, int accumulate) {
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+
+    for (size_t p = 0; p < kc; p++) {
+        __m512 b0 = _mm512_load_ps(b);
+        __m512 b1 = _mm512_load_ps(b + 16);
+        GEMM_ROW_FMA(0);
+        GEMM_ROW_FMA(1);
+        GEMM_ROW_FMA(2);
+        GEMM_ROW_FMA(3);
+        GEMM_ROW_FMA(4);
+        GEMM_ROW_FMA(5);
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    GEMM_ROW_STORE(0);
+    GEMM_ROW_STORE(1);
+    GEMM_ROW_STORE(2);
+    GEMM_ROW_STORE(3);
+    GEMM_ROW_STORE(4);
+    GEMM_ROW_STORE(5);
+}
+
+#define GEMM_MICRO_KERNEL gemm_kernel_6x32
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+#define GEMM_MR 6
+#define GEMM_NR 16
+
+// See the AVX-512 kernel for why the accumulators are named individually
+#define GEMM_ROW_FMA(r)                                          \
+    do {                                                         \
+        __m256 ai = _mm256_broadcast_ss(a + (r));                \
+        c##r##0 = _mm256_fmadd_ps(ai, b0, c##r##0);              \
+        c##r##1 = _mm256_fmadd_ps(ai, b1, c##r##1);              \
+    } while (0)
+
+#define GEMM_ROW_STORE(r)                                        \
+    do {                                                         \
+        float* row = c + (r) * ldc;                              \
+        if (accumulate) {                                        \
+            c##r##0 = _mm256_add_ps(c##r##0, _mm256_loadu_ps(row));      \
+            c##r##1 = _mm256_add_ps(c##r##1, _mm256_loadu_ps(row + 8));  \
+        }                                                        \
+        _mm256_storeu_ps(row, c##r##0);                          \
+        _mm256_storeu_ps(row + 8, c##r##1);                      \
+    } while (0)
+
+static void gemm_kernel_6x16(size_t kc, const float* a, const float* b,
+                             float* c, size_t ldc, int accumulate) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for (size_t p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        GEMM_ROW_FMA(0);
+        GEMM_ROW_FMA(1);
+        GEMM_ROW_FMA(2);
+        GEMM_ROW_FMA(3);
+        GEMM_ROW_FMA(4);
+        GEMM_ROW_FMA(5);
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    GEMM_ROW_STORE(0);
+    GEMM_ROW_STORE(1);
+    GEMM_ROW_STORE(2);
+    GEMM_ROW_STORE(3);
+    GEMM_ROW_STORE(4);
+    GEMM_ROW_STORE(5);
+}
+
+#define GEMM_MICRO_KERNEL gemm_kernel_6x16
+
+#else
+
+#define GEMM_MR 4
+#define GEMM_NR 8
+
+// Portable kernel; written so the inner j loop auto-vectorizes
+static void gemm_kernel_4x8(size_t kc, const float* a, const float* b,
+                            float* c, size_t ldc, int accumulate) {
+    float acc[GEMM_MR][GEMM_NR] = {{0}};
+
+    for (size_t p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            for (int j = 0; j < GEMM_NR; j++) {
+                acc[i][j] += a[i] * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    for (int i = 0; i < GEMM_MR; i++) {
+        float* row = c + i * ldc;
+        for (int j = 0; j < GEMM_NR; j++) {
+            row[j] = accumulate ? row[j] + acc[i][j] : acc[i][j];
+        }
+    }
+}
+
+#define GEMM_MICRO_KERNEL gemm_kernel_4x8
+
+#endif
+
+#endif // GEMM_KERNELS_H
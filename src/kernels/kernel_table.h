@@ -0,0 +1,60 @@
+#ifndef KERNEL_TABLE_H
+#define KERNEL_TABLE_H
+
+// Included by exactly one translation unit per ISA variant, each compiled
+// with that variant's instruction-set flags: the kernel headers below pick
+// their code paths from the target macros (__AVX2__, __AVX512F__, ...) and
+// kernel_table collects them.
+
+#include "../kernels.h"
+#include "vec_kernels.h"
+#include "math_kernels.h"
+#include "gemm_kernels.h"
+#include "quant_kernels.h"
+#include "activation_kernels.h"
+#include "sparse_kernels.h"
+#include "winograd_kernels.h"
+#include "conv_kernels.h"
+
+static const KernelTable kernel_table = {
+    vec_copy_kernel,
+    vec_fill_kernel,
+    vec_add_kernel,
+    vec_sub_kernel,
+    vec_mul_kernel,
+    vec_scale_kernel,
+    vec_add_scalar_kernel,
+    vec_sqrt_kernel,
+    vec_exp_kernel,
+    vec_tanh_kernel,
+    vec_sigmoid_kernel,
+    vec_log1p_kernel,
+    vec_erf_kernel,
+    vec_sum_kernel,
+    vec_max_kernel,
+    vec_min_kernel,
+    vec_axpy_kernel,
+    vec_axpby_kernel,
+    vec_fma_kernel,
+    vec_addcdiv_kernel,
+    vec_bf16_to_f32_kernel,
+    vec_f32_to_bf16_kernel,
+    vec_f16_to_f32_kernel,
+    vec_f32_to_f16_kernel,
+    vec_transpose_8x8_kernel,
+    vec_transpose_swap_8x8_kernel,
+    { GEMM_MR, GEMM_NR, GEMM_MICRO_KERNEL },
+    { QUANT_M_BLOCK, QUANT_INPUT_OFFSET, quant_kernel },
+    activate_kernel,
+    activate_derivative_kernel,
+    activate_derivative_output_kernel,
+    activation_mask_pack_kernel,
+    activate_derivative_mask_kernel,
+    softmax_stats_kernel,
+    sparse_block_row_kernel,
+    winograd_input_kernel,
+    winograd_output_kernel,
+    conv_direct_row_kernel
+};
+
+#endif // KERNEL_TABLE_H
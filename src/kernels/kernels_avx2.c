@@ -0,0 +1,16 @@
+// AVX2 variant (x86-64-v3): -mavx2 -mfma -mf16c
+#include "../kernels.h"
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+#include "kernel_table.h"
+
+const KernelTable* kernels_avx2(void) {
+    return &kernel_table;
+}
+#else
+// Built without the instruction-set flags (see the makefile and
+// CMakeLists.txt): the variant is left out
+const KernelTable* kernels_avx2(void) {
+    return NULL;
+}
+#endif
@@ -0,0 +1,18 @@
+// AVX-512 variant (x86-64-v4): the AVX2 flags plus -mavx512f -mavx512bw
+// -mavx512dq -mavx512vl
+#include "../kernels.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__) && \
+    defined(__AVX512VL__)
+#include "kernel_table.h"
+
+const KernelTable* kernels_avx512(void) {
+    return &kernel_table;
+}
+#else
+// Built without the instruction-set flags (see the makefile and
+// CMakeLists.txt): the variant is left out
+const KernelTable* kernels_avx512(void) {
+    return NULL;
+}
+#endif
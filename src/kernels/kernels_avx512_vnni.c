@@ -0,0 +1,17 @@
+// AVX-512 with VNNI int8 dot products: the AVX-512 flags plus -mavx512vnni
+#include "../kernels.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__) && \
+    defined(__AVX512VL__) && defined(__AVX512VNNI__)
+#include "kernel_table.h"
+
+const KernelTable* kernels_avx512_vnni(void) {
+    return &kernel_table;
+}
+#else
+// Built without the instruction-set flags (see the makefile and
+// CMakeLists.txt): the variant is left out
+const KernelTable* kernels_avx512_vnni(void) {
+    return NULL;
+}
+#endif
@@ -0,0 +1,7 @@
+// Baseline variant: built with the library's own flags, so it runs on any
+// CPU the compiler targets by default (SSE2 on x86-64)
+#include "kernel_table.h"
+
+const KernelTable* kernels_generic(void) {
+    return &kernel_table;
+}
@@ -0,0 +1,16 @@
+// SSE4.2 variant (x86-64-v2): -msse4.2 -mpopcnt
+#include "../kernels.h"
+
+#if defined(__SSE4_2__) && defined(__POPCNT__)
+#include "kernel_table.h"
+
+const KernelTable* kernels_sse42(void) {
+    return &kernel_table;
+}
+#else
+// Built without the instruction-set flags (see the makefile and
+// CMakeLists.txt): the variant is left out
+const KernelTable* kernels_sse42(void) {
+    return NULL;
+}
+#endif
@@ -0,0 +1,241 @@
+#ifndef MATH_KERNELS_H
+#define MATH_KERNELS_H
+
+// Float approximations of exp, expm1, log1p, tanh, sigmoid and erf for the
+// elementwise kernels, compiled once per ISA variant (see kernel_table.h).
+// Every function is branch-free code on one element, so a loop over it
+// vectorizes with the variant's instruction set. `fast` picks the shorter
+// polynomials (VEC_MATH_FAST) and is meant to be a constant at the call
+// site, see MATH_LOOP.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../vecops.h"
+
+// Runs body for i < n with `fast` a compile-time constant in each of the
+// two loops, so every loop inlines one set of polynomials
+#define MATH_LOOP(precision, n, body)                         \
+    do {                                                      \
+        if ((precision) == VEC_MATH_FAST) {                   \
+            const int fast = 1;                               \
+            _Pragma("omp simd")                               \
+            for (size_t i = 0; i < (n); i++) { body; }        \
+        } else {                                              \
+            const int fast = 0;                               \
+            _Pragma("omp simd")                               \
+            for (size_t i = 0; i < (n); i++) { body; }        \
+        }                                                     \
+    } while (0)
+
+#define MATH_LOG2E 1.44269504088896341f
+// ln 2 split in two: n * MATH_LN2_HI is exact for the exponents used here
+#define MATH_LN2_HI 0.693359375f
+#define MATH_LN2_LO -2.12194440e-4f
+
+static inline float math_from_bits(int32_t i) {
+    float f;
+    memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+static inline int32_t math_to_bits(float f) {
+    int32_t i;
+    memcpy(&i, &f, sizeof(i));
+    return i;
+}
+
+// Float selects are avoided below: when one side of a select folds to a
+// constant (a clamped input, a special case) GCC evaluates the other side
+// under a branch, and the loop no longer vectorizes. Comparisons are turned
+// into all-ones masks and applied to the bits instead.
+static inline int32_t math_mask(int cond) {
+    return -(int32_t)(cond != 0);
+}
+
+// mask ? a : b
+static inline float math_select(int32_t mask, float a, float b) {
+    return math_from_bits((math_to_bits(a) & mask) | (math_to_bits(b) & ~mask));
+}
+
+// Integer image of a float that orders like the floats themselves
+static inline int32_t math_ordered(float x) {
+    int32_t i = math_to_bits(x);
+    return i ^ ((i >> 31) & 0x7fffffff);
+}
+
+// x clamped to [lo, hi] as integers (NaN ends up at one of the bounds)
+static inline float math_clamp(float x, float lo, float hi) {
+    int32_t i = math_ordered(x);
+    int32_t l = math_ordered(lo);
+    int32_t h = math_ordered(hi);
+    i = i < l ? l : i;
+    i = i > h ? h : i;
+    return math_from_bits(i ^ ((i >> 31) & 0x7fffffff));
+}
+
+// y, or NaN where x is NaN
+static inline float math_keep_nan(float y, float x) {
+    return math_from_bits(math_to_bits(y) | (math_mask(x != x) & 0x7fc00000));
+}
+
+// Nearest integer for |x| < 2^22: the addition rounds away the fraction
+static inline float math_round(float x) {
+    const float magic = 12582912.0f;  // 1.5 * 2^23
+    return (x + magic) - magic;
+}
+
+// x * 2^n for n in [-252, 254], in two steps so both factors are normal and
+// the result may still overflow to infinity or underflow to subnormals
+static inline float math_ldexp(float x, int32_t n) {
+    int32_t half = n / 2;
+    x *= math_from_bits((half + 127) << 23);
+    return x * math_from_bits((n - half + 127) << 23);
+}
+
+// Splits x = n ln 2 + r with |r| <= ln 2 / 2 and returns expm1(r), Taylor
+// to r^7 (relative error 4e-8) or to r^4 (1e-4, fast)
+static inline float math_exp_reduce(float x, int32_t* n, int fast) {
+    x = math_clamp(x, -104.0f, 89.0f);  // beyond these the result is 0 or inf anyway
+    float fn = math_round(x * MATH_LOG2E);
+    float r = (x - fn * MATH_LN2_HI) - fn * MATH_LN2_LO;
+    *n = (int32_t)fn;
+
+    float p;
+    if (fast) {
+        p = 1.0f / 2 + r * (1.0f / 6 + r * (1.0f / 24));
+    } else {
+        p = 1.0f / 2 + r * (1.0f / 6 + r * (1.0f / 24 + r * (1.0f / 120 +
+            r * (1.0f / 720 + r * (1.0f / 5040)))));
+    }
+    return r + r * r * p;
+}
+
+static inline float math_exp(float x, int fast) {
+    int32_t n;
+    float q = math_exp_reduce(x, &n, fast);
+    return math_keep_nan(math_ldexp(1.0f + q, n), x);
+}
+
+// exp(x) - 1 without the cancellation near 0
+static inline float math_expm1(float x, int fast) {
+    int32_t n;
+    float q = math_exp_reduce(x, &n, fast);
+    return math_keep_nan(math_ldexp(q, n) + (math_ldexp(1.0f, n) - 1.0f), x);
+}
+
+// log(1 + x) = e ln 2 + log(m) for 1 + x = m 2^e, m in [sqrt(1/2), sqrt(2)),
+// with log(m) = 2 atanh(s), s = (m - 1) / (m + 1) and |s| <= 0.172 (series
+// to s^9, relative error 1e-9, or to s^3, 2e-4 fast). The rounding of
+// u = 1 + x is corrected by (x - (u - 1)) / u, to first order.
+static inline float math_log1p(float x, int fast) {
+    // The arithmetic below is kept finite for any x (infinity steps down
+    // to FLT_MAX, u moves off 0 at x = -1); the special results are added
+    // in at the end
+    int32_t is_inf = math_mask(x == INFINITY);
+    float xc = math_from_bits(math_to_bits(x) + is_inf);
+    float u = (1.0f + xc) + 1.17549435e-38f;
+
+    // Offsetting the bits by those of sqrt(1/2) moves the exponent step to
+    // m = sqrt(2), so e and m need no compare. Unsigned, since the offset
+    // carries into the sign bit for NaN and huge u
+    uint32_t bits = (uint32_t)math_to_bits(u) + (0x3f800000u - 0x3f3504f3u);
+    int32_t e = (int32_t)(bits >> 23) - 127;
+    float m = math_from_bits((int32_t)((bits & 0x007fffffu) + 0x3f3504f3u));
+
+    float s = (m - 1.0f) / (m + 1.0f);
+    float s2 = s * s;
+    float p;
+    if (fast) {
+        p = 1.0f / 3;
+    } else {
+        p = 1.0f / 3 + s2 * (1.0f / 5 + s2 * (1.0f / 7 + s2 * (1.0f / 9)));
+    }
+    float fe = (float)e;
+    float y = fe * MATH_LN2_HI + (2.0f * s + 2.0f * s * s2 * p + fe * MATH_LN2_LO);
+    y += (xc - (u - 1.0f)) / u;
+
+    int32_t special = (is_inf & math_to_bits(INFINITY)) |
+                      (math_mask(x == -1.0f) & math_to_bits(-INFINITY)) |
+                      (math_mask(x < -1.0f) & math_to_bits(NAN));
+    return y + math_from_bits(special);
+}
+
+// tanh |x| = -e / (e + 2) with e = expm1(-2 |x|), which stays in (-1, 0]
+static inline float math_tanh(float x, int fast) {
+    float e = math_expm1(-2.0f * fabsf(x), fast);
+    return copysignf(-e / (e + 2.0f), x);
+}
+
+static inline float math_sigmoid(float x, int fast) {
+    return 1.0f / (1.0f + math_exp(-x, fast));
+}
+
+// Taylor series of erf below |x| = 0.5 (to x^11, or x^7 fast); above, erfc
+// from the Chebyshev fit of Numerical Recipes (erfcc, fractional error
+// 1.2e-7) around math_exp
+static inline float math_erf(float x, int fast) {
+    float a = math_clamp(fabsf(x), 0.0f, 4.0f);  // erf(4) rounds to 1
+    float a2 = a * a;
+
+    float p;
+    if (fast) {
+        p = 1.0f + a2 * (-1.0f / 3 + a2 * (1.0f / 10 + a2 * (-1.0f / 42)));
+    } else {
+        p = 1.0f + a2 * (-1.0f / 3 + a2 * (1.0f / 10 + a2 * (-1.0f / 42 +
+            a2 * (1.0f / 216 + a2 * (-1.0f / 1320)))));
+    }
+    float small = 1.12837916709551257f * a * p;  // 2 / sqrt(pi)
+
+    float t = 1.0f / (1.0f + 0.5f * a);
+    float c = -1.26551223f + t * (1.00002368f + t * (0.37409196f + t * (0.09678418f +
+              t * (-0.18628806f + t * (0.27886807f + t * (-1.13520398f + t * (1.48851587f +
+              t * (-0.82215223f + t * 0.17087277f))))))));
+    float large = 1.0f - t * math_exp(c - a2, fast);
+
+    return math_keep_nan(copysignf(math_select(math_mask(a < 0.5f), small, large), x), x);
+}
+
+// vecops.h
+static void vec_exp_kernel(float* x, size_t n, VecMathPrecision precision) {
+    if (precision == VEC_MATH_PRECISE) {
+        for (size_t i = 0; i < n; i++) x[i] = expf(x[i]);
+        return;
+    }
+    MATH_LOOP(precision, n, x[i] = math_exp(x[i], fast));
+}
+
+static void vec_tanh_kernel(float* x, size_t n, VecMathPrecision precision) {
+    if (precision == VEC_MATH_PRECISE) {
+        for (size_t i = 0; i < n; i++) x[i] = tanhf(x[i]);
+        return;
+    }
+    MATH_LOOP(precision, n, x[i] = math_tanh(x[i], fast));
+}
+
+static void vec_sigmoid_kernel(float* x, size_t n, VecMathPrecision precision) {
+    if (precision == VEC_MATH_PRECISE) {
+        for (size_t i = 0; i < n; i++) x[i] = 1.0f / (1.0f + expf(-x[i]));
+        return;
+    }
+    MATH_LOOP(precision, n, x[i] = math_sigmoid(x[i], fast));
+}
+
+static void vec_log1p_kernel(float* x, size_t n, VecMathPrecision precision) {
+    if (precision == VEC_MATH_PRECISE) {
+        for (size_t i = 0; i < n; i++) x[i] = log1pf(x[i]);
+        return;
+    }
+    MATH_LOOP(precision, n, x[i] = math_log1p(x[i], fast));
+}
+
+static void vec_erf_kernel(float* x, size_t n, VecMathPrecision precision) {
+    if (precision == VEC_MATH_PRECISE) {
+        for (size_t i = 0; i < n; i++) x[i] = erff(x[i]);
+        return;
+    }
+    MATH_LOOP(precision, n, x[i] = math_erf(x[i], fast));
+}
+
+#endif // MATH_KERNELS_H
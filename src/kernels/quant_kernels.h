@@ -0,0 +1,147 @@
+#ifndef QUANT_KERNELS_H
+#define QUANT_KERNELS_H
+
+// int8 dot-product kernels, compiled once per ISA variant (see
+// kernel_table.h). Each variant defines QUANT_M_BLOCK, QUANT_INPUT_OFFSET
+// and quant_kernel, which fill in a QuantKernel.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../quantize.h"
+
+#if defined(__AVX512VNNI__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Micro-kernels: int32 dot products of QUANT_M_BLOCK rows of int8
+// activations (a[r], each k long) with QUANT_N_BLOCK rows of int8 weights
+// (w, ldw apart), k a multiple of QUANT_K_ALIGN. out[r * QUANT_N_BLOCK + j]
+// receives row r times weight row j. Accumulators are named individually
+// for the same reason as in the GEMM kernels.
+//
+// QUANT_INPUT_OFFSET is added to every activation by kernels whose multiply
+// takes an unsigned left operand; the caller subtracts offset * sum(w).
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+
+#define QUANT_INPUT_OFFSET 128
+#define QUANT_M_BLOCK 4
+
+// Sum each of four vectors into one lane of the result
+static __m128i quant_reduce4(__m512i v0, __m512i v1, __m512i v2, __m512i v3) {
+    __m128i s[4];
+    __m512i v[4] = {v0, v1, v2, v3};
+    for (int i = 0; i < 4; i++) {
+        __m256i h = _mm256_add_epi32(_mm512_castsi512_si256(v[i]), _mm512_extracti64x4_epi64(v[i], 1));
+        s[i] = _mm_add_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+    }
+    return _mm_hadd_epi32(_mm_hadd_epi32(s[0], s[1]), _mm_hadd_epi32(s[2], s[3]));
+}
+
+// vpdpbusd multiplies unsigned by signed bytes and adds each group of four
+// products straight into an int32 lane, so nothing saturates
+#define QUANT_ROW(r)                                                            \
+    do {                                                                        \
+        __m512i av = _mm512_xor_si512(_mm512_loadu_si512((const void*)(a[r] + p)), flip); \
+        c##r##0 = _mm512_dpbusd_epi32(c##r##0, av, w0);                         \
+        c##r##1 = _mm512_dpbusd_epi32(c##r##1, av, w1);                         \
+        c##r##2 = _mm512_dpbusd_epi32(c##r##2, av, w2);                         \
+        c##r##3 = _mm512_dpbusd_epi32(c##r##3, av, w3);                         \
+    } while (0)
+
+#define QUANT_ROW_STORE(r) \
+    _mm_storeu_si128((__m128i*)(out + (r) * QUANT_N_BLOCK), quant_reduce4(c##r##0, c##r##1, c##r##2, c##r##3))
+
+static void quant_kernel(const int8_t* const* a, const int8_t* w, size_t ldw, size_t k,
+                         int32_t* out) {
+    const __m512i flip = _mm512_set1_epi8((char)0x80);
+    __m512i c00 = _mm512_setzero_si512(), c01 = _mm512_setzero_si512();
+    __m512i c02 = _mm512_setzero_si512(), c03 = _mm512_setzero_si512();
+    __m512i c10 = _mm512_setzero_si512(), c11 = _mm512_setzero_si512();
+    __m512i c12 = _mm512_setzero_si512(), c13 = _mm512_setzero_si512();
+    __m512i c20 = _mm512_setzero_si512(), c21 = _mm512_setzero_si512();
+    __m512i c22 = _mm512_setzero_si512(), c23 = _mm512_setzero_si512();
+    __m512i c30 = _mm512_setzero_si512(), c31 = _mm512_setzero_si512();
+    __m512i c32 = _mm512_setzero_si512(), c33 = _mm512_setzero_si512();
+
+    for (size_t p = 0; p < k; p += 64) {
+        __m512i w0 = _mm512_loadu_si512((const void*)(w + p));
+        __m512i w1 = _mm512_loadu_si512((const void*)(w + ldw + p));
+        __m512i w2 = _mm512_loadu_si512((const void*)(w + 2 * ldw + p));
+        __m512i w3 = _mm512_loadu_si512((const void*)(w + 3 * ldw + p));
+        QUANT_ROW(0);
+        QUANT_ROW(1);
+        QUANT_ROW(2);
+        QUANT_ROW(3);
+    }
+
+    QUANT_ROW_STORE(0);
+    QUANT_ROW_STORE(1);
+    QUANT_ROW_STORE(2);
+    QUANT_ROW_STORE(3);
+}
+
+#elif defined(__AVX2__)
+
+#define QUANT_INPUT_OFFSET 0
+#define QUANT_M_BLOCK 2
+
+static __m128i quant_reduce4(__m256i v0, __m256i v1, __m256i v2, __m256i v3) {
+    __m128i s0 = _mm_add_epi32(_mm256_castsi256_si128(v0), _mm256_extracti128_si256(v0, 1));
+    __m128i s1 = _mm_add_epi32(_mm256_castsi256_si128(v1), _mm256_extracti128_si256(v1, 1));
+    __m128i s2 = _mm_add_epi32(_mm256_castsi256_si128(v2), _mm256_extracti128_si256(v2, 1));
+    __m128i s3 = _mm_add_epi32(_mm256_castsi256_si128(v3), _mm256_extracti128_si256(v3, 1));
+    return _mm_hadd_epi32(_mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3));
+}
+
+// vpmaddubsw would saturate its int16 pair sums (2 * 255 * 127 > 32767),
+// so both operands are sign-extended to int16 and vpmaddwd produces exact
+// int32 pair sums instead
+#define QUANT_ROW(r)                                                            \
+    do {                                                                        \
+        __m256i av = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a[r] + p))); \
+        c##r##0 = _mm256_add_epi32(c##r##0, _mm256_madd_epi16(av, w0));         \
+        c##r##1 = _mm256_add_epi32(c##r##1, _mm256_madd_epi16(av, w1));         \
+        c##r##2 = _mm256_add_epi32(c##r##2, _mm256_madd_epi16(av, w2));         \
+        c##r##3 = _mm256_add_epi32(c##r##3, _mm256_madd_epi16(av, w3));         \
+    } while (0)
+
+#define QUANT_LOAD_W(j) _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(w + (j) * ldw + p)))
+
+static void quant_kernel(const int8_t* const* a, const int8_t* w, size_t ldw, size_t k,
+                         int32_t* out) {
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c02 = _mm256_setzero_si256(), c03 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c12 = _mm256_setzero_si256(), c13 = _mm256_setzero_si256();
+
+    for (size_t p = 0; p < k; p += 16) {
+        __m256i w0 = QUANT_LOAD_W(0), w1 = QUANT_LOAD_W(1);
+        __m256i w2 = QUANT_LOAD_W(2), w3 = QUANT_LOAD_W(3);
+        QUANT_ROW(0);
+        QUANT_ROW(1);
+    }
+
+    _mm_storeu_si128((__m128i*)out, quant_reduce4(c00, c01, c02, c03));
+    _mm_storeu_si128((__m128i*)(out + QUANT_N_BLOCK), quant_reduce4(c10, c11, c12, c13));
+}
+
+#else
+
+#define QUANT_INPUT_OFFSET 0
+#define QUANT_M_BLOCK 1
+
+static void quant_kernel(const int8_t* const* a, const int8_t* w, size_t ldw, size_t k,
+                         int32_t* out) {
+    for (int j = 0; j < QUANT_N_BLOCK; j++) {
+        const int8_t* wj = w + j * ldw;
+        int32_t sum = 0;
+        for (size_t p = 0; p < k; p++) {
+            sum += (int32_t)a[0][p] * wj[p];
+        }
+        out[j] = sum;
+    }
+}
+
+#endif
+
+#endif // QUANT_KERNELS_H
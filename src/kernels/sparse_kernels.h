@@ -0,0 +1,59 @@
+#ifndef SPARSE_KERNELS_H
+#define SPARSE_KERNELS_H
+
+// Inner loop of sparse_gemm, compiled once per ISA variant (see
+// kernel_table.h)
+
+#include <stddef.h>
+#include "../sparse.h"
+
+// acc[0 .. SPARSE_ROW_GROUP) += w * x[0 .. SPARSE_ROW_GROUP), one vector FMA
+static inline void sparse_fma(float* restrict acc, float w, const float* restrict x) {
+    #pragma omp simd
+    for (size_t r = 0; r < SPARSE_ROW_GROUP; r++) acc[r] += w * x[r];
+}
+
+static void sparse_block_row_kernel(const SparseMatrix* s, size_t P, const float* at,
+                                    const float* bias, float* out) {
+    size_t br = s->block_rows;
+    size_t bc = s->block_cols;
+    size_t block_size = br * bc;
+    size_t begin = s->row_ptr[P];
+    size_t end = s->row_ptr[P + 1];
+
+    for (size_t rr = 0; rr < br && P * br + rr < s->rows; rr++) {
+        size_t j = P * br + rr;
+
+        // Two accumulators take alternate blocks to hide the FMA latency
+        float acc0[SPARSE_ROW_GROUP], acc1[SPARSE_ROW_GROUP];
+        float b = bias ? bias[j] : 0.0f;
+        for (size_t r = 0; r < SPARSE_ROW_GROUP; r++) {
+            acc0[r] = b;
+            acc1[r] = 0.0f;
+        }
+
+        size_t e = begin;
+        for (; e + 1 < end; e += 2) {
+            const float* w0 = s->values + e * block_size + rr * bc;
+            const float* w1 = w0 + block_size;
+            const float* x0 = at + s->col_idx[e] * bc * SPARSE_ROW_GROUP;
+            const float* x1 = at + s->col_idx[e + 1] * bc * SPARSE_ROW_GROUP;
+            for (size_t jj = 0; jj < bc; jj++) {
+                sparse_fma(acc0, w0[jj], x0 + jj * SPARSE_ROW_GROUP);
+                sparse_fma(acc1, w1[jj], x1 + jj * SPARSE_ROW_GROUP);
+            }
+        }
+        if (e < end) {
+            const float* w0 = s->values + e * block_size + rr * bc;
+            const float* x0 = at + s->col_idx[e] * bc * SPARSE_ROW_GROUP;
+            for (size_t jj = 0; jj < bc; jj++) {
+                sparse_fma(acc0, w0[jj], x0 + jj * SPARSE_ROW_GROUP);
+            }
+        }
+
+        float* dst = out + j * SPARSE_ROW_GROUP;
+        for (size_t r = 0; r < SPARSE_ROW_GROUP; r++) dst[r] = acc0[r] + acc1[r];
+    }
+}
+
+#endif // SPARSE_KERNELS_H
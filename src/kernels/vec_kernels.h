@@ -0,0 +1,538 @@
+#ifndef VEC_KERNELS_H
+#define VEC_KERNELS_H
+
+// Kernels behind vecops.h. Like the other *_kernels.h headers this is
+// compiled once per ISA variant (see kernel_table.h), with the vector width
+// picked from the target macros of that translation unit.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// Widest vector unit the build targets. Loops process two vectors per
+// iteration to hide load latency, then one vector, then a scalar tail.
+#if defined(__AVX512F__)
+
+#define VEC_WIDTH 16
+typedef __m512 VecF;
+#define VEC_LOAD(p)        _mm512_loadu_ps(p)
+#define VEC_STORE(p, v)    _mm512_storeu_ps(p, v)
+#define VEC_SET1(s)        _mm512_set1_ps(s)
+#define VEC_ADD(a, b)      _mm512_add_ps(a, b)
+#define VEC_SUB(a, b)      _mm512_sub_ps(a, b)
+#define VEC_MUL(a, b)      _mm512_mul_ps(a, b)
+#define VEC_DIV(a, b)      _mm512_div_ps(a, b)
+#define VEC_SQRT(a)        _mm512_sqrt_ps(a)
+#define VEC_FMADD(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define VEC_MAX(a, b)      _mm512_max_ps(a, b)
+#define VEC_MIN(a, b)      _mm512_min_ps(a, b)
+
+#elif defined(__AVX__)
+
+#define VEC_WIDTH 8
+typedef __m256 VecF;
+#define VEC_LOAD(p)        _mm256_loadu_ps(p)
+#define VEC_STORE(p, v)    _mm256_storeu_ps(p, v)
+#define VEC_SET1(s)        _mm256_set1_ps(s)
+#define VEC_ADD(a, b)      _mm256_add_ps(a, b)
+#define VEC_SUB(a, b)      _mm256_sub_ps(a, b)
+#define VEC_MUL(a, b)      _mm256_mul_ps(a, b)
+#define VEC_DIV(a, b)      _mm256_div_ps(a, b)
+#define VEC_SQRT(a)        _mm256_sqrt_ps(a)
+#ifdef __FMA__
+#define VEC_FMADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+#else
+#define VEC_FMADD(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif
+#define VEC_MAX(a, b)      _mm256_max_ps(a, b)
+#define VEC_MIN(a, b)      _mm256_min_ps(a, b)
+
+#elif defined(__SSE2__)
+
+#define VEC_WIDTH 4
+typedef __m128 VecF;
+#define VEC_LOAD(p)        _mm_loadu_ps(p)
+#define VEC_STORE(p, v)    _mm_storeu_ps(p, v)
+#define VEC_SET1(s)        _mm_set1_ps(s)
+#define VEC_ADD(a, b)      _mm_add_ps(a, b)
+#define VEC_SUB(a, b)      _mm_sub_ps(a, b)
+#define VEC_MUL(a, b)      _mm_mul_ps(a, b)
+#define VEC_DIV(a, b)      _mm_div_ps(a, b)
+#define VEC_SQRT(a)        _mm_sqrt_ps(a)
+#define VEC_FMADD(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define VEC_MAX(a, b)      _mm_max_ps(a, b)
+#define VEC_MIN(a, b)      _mm_min_ps(a, b)
+
+#endif
+
+// x[i] = x[i] OP y[i]
+#ifdef VEC_WIDTH
+#define VEC_BINARY_LOOP(VOP, SOP)                                       \
+    size_t i = 0;                                                       \
+    for (; i + 2 * VEC_WIDTH <= n; i += 2 * VEC_WIDTH) {                \
+        VecF x0 = VEC_LOAD(x + i), x1 = VEC_LOAD(x + i + VEC_WIDTH);    \
+        VecF y0 = VEC_LOAD(y + i), y1 = VEC_LOAD(y + i + VEC_WIDTH);    \
+        VEC_STORE(x + i, VOP(x0, y0));                                  \
+        VEC_STORE(x + i + VEC_WIDTH, VOP(x1, y1));                      \
+    }                                                                   \
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {                        \
+        VEC_STORE(x + i, VOP(VEC_LOAD(x + i), VEC_LOAD(y + i)));        \
+    }                                                                   \
+    for (; i < n; i++) {                                                \
+        x[i] = x[i] SOP y[i];                                           \
+    }
+#else
+#define VEC_BINARY_LOOP(VOP, SOP)                                       \
+    for (size_t i = 0; i < n; i++) {                                    \
+        x[i] = x[i] SOP y[i];                                           \
+    }
+#endif
+
+// x[i] = x[i] OP scalar
+#ifdef VEC_WIDTH
+#define VEC_SCALAR_LOOP(VOP, SOP)                                       \
+    VecF s = VEC_SET1(scalar);                                          \
+    size_t i = 0;                                                       \
+    for (; i + 2 * VEC_WIDTH <= n; i += 2 * VEC_WIDTH) {                \
+        VecF x0 = VEC_LOAD(x + i), x1 = VEC_LOAD(x + i + VEC_WIDTH);    \
+        VEC_STORE(x + i, VOP(x0, s));                                   \
+        VEC_STORE(x + i + VEC_WIDTH, VOP(x1, s));                       \
+    }                                                                   \
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {                        \
+        VEC_STORE(x + i, VOP(VEC_LOAD(x + i), s));                      \
+    }                                                                   \
+    for (; i < n; i++) {                                                \
+        x[i] = x[i] SOP scalar;                                         \
+    }
+#else
+#define VEC_SCALAR_LOOP(VOP, SOP)                                       \
+    for (size_t i = 0; i < n; i++) {                                    \
+        x[i] = x[i] SOP scalar;                                         \
+    }
+#endif
+
+// Leaf size of the pairwise summation tree. Leaves are summed with
+// several vector accumulators; the error bound grows with log2(n / leaf)
+// instead of n.
+#define VEC_SUM_LEAF 256
+
+// Accumulator lanes per leaf, the same on every variant (two vectors on
+// AVX-512, four on AVX2, eight on SSE, scalars on generic), so a sum is
+// bit-identical whichever kernel table runs it
+#define VEC_SUM_LANES 32
+
+static float vec_sum_leaf(const float* x, size_t n) {
+    float lanes[VEC_SUM_LANES] = {0.0f};
+    size_t i = 0;
+#ifdef VEC_WIDTH
+    VecF acc[VEC_SUM_LANES / VEC_WIDTH];
+    for (size_t a = 0; a < VEC_SUM_LANES / VEC_WIDTH; a++) {
+        acc[a] = VEC_SET1(0.0f);
+    }
+    for (; i + VEC_SUM_LANES <= n; i += VEC_SUM_LANES) {
+        for (size_t a = 0; a < VEC_SUM_LANES / VEC_WIDTH; a++) {
+            acc[a] = VEC_ADD(acc[a], VEC_LOAD(x + i + a * VEC_WIDTH));
+        }
+    }
+    for (size_t a = 0; a < VEC_SUM_LANES / VEC_WIDTH; a++) {
+        VEC_STORE(lanes + a * VEC_WIDTH, acc[a]);
+    }
+#else
+    for (; i + VEC_SUM_LANES <= n; i += VEC_SUM_LANES) {
+        for (size_t l = 0; l < VEC_SUM_LANES; l++) {
+            lanes[l] += x[i + l];
+        }
+    }
+#endif
+    // The tail goes into the first lanes, then the lanes fold pairwise
+    for (size_t l = 0; i + l < n; l++) {
+        lanes[l] += x[i + l];
+    }
+    for (size_t w = VEC_SUM_LANES / 2; w > 0; w /= 2) {
+        for (size_t l = 0; l < w; l++) {
+            lanes[l] += lanes[l + w];
+        }
+    }
+    return lanes[0];
+}
+
+static float vec_sum_kernel(const float* x, size_t n) {
+    if (n <= VEC_SUM_LEAF) return vec_sum_leaf(x, n);
+    // Split on a leaf boundary so the tree depends only on n
+    size_t half = (n / 2 + VEC_SUM_LEAF - 1) / VEC_SUM_LEAF * VEC_SUM_LEAF;
+    return vec_sum_kernel(x, half) + vec_sum_kernel(x + half, n - half);
+}
+
+// OP is VEC_MAX/VEC_MIN, CMP is > or <; n must be > 0
+#ifdef VEC_WIDTH
+#define VEC_EXTREME(VOP, CMP)                                           \
+    size_t i = 0;                                                       \
+    float best = x[0];                                                  \
+    if (n >= VEC_WIDTH) {                                               \
+        VecF acc = VEC_LOAD(x);                                         \
+        for (i = VEC_WIDTH; i + VEC_WIDTH <= n; i += VEC_WIDTH) {       \
+            acc = VOP(acc, VEC_LOAD(x + i));                            \
+        }                                                               \
+        float lanes[VEC_WIDTH];                                         \
+        VEC_STORE(lanes, acc);                                          \
+        best = lanes[0];                                                \
+        for (size_t l = 1; l < VEC_WIDTH; l++) {                        \
+            if (lanes[l] CMP best) best = lanes[l];                     \
+        }                                                               \
+    }                                                                   \
+    for (; i < n; i++) {                                                \
+        if (x[i] CMP best) best = x[i];                                 \
+    }                                                                   \
+    return best;
+#else
+#define VEC_EXTREME(VOP, CMP)                                           \
+    float best = x[0];                                                  \
+    for (size_t i = 1; i < n; i++) {                                    \
+        if (x[i] CMP best) best = x[i];                                 \
+    }                                                                   \
+    return best;
+#endif
+
+static float vec_max_kernel(const float* x, size_t n) {
+    VEC_EXTREME(VEC_MAX, >)
+}
+
+static float vec_min_kernel(const float* x, size_t n) {
+    VEC_EXTREME(VEC_MIN, <)
+}
+
+static void vec_copy_kernel(float* dst, const float* src, size_t n) {
+    if (dst != src) memcpy(dst, src, n * sizeof(float));
+}
+
+static void vec_fill_kernel(float* x, float value, size_t n) {
+    // +0.0f is all-zero bits, so memset is exact (-0.0f is not)
+    float zero = 0.0f;
+    if (memcmp(&value, &zero, sizeof(float)) == 0) {
+        memset(x, 0, n * sizeof(float));
+        return;
+    }
+
+#ifdef VEC_WIDTH
+    VecF v = VEC_SET1(value);
+    size_t i = 0;
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VEC_STORE(x + i, v);
+    }
+    for (; i < n; i++) {
+        x[i] = value;
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        x[i] = value;
+    }
+#endif
+}
+
+static void vec_add_kernel(float* x, const float* y, size_t n) {
+    VEC_BINARY_LOOP(VEC_ADD, +)
+}
+
+static void vec_sub_kernel(float* x, const float* y, size_t n) {
+    VEC_BINARY_LOOP(VEC_SUB, -)
+}
+
+static void vec_mul_kernel(float* x, const float* y, size_t n) {
+    VEC_BINARY_LOOP(VEC_MUL, *)
+}
+
+static void vec_scale_kernel(float* x, float scalar, size_t n) {
+    VEC_SCALAR_LOOP(VEC_MUL, *)
+}
+
+static void vec_add_scalar_kernel(float* x, float scalar, size_t n) {
+    VEC_SCALAR_LOOP(VEC_ADD, +)
+}
+
+static void vec_sqrt_kernel(float* x, size_t n) {
+    size_t i = 0;
+#ifdef VEC_WIDTH
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VEC_STORE(x + i, VEC_SQRT(VEC_LOAD(x + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        x[i] = sqrtf(x[i]);
+    }
+}
+
+static void vec_axpy_kernel(float* y, float alpha, const float* x, size_t n) {
+    size_t i = 0;
+#ifdef VEC_WIDTH
+    VecF va = VEC_SET1(alpha);
+    for (; i + 2 * VEC_WIDTH <= n; i += 2 * VEC_WIDTH) {
+        VecF y0 = VEC_FMADD(va, VEC_LOAD(x + i), VEC_LOAD(y + i));
+        VecF y1 = VEC_FMADD(va, VEC_LOAD(x + i + VEC_WIDTH), VEC_LOAD(y + i + VEC_WIDTH));
+        VEC_STORE(y + i, y0);
+        VEC_STORE(y + i + VEC_WIDTH, y1);
+    }
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VEC_STORE(y + i, VEC_FMADD(va, VEC_LOAD(x + i), VEC_LOAD(y + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+static void vec_axpby_kernel(float* y, float alpha, const float* x, float beta, size_t n) {
+    size_t i = 0;
+#ifdef VEC_WIDTH
+    VecF va = VEC_SET1(alpha);
+    VecF vb = VEC_SET1(beta);
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VecF by = VEC_MUL(vb, VEC_LOAD(y + i));
+        VEC_STORE(y + i, VEC_FMADD(va, VEC_LOAD(x + i), by));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = alpha * x[i] + beta * y[i];
+    }
+}
+
+static void vec_fma_kernel(float* y, float alpha, const float* a, const float* b, float beta, size_t n) {
+    size_t i = 0;
+#ifdef VEC_WIDTH
+    VecF va = VEC_SET1(alpha);
+    VecF vb = VEC_SET1(beta);
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VecF ab = VEC_MUL(VEC_LOAD(a + i), VEC_LOAD(b + i));
+        VecF by = VEC_MUL(vb, VEC_LOAD(y + i));
+        VEC_STORE(y + i, VEC_FMADD(va, ab, by));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] = alpha * a[i] * b[i] + beta * y[i];
+    }
+}
+
+static void vec_addcdiv_kernel(float* y, float value, const float* a, const float* b, float eps, size_t n) {
+    size_t i = 0;
+#ifdef VEC_WIDTH
+    VecF vv = VEC_SET1(value);
+    VecF ve = VEC_SET1(eps);
+    for (; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VecF den = VEC_ADD(VEC_SQRT(VEC_LOAD(b + i)), ve);
+        VecF q = VEC_DIV(VEC_LOAD(a + i), den);
+        VEC_STORE(y + i, VEC_FMADD(vv, q, VEC_LOAD(y + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        y[i] += value * a[i] / (sqrtf(b[i]) + eps);
+    }
+}
+
+static uint32_t vec_float_bits(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static float vec_bits_float(uint32_t bits) {
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static uint16_t vec_bf16_from_float(float x) {
+    uint32_t bits = vec_float_bits(x);
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+        return (uint16_t)((bits >> 16) | 0x0040u);  // Keep NaNs quiet
+    }
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return (uint16_t)(bits >> 16);
+}
+
+static float vec_f16_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1Fu;
+    uint32_t mant = h & 0x3FFu;
+
+    if (exp == 0x1F) return vec_bits_float(sign | 0x7F800000u | (mant << 13));
+    if (exp != 0) return vec_bits_float(sign | ((exp + 112) << 23) | (mant << 13));
+    if (mant == 0) return vec_bits_float(sign);
+
+    // Subnormal: shift the leading one into the implicit bit
+    exp = 113;
+    while (!(mant & 0x400u)) {
+        mant <<= 1;
+        exp--;
+    }
+    return vec_bits_float(sign | (exp << 23) | ((mant & 0x3FFu) << 13));
+}
+
+static uint16_t vec_f16_from_float(float x) {
+    uint32_t bits = vec_float_bits(x);
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t mag = bits & 0x7FFFFFFFu;
+
+    if (mag > 0x7F800000u) return (uint16_t)(sign | 0x7E00u);   // NaN
+    if (mag >= 0x477FF000u) return (uint16_t)(sign | 0x7C00u);  // Rounds past 65504
+    if (mag < 0x38800000u) {
+        // Below the smallest normal: adding 0.5 lines the f16 subnormal
+        // ulp (2^-24) up with the float ulp, so the FPU does the rounding
+        float r = vec_bits_float(mag) + 0.5f;
+        return (uint16_t)(sign | (vec_float_bits(r) - 0x3F000000u));
+    }
+    mag += ((uint32_t)(15 - 127) << 23) + 0xFFFu + ((mag >> 13) & 1u);
+    return (uint16_t)(sign | (mag >> 13));
+}
+
+static void vec_bf16_to_f32_kernel(float* dst, const uint16_t* src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        __m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(src + i)));
+        _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(_mm512_slli_epi32(h, 16)));
+    }
+#elif defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(h, 16)));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = vec_bits_float((uint32_t)src[i] << 16);
+    }
+}
+
+static void vec_f32_to_bf16_kernel(uint16_t* dst, const float* src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512BF16__) && defined(__AVX512VL__)
+    for (; i + 16 <= n; i += 16) {
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), (__m256i)h);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = vec_bf16_from_float(src[i]);
+    }
+}
+
+static void vec_f16_to_f32_kernel(float* dst, const uint16_t* src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(src + i))));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = vec_f16_to_float(src[i]);
+    }
+}
+
+static void vec_f32_to_f16_kernel(uint16_t* dst, const float* src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm256_storeu_si256((__m256i*)(dst + i), h);
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + i), h);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = vec_f16_from_float(src[i]);
+    }
+}
+
+#if defined(__AVX__)
+
+// Transpose eight rows held in registers: pairs of rows are interleaved,
+// then pairs of pairs, then the 128-bit halves are swapped across
+static void vec_transpose_regs(__m256 r[8]) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+static void vec_transpose_8x8_kernel(float* dst, size_t ldd, const float* src, size_t lds) {
+    __m256 r[8];
+    for (int i = 0; i < 8; i++) r[i] = _mm256_loadu_ps(src + i * lds);
+    vec_transpose_regs(r);
+    for (int i = 0; i < 8; i++) _mm256_storeu_ps(dst + i * ldd, r[i]);
+}
+
+static void vec_transpose_swap_8x8_kernel(float* a, float* b, size_t ld) {
+    __m256 ra[8], rb[8];
+    for (int i = 0; i < 8; i++) ra[i] = _mm256_loadu_ps(a + i * ld);
+    vec_transpose_regs(ra);
+    if (a == b) {
+        for (int i = 0; i < 8; i++) _mm256_storeu_ps(a + i * ld, ra[i]);
+        return;
+    }
+    for (int i = 0; i < 8; i++) rb[i] = _mm256_loadu_ps(b + i * ld);
+    vec_transpose_regs(rb);
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_ps(a + i * ld, rb[i]);
+        _mm256_storeu_ps(b + i * ld, ra[i]);
+    }
+}
+
+#else
+
+static void vec_transpose_8x8_kernel(float* dst, size_t ldd, const float* src, size_t lds) {
+    for (size_t i = 0; i < 8; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            dst[j * ldd + i] = src[i * lds + j];
+        }
+    }
+}
+
+static void vec_transpose_swap_8x8_kernel(float* a, float* b, size_t ld) {
+    float ta[64], tb[64];
+    vec_transpose_8x8_kernel(ta, 8, a, ld);
+    if (a == b) {
+        for (size_t i = 0; i < 8; i++) memcpy(a + i * ld, ta + i * 8, 8 * sizeof(float));
+        return;
+    }
+    vec_transpose_8x8_kernel(tb, 8, b, ld);
+    for (size_t i = 0; i < 8; i++) {
+        memcpy(a + i * ld, tb + i * 8, 8 * sizeof(float));
+        memcpy(b + i * ld, ta + i * 8, 8 * sizeof(float));
+    }
+}
+
+#endif
+
+#endif // VEC_KERNELS_H
@@ -0,0 +1,109 @@
+#ifndef WINOGRAD_KERNELS_H
+#define WINOGRAD_KERNELS_H
+
+// Input and output transforms of Winograd F(2x2, 3x3) and F(4x4, 3x3)
+// (see conv_forward_winograd), compiled once per ISA variant (see
+// kernel_table.h). The transforms are written out for one column of a
+// tile and run over CONV_WINOGRAD_LANES tiles at a time, so the SIMD lanes
+// take one tile each.
+
+#include <stddef.h>
+#include "../conv.h"
+
+// y = B^T x for one column of m + 2 values, x and y strided
+static inline void winograd_input_1d(size_t m, const float* x, size_t xs, float* y,
+                                     size_t ys) {
+    if (m == 2) {
+        float x0 = x[0], x1 = x[xs], x2 = x[2 * xs], x3 = x[3 * xs];
+        y[0] = x0 - x2;
+        y[ys] = x1 + x2;
+        y[2 * ys] = x2 - x1;
+        y[3 * ys] = x1 - x3;
+    } else {
+        float x0 = x[0], x1 = x[xs], x2 = x[2 * xs], x3 = x[3 * xs], x4 = x[4 * xs],
+              x5 = x[5 * xs];
+        y[0] = 4.0f * x0 - 5.0f * x2 + x4;
+        y[ys] = -4.0f * (x1 + x2) + x3 + x4;
+        y[2 * ys] = 4.0f * (x1 - x2) - x3 + x4;
+        y[3 * ys] = 2.0f * (x3 - x1) - x2 + x4;
+        y[4 * ys] = 2.0f * (x1 - x3) - x2 + x4;
+        y[5 * ys] = 4.0f * x1 - 5.0f * x3 + x5;
+    }
+}
+
+// y = A^T x for one column of m + 2 values
+static inline void winograd_output_1d(size_t m, const float* x, size_t xs, float* y,
+                                      size_t ys) {
+    if (m == 2) {
+        float x0 = x[0], x1 = x[xs], x2 = x[2 * xs], x3 = x[3 * xs];
+        y[0] = x0 + x1 + x2;
+        y[ys] = x1 - x2 - x3;
+    } else {
+        float x0 = x[0], x1 = x[xs], x2 = x[2 * xs], x3 = x[3 * xs], x4 = x[4 * xs],
+              x5 = x[5 * xs];
+        float s12 = x1 + x2, d12 = x1 - x2, s34 = x3 + x4, d34 = x3 - x4;
+        y[0] = x0 + s12 + s34;
+        y[ys] = d12 + 2.0f * d34;
+        y[2 * ys] = s12 + 4.0f * s34;
+        y[3 * ys] = d12 + 8.0f * d34 + x5;
+    }
+}
+
+// B^T d B for CONV_WINOGRAD_LANES tiles at once. Called with a constant m
+// so the transforms inline into loops over the lanes.
+static inline void winograd_input_block(size_t m, const float* d, float* v) {
+    const size_t alpha = m + 2, lanes = CONV_WINOGRAD_LANES;
+    float tmp[CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_LANES];
+    for (size_t j = 0; j < alpha; j++) {
+        #pragma omp simd
+        for (size_t l = 0; l < lanes; l++) {
+            winograd_input_1d(m, d + j * lanes + l, alpha * lanes, tmp + j * lanes + l,
+                              alpha * lanes);
+        }
+    }
+    for (size_t i = 0; i < alpha; i++) {
+        #pragma omp simd
+        for (size_t l = 0; l < lanes; l++) {
+            winograd_input_1d(m, tmp + i * alpha * lanes + l, lanes, v + i * alpha * lanes + l,
+                              lanes);
+        }
+    }
+}
+
+// A^T p A for CONV_WINOGRAD_LANES tiles
+static inline void winograd_output_block(size_t m, const float* p, float* y) {
+    const size_t alpha = m + 2, lanes = CONV_WINOGRAD_LANES;
+    float tmp[CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_LANES];
+    for (size_t j = 0; j < alpha; j++) {
+        #pragma omp simd
+        for (size_t l = 0; l < lanes; l++) {
+            winograd_output_1d(m, p + j * lanes + l, alpha * lanes, tmp + j * lanes + l,
+                               alpha * lanes);
+        }
+    }
+    for (size_t i = 0; i < m; i++) {
+        #pragma omp simd
+        for (size_t l = 0; l < lanes; l++) {
+            winograd_output_1d(m, tmp + i * alpha * lanes + l, lanes, y + i * m * lanes + l,
+                               lanes);
+        }
+    }
+}
+
+static void winograd_input_kernel(size_t m, const float* d, float* v) {
+    if (m == 2) {
+        winograd_input_block(2, d, v);
+    } else {
+        winograd_input_block(4, d, v);
+    }
+}
+
+static void winograd_output_kernel(size_t m, const float* p, float* y) {
+    if (m == 2) {
+        winograd_output_block(2, p, y);
+    } else {
+        winograd_output_block(4, p, y);
+    }
+}
+
+#endif // WINOGRAD_KERNELS_H
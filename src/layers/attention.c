@@ -1,6 +1,7 @@
 #include "layer.h"
 #include "../activations/activation.h"
 #include <stdlib.h>
+#include <assert.h>
 #include <string.h>
 #include <math.h>
 
@@ -9,37 +10,52 @@ static void attention_forward(Layer* layer, const Matrix* input) {
     // Simplified self-attention implementation
     // input shape: [batch_size, seq_len, embed_size]
     
-    if (layer->input) matrix_free(layer->input);
-    // Create a copy of the input matrix
-    layer->input = matrix_create(input->rows, input->cols);
-    matrix_copy(layer->input, input);
+    // Keep a copy of the input for training; the buffer is reused while the
+    // shape holds. Inference reads the caller's input in place.
+    const Matrix* x = input;
+    if (layer->is_training) {
+        layer->input = matrix_ensure(layer->input, input->rows, input->cols);
+        matrix_copy(layer->input, input);
+        x = layer->input;
+    }
     
     // For simplicity, we'll assume input is already projected to Q, K, V
     // In a real implementation, we would have learnable projection matrices
     
-    // Compute attention scores: Q * K^T / sqrt(d_k)
-    Matrix* scores = matrix_create(input->rows, input->rows); // [seq_len, seq_len]
+    // Heads attend over their own slice of head_size embedding columns
+    size_t seq_len = input->rows;
+    size_t heads = (size_t)layer->heads;
+    assert(input->cols % heads == 0);
+    size_t head_size = input->cols / heads;
     
-    // Simplified: just use input as Q, K, V
-    Matrix* k_t = matrix_create(input->cols, input->rows);
-    matrix_transpose(input, k_t);
+    // Attention scores of every head, stacked: Q_h * K_h^T / sqrt(d_k)
+    Matrix* scores = workspace_matrix(layer->workspace, heads * seq_len, seq_len);
     
-    matrix_multiply(input, k_t, scores);
-    matrix_scale(scores, 1.0f / sqrtf(input->cols));
+    // Simplified: just use input as Q, K, V. K^T is read in place and the
+    // 1/sqrt(d_k) scaling is folded into the GEMM. All heads run as one
+    // batched GEMM: head h starts h * head_size columns into the input and
+    // h * seq_len rows into the scores.
+    Matrix* x0 = matrix_wrap(x->data, seq_len, head_size, x->stride);
+    Matrix* scores0 = matrix_view(scores, 0, 0, seq_len, seq_len);
+    matrix_gemm_batched(MATRIX_NO_TRANS, MATRIX_TRANS, 1.0f / sqrtf((float)head_size),
+                        x0, head_size, x0, head_size,
+                        0.0f, scores0, seq_len * scores->stride, heads);
     
     // Apply softmax to get attention weights
     activate(scores, ACTIVATION_SOFTMAX);
     
-    // Apply attention to values: weights * V
-    if (!layer->output) {
-        layer->output = matrix_create(input->rows, input->cols);
-    }
-    
-    matrix_multiply(scores, input, layer->output);
+    // Apply attention to values: weights_h * V_h, written to the head's columns
+    layer->output = matrix_ensure(layer->output, input->rows, input->cols);
+    Matrix* out0 = matrix_view(layer->output, 0, 0, seq_len, head_size);
+    matrix_gemm_batched(MATRIX_NO_TRANS, MATRIX_NO_TRANS, 1.0f,
+                        scores0, seq_len * scores->stride, x0, head_size,
+                        0.0f, out0, head_size, heads);
     
     // Clean up
+    matrix_free(out0);
+    matrix_free(scores0);
+    matrix_free(x0);
     matrix_free(scores);
-    matrix_free(k_t);
 }
 
 // Backward pass for attention layer
@@ -70,11 +86,14 @@ static void attention_free(Layer* layer) {
 
 // Create an attention layer
 Layer* attention_layer(int embed_size, int heads) {
+    assert(heads > 0 && embed_size % heads == 0);
+    
     Layer* layer = (Layer*)malloc(sizeof(Layer));
     memset(layer, 0, sizeof(Layer));
     
     layer->type = LAYER_ATTENTION;
     strcpy(layer->name, "attention");
+    layer->is_training = 1;  // Default to training mode
     layer->input_size = embed_size;
     layer->output_size = embed_size;
     layer->heads = heads;
@@ -6,13 +6,12 @@
 // Forward pass for batch normalization layer
 static void batchnorm_forward(Layer* layer, const Matrix* input) {
     // Simplified implementation - just pass through for now
-    if (layer->input) matrix_free(layer->input);
-    layer->input = matrix_create(input->rows, input->cols);
-    matrix_copy(layer->input, input);
-    
-    if (!layer->output) {
-        layer->output = matrix_create(input->rows, input->cols);
+    if (layer->is_training) {
+        layer->input = matrix_ensure(layer->input, input->rows, input->cols);
+        matrix_copy(layer->input, input);
     }
+    
+    layer->output = matrix_ensure(layer->output, input->rows, input->cols);
     matrix_copy(layer->output, input);
 }
 
@@ -50,6 +49,7 @@ Layer* batchnorm_layer(int size) {
     
     layer->type = LAYER_BATCHNORM;
     strcpy(layer->name, "batchnorm");
+    layer->is_training = 1;  // Default to training mode
     layer->input_size = size;
     layer->output_size = size;
     
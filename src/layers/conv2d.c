@@ -2,38 +2,144 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <assert.h>
+
+// Geometry of a batch: the stored image size while the rows still match
+// it, otherwise a square image inferred from the row length
+static ConvGeometry conv2d_geometry(Layer* layer, const Matrix* input) {
+    size_t channels = (size_t)layer->input_size;
+    size_t height = (size_t)layer->input_shape.height;
+    size_t width = (size_t)layer->input_shape.width;
+    
+    // Values per pixel, padding channels included
+    size_t stored = conv_blocked_size(channels, 1, conv_layout_block(layer->input_layout));
+    if (stored * height * width != input->cols) {
+        assert(input->cols % stored == 0);
+        size_t pixels = input->cols / stored;
+        height = (size_t)(sqrt((double)pixels) + 0.5);
+        width = height;
+        assert(height * width == pixels);
+    }
+    
+    return conv_geometry(channels, height, width, (size_t)layer->output_size,
+                         (size_t)layer->kernel_size, (size_t)layer->stride,
+                         (size_t)layer->padding);
+}
+
+// Zero the padding channels of the last block, which the activation may
+// have moved off 0 (e.g. sigmoid)
+static void conv2d_zero_padding(const ConvGeometry* g, size_t block, Matrix* output) {
+    size_t positions = conv_out_positions(g);
+    size_t used = g->filters % block;
+    for (size_t n = 0; n < output->rows; n++) {
+        float* last = output->data + n * output->stride + g->filters / block * positions * block;
+        for (size_t p = 0; p < positions; p++) {
+            memset(last + p * block + used, 0, (block - used) * sizeof(float));
+        }
+    }
+}
 
 // Forward pass for 2D convolution
 static void conv2d_forward(Layer* layer, const Matrix* input) {
-    // Implementation would go here
-    // This is a simplified placeholder
+    ConvGeometry g = conv2d_geometry(layer, input);
+    layer->input_shape = (TensorShape){(int)input->rows, (int)g.channels, (int)g.height,
+                                       (int)g.width};
+    layer->output_shape = (TensorShape){(int)input->rows, (int)g.filters, (int)g.out_height,
+                                        (int)g.out_width};
     
-    if (layer->input) matrix_free(layer->input);
-    // Create a copy of the input matrix
-    layer->input = matrix_create(input->rows, input->cols);
-    matrix_copy(layer->input, input);
-    
-    // For now, just pass through (actual implementation would do convolution)
-    if (!layer->output) {
-        layer->output = matrix_create(input->rows, input->cols);
-        matrix_copy(layer->output, input);
-    } else {
-        matrix_copy(layer->output, input);
+    // Keep a copy of the input for training; the buffer is reused while the
+    // shape holds
+    ActivationBackward needs = activation_backward_needs(layer->activation);
+    if (layer->is_training) {
+        layer->input = matrix_ensure(layer->input, input->rows, input->cols);
+        matrix_copy(layer->input, input);
+    }
+    
+    // output = activation(weights * input + bias) through im2col + GEMM or
+    // Winograd. Training changes the weights between batches, so only
+    // inference keeps the transformed filters.
+    size_t out_block = conv_layout_block(layer->output_layout);
+    layer->output = matrix_ensure(layer->output, input->rows,
+                                  conv_blocked_size(g.filters, conv_out_positions(&g), out_block));
+    if (layer->is_training) conv_plan_invalidate(layer->conv_plan);
+    conv_plan_forward(layer->conv_plan, &g, input, layer->weights, layer->biases->data,
+                      layer->output, layer->workspace);
+    
+    if (layer->is_training && needs == ACTIVATION_BACKWARD_INPUT) {
+        layer->pre_activation = matrix_ensure(layer->pre_activation,
+                                              layer->output->rows, layer->output->cols);
+        matrix_copy(layer->pre_activation, layer->output);
+    }
+    activate(layer->output, layer->activation);
+    if (g.filters % out_block != 0) conv2d_zero_padding(&g, out_block, layer->output);
+    if (layer->is_training && needs == ACTIVATION_BACKWARD_MASK) {
+        layer->activation_mask = activation_mask_ensure(layer->activation_mask,
+                                                        layer->output->rows,
+                                                        layer->output->cols);
+        activation_mask_store(layer->activation_mask, layer->output);
     }
 }
 
 // Backward pass for 2D convolution
 static void conv2d_backward(Layer* layer, const Matrix* output_grad) {
-    // Implementation would go here
-    (void)layer;      // Suppress unused parameter warning
-    (void)output_grad; // Suppress unused parameter warning
+    if (!layer->input) return;
+    
+    ConvGeometry g = conv2d_geometry(layer, layer->input);
+    
+    // Compute gradient of activation
+    Matrix* activation_grad = workspace_matrix(layer->workspace, output_grad->rows, output_grad->cols);
+    matrix_copy(activation_grad, output_grad);
+    activate_derivative_saved(layer->activation, layer->pre_activation, layer->output,
+                              layer->activation_mask, activation_grad);
+    
+    // Weight, bias and input gradients, with the patch matrices rebuilt
+    // from the stored input rather than kept from the forward pass.
+    // Blocked batches go through NCHW copies.
+    layer->grad_input = matrix_ensure(layer->grad_input, layer->input->rows, layer->input->cols);
+    const Matrix* input = layer->input;
+    Matrix* grad = activation_grad;
+    Matrix* grad_input = layer->grad_input;
+    Matrix* nchw_input = NULL;
+    Matrix* nchw_grad = NULL;
+    Matrix* nchw_grad_input = NULL;
+    if (layer->input_layout != CONV_LAYOUT_NCHW) {
+        size_t pixels = g.channels * g.height * g.width;
+        nchw_input = workspace_matrix(layer->workspace, input->rows, pixels);
+        nchw_grad_input = workspace_matrix(layer->workspace, input->rows, pixels);
+        conv_layout_convert(g.channels, layer->input_layout, CONV_LAYOUT_NCHW, input, nchw_input);
+        input = nchw_input;
+        grad_input = nchw_grad_input;
+    }
+    if (layer->output_layout != CONV_LAYOUT_NCHW) {
+        nchw_grad = workspace_matrix(layer->workspace, grad->rows,
+                                     g.filters * conv_out_positions(&g));
+        conv_layout_convert(g.filters, layer->output_layout, CONV_LAYOUT_NCHW, grad, nchw_grad);
+        grad = nchw_grad;
+    }
+    conv_backward_gemm(&g, input, layer->weights, grad, layer->grad_weights,
+                       layer->grad_biases->data, grad_input, layer->workspace);
+    if (nchw_grad_input) {
+        conv_layout_convert(g.channels, CONV_LAYOUT_NCHW, layer->input_layout, nchw_grad_input,
+                            layer->grad_input);
+    }
+    conv_plan_invalidate(layer->conv_plan);  // An update follows
+    
+    // Clean up
+    matrix_free(activation_grad);
+    if (nchw_input) matrix_free(nchw_input);
+    if (nchw_grad) matrix_free(nchw_grad);
+    if (nchw_grad_input) matrix_free(nchw_grad_input);
 }
 
 // Update parameters for 2D convolution
 static void conv2d_update(Layer* layer, float learning_rate) {
-    // Implementation would go here
-    (void)layer;        // Suppress unused parameter warning
-    (void)learning_rate; // Suppress unused parameter warning
+    matrix_axpy(layer->weights, -learning_rate, layer->grad_weights);
+    matrix_axpy(layer->biases, -learning_rate, layer->grad_biases);
+    conv_plan_invalidate(layer->conv_plan);
+    
+    // Reset gradients
+    matrix_fill(layer->grad_weights, 0.0f);
+    matrix_fill(layer->grad_biases, 0.0f);
 }
 
 // Free conv2d layer resources
@@ -44,9 +150,39 @@ static void conv2d_free(Layer* layer) {
     if (layer->grad_biases) matrix_free(layer->grad_biases);
     if (layer->input) matrix_free(layer->input);
     if (layer->output) matrix_free(layer->output);
+    if (layer->grad_input) matrix_free(layer->grad_input);
+    if (layer->pre_activation) matrix_free(layer->pre_activation);
+    activation_mask_free(layer->activation_mask);
+    conv_plan_free(layer->conv_plan);
     free(layer);
 }
 
+int conv2d_layer_set_algorithm(Layer* layer, ConvAlgorithm algorithm) {
+    if (layer->type != LAYER_CONV2D) return -1;
+    conv_plan_free(layer->conv_plan);
+    layer->conv_plan = conv_plan_create(algorithm, layer->input_layout, layer->output_layout);
+    return 0;
+}
+
+int conv2d_layer_set_layout(Layer* layer, ConvLayout input_layout, ConvLayout output_layout) {
+    if (layer->type != LAYER_CONV2D) return -1;
+    if (output_layout == CONV_LAYOUT_NCHW && input_layout != CONV_LAYOUT_NCHW) return -1;
+    ConvAlgorithm requested = layer->conv_plan->requested;
+    conv_plan_free(layer->conv_plan);
+    layer->input_layout = input_layout;
+    layer->output_layout = output_layout;
+    layer->conv_plan = conv_plan_create(requested, input_layout, output_layout);
+    return 0;
+}
+
+int conv2d_layer_set_input_shape(Layer* layer, int height, int width) {
+    if (layer->type != LAYER_CONV2D) return -1;
+    layer->input_shape.channels = layer->input_size;
+    layer->input_shape.height = height;
+    layer->input_shape.width = width;
+    return 0;
+}
+
 // Create a 2D convolutional layer
 Layer* conv2d_layer(int in_channels, int out_channels, 
                    int kernel_size, int stride, int padding, ActivationType activation) {
@@ -55,6 +191,7 @@ Layer* conv2d_layer(int in_channels, int out_channels,
     
     layer->type = LAYER_CONV2D;
     strcpy(layer->name, "conv2d");
+    layer->is_training = 1;  // Default to training mode
     layer->input_size = in_channels;
     layer->output_size = out_channels;
     layer->kernel_size = kernel_size;
@@ -62,9 +199,10 @@ Layer* conv2d_layer(int in_channels, int out_channels,
     layer->padding = padding;
     layer->activation = activation;
     
-    // Initialize weights and biases
-    int weights_size = out_channels * in_channels * kernel_size * kernel_size;
-    layer->weights = matrix_create(1, weights_size);
+    // Initialize weights and biases: one row of in_channels x kernel_size x
+    // kernel_size taps per output channel
+    int patch_size = in_channels * kernel_size * kernel_size;
+    layer->weights = matrix_create(out_channels, patch_size);
     layer->biases = matrix_create(1, out_channels);
     
     // He initialization
@@ -73,11 +211,13 @@ Layer* conv2d_layer(int in_channels, int out_channels,
     matrix_fill(layer->biases, 0.1f);
     
     // Initialize gradients
-    layer->grad_weights = matrix_create(1, weights_size);
+    layer->grad_weights = matrix_create(out_channels, patch_size);
     layer->grad_biases = matrix_create(1, out_channels);
     matrix_fill(layer->grad_weights, 0.0f);
     matrix_fill(layer->grad_biases, 0.0f);
     
+    layer->conv_plan = conv_plan_create(CONV_ALGO_AUTO, CONV_LAYOUT_NCHW, CONV_LAYOUT_NCHW);
+    
     // Set method pointers
     layer->forward = conv2d_forward;
     layer->backward = conv2d_backward;
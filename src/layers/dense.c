@@ -1,80 +1,146 @@
 #include "layer.h"
 #include "../activations/activation.h"
+#include "../gemm.h"
+#include "../parallel.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+// Columns per work item of the bias-gradient sum
+#define DENSE_BIAS_BLOCK 256
+
+// Inference on int8 weights: quantize the input, run the int8 GEMM and let
+// its epilogue dequantize, add the bias and activate
+static void dense_forward_int8(Layer* layer, const Matrix* input) {
+    const QuantizedMatrix* q = layer->quantized;
+    layer->output = matrix_ensure(layer->output, input->rows, layer->output_size);
+    
+    float scale = layer->input_scale;
+    if (scale <= 0.0f) {
+        float hi = matrix_max(input);
+        float lo = matrix_min(input);
+        scale = quantize_scale(hi > -lo ? hi : -lo);
+    }
+    
+    size_t bytes = input->rows * q->k_padded;
+    int8_t* a = layer->workspace ?
+                (int8_t*)workspace_alloc(layer->workspace, bytes, QUANT_K_ALIGN) : NULL;
+    int owned = (a == NULL);
+    if (owned) a = (int8_t*)malloc(bytes);
+    
+    quantize_rows(input, scale, a, q->k_padded);
+    quantized_gemm(input->rows, a, scale, q, layer->biases->data, layer->activation,
+                   layer->output->data, layer->output->stride);
+    if (owned) free(a);
+    
+    if (layer->activation == ACTIVATION_SOFTMAX && !layer->defer_softmax) {
+        activate(layer->output, layer->activation);
+    }
+}
+
+// Inference on pruned weights; the bias and activation are applied per row
+// inside the sparse kernel
+static void dense_forward_sparse(Layer* layer, const Matrix* input) {
+    layer->output = matrix_ensure(layer->output, input->rows, layer->output_size);
+    sparse_gemm(input, layer->sparse_weights, layer->output, layer->biases->data,
+                layer->activation);
+    
+    if (layer->activation == ACTIVATION_SOFTMAX && !layer->defer_softmax) {
+        activate(layer->output, layer->activation);
+    }
+}
+
 // Forward pass for dense layer
 static void dense_forward(Layer* layer, const Matrix* input) {
-    // Store input for backward pass
-    if (layer->input) matrix_free(layer->input);
-    // Create a copy of the input matrix
-    layer->input = matrix_create(input->rows, input->cols);
-    matrix_copy(layer->input, input);
-    
-    // Allocate output if needed
-    if (!layer->output) {
-        layer->output = matrix_create(input->rows, layer->output_size);
+    if (layer->quantized) {
+        dense_forward_int8(layer, input);
+        return;
+    }
+    if (layer->sparse_weights) {
+        dense_forward_sparse(layer, input);
+        return;
     }
     
-    // Compute output = input * weights + bias
-    matrix_multiply(input, layer->weights, layer->output);
+    // Store the input and whatever the activation's derivative needs for
+    // the backward pass; inference needs neither. Only the activations that
+    // cannot be differentiated from their output keep the pre-activation.
+    ActivationBackward needs = activation_backward_needs(layer->activation);
+    int keep = layer->is_training && needs == ACTIVATION_BACKWARD_INPUT;
+    if (layer->is_training) {
+        layer->input = matrix_ensure(layer->input, input->rows, input->cols);
+        matrix_copy(layer->input, input);
+    }
     
-    // Add bias (broadcasted to each row)
-    for (size_t i = 0; i < layer->output->rows; i++) {
-        for (size_t j = 0; j < layer->output->cols; j++) {
-            layer->output->data[i * layer->output->stride + j] += 
-                layer->biases->data[j];
-        }
+    layer->output = matrix_ensure(layer->output, input->rows, layer->output_size);
+    if (keep) {
+        layer->pre_activation = matrix_ensure(layer->pre_activation,
+                                              input->rows, layer->output_size);
     }
     
-    // Store pre-activation values for backward pass
-    if (layer->activation != ACTIVATION_NONE) {
-        // Store pre-activation values before applying activation
-        if (!layer->grad_input) {
-            layer->grad_input = matrix_create(layer->output->rows, layer->output->cols);
-        }
-        matrix_copy(layer->grad_input, layer->output);
-        
-        // Apply activation function
+    // output = activation(input * weights + bias). The bias add, the copy of
+    // the pre-activation values for backward and the activation run on each
+    // output tile as the GEMM finishes it, rather than as three more passes.
+    GemmEpilogue epilogue;
+    epilogue.bias = layer->biases->data;
+    epilogue.pre_activation = keep ? layer->pre_activation->data : NULL;
+    epilogue.ld_pre = keep ? layer->pre_activation->stride : 0;
+    epilogue.activation = layer->activation;
+    
+    gemm_mixed_ex(0, 0, input->rows, layer->output_size, input->cols,
+                  1.0f, input->data, MATRIX_F32, input->stride,
+                  matrix_storage(layer->weights), layer->weights->dtype, layer->weights->stride,
+                  0.0f, layer->output->data, layer->output->stride,
+                  &epilogue);
+    
+    // Softmax needs whole rows, so it cannot be fused per tile
+    if (layer->activation == ACTIVATION_SOFTMAX && !layer->defer_softmax) {
         activate(layer->output, layer->activation);
     }
+    
+    // ReLU-family outputs are positive exactly where their inputs are, so
+    // one bit per element replaces the float copy
+    if (layer->is_training && needs == ACTIVATION_BACKWARD_MASK) {
+        layer->activation_mask = activation_mask_ensure(layer->activation_mask,
+                                                        input->rows, layer->output_size);
+        activation_mask_store(layer->activation_mask, layer->output);
+    }
 }
 
 // Backward pass for dense layer
 static void dense_backward(Layer* layer, const Matrix* output_grad) {
-    if (!layer->input) return;
+    if (!layer->input || layer->quantized || layer->sparse_weights) return;
     
     // Compute gradient of activation
-    Matrix* activation_grad = matrix_create(output_grad->rows, output_grad->cols);
+    Matrix* activation_grad = workspace_matrix(layer->workspace, output_grad->rows, output_grad->cols);
     matrix_copy(activation_grad, output_grad);
     
-    if (layer->activation != ACTIVATION_NONE && layer->grad_input) {
-        // Use stored pre-activation values for derivative
-        activate_derivative(layer->grad_input, activation_grad, layer->activation);
-    }
+    activate_derivative_saved(layer->activation, layer->pre_activation, layer->output,
+                              layer->activation_mask, activation_grad);
     
     // Compute gradient of weights: input^T * activation_grad
-    for (size_t i = 0; i < layer->input->cols; i++) {
-        for (size_t j = 0; j < activation_grad->cols; j++) {
-            float grad_sum = 0.0f;
-            for (size_t k = 0; k < layer->input->rows; k++) {
-                grad_sum += layer->input->data[k * layer->input->stride + i] * 
-                           activation_grad->data[k * activation_grad->stride + j];
-            }
-            layer->grad_weights->data[i * layer->grad_weights->stride + j] = grad_sum;
-        }
-    }
+    matrix_gemm(MATRIX_TRANS, MATRIX_NO_TRANS, 1.0f,
+                layer->input, activation_grad, 0.0f, layer->grad_weights);
     
-    // Compute gradient of biases: sum(activation_grad, axis=0)
-    for (size_t i = 0; i < activation_grad->cols; i++) {
-        layer->grad_biases->data[i] = 0.0f;
-        for (size_t j = 0; j < activation_grad->rows; j++) {
-            layer->grad_biases->data[i] += 
-                activation_grad->data[j * activation_grad->stride + i];
+    // Compute gradient of biases: sum(activation_grad, axis=0), added up
+    // one row at a time so each step is a contiguous vector add. Threads
+    // take blocks of columns, so every sum keeps the same row order.
+    float* grad_biases = layer->grad_biases->data;
+    size_t rows = activation_grad->rows, cols = activation_grad->cols;
+    #pragma omp parallel for if (rows * cols > NN_PARALLEL_THRESHOLD)
+    for (size_t start = 0; start < cols; start += DENSE_BIAS_BLOCK) {
+        size_t len = cols - start < DENSE_BIAS_BLOCK ? cols - start : DENSE_BIAS_BLOCK;
+        memset(grad_biases + start, 0, len * sizeof(float));
+        for (size_t j = 0; j < rows; j++) {
+            vec_add(grad_biases + start, activation_grad->data + j * activation_grad->stride + start,
+                    len);
         }
     }
     
+    // Compute gradient of input: activation_grad * weights^T
+    layer->grad_input = matrix_ensure(layer->grad_input, layer->input->rows, layer->input->cols);
+    matrix_gemm(MATRIX_NO_TRANS, MATRIX_TRANS, 1.0f,
+                activation_grad, layer->weights, 0.0f, layer->grad_input);
+    
     // Clean up
     matrix_free(activation_grad);
 }
@@ -82,14 +148,10 @@ static void dense_backward(Layer* layer, const Matrix* output_grad) {
 // Update parameters for dense layer
 static void dense_update(Layer* layer, float learning_rate) {
     // Update weights: weights = weights - learning_rate * grad_weights
-    for (size_t i = 0; i < layer->weights->rows * layer->weights->cols; i++) {
-        layer->weights->data[i] -= learning_rate * layer->grad_weights->data[i];
-    }
+    matrix_axpy(layer->weights, -learning_rate, layer->grad_weights);
     
     // Update biases: biases = biases - learning_rate * grad_biases
-    for (size_t i = 0; i < layer->biases->rows * layer->biases->cols; i++) {
-        layer->biases->data[i] -= learning_rate * layer->grad_biases->data[i];
-    }
+    matrix_axpy(layer->biases, -learning_rate, layer->grad_biases);
     
     // Reset gradients
     matrix_fill(layer->grad_weights, 0.0f);
@@ -105,9 +167,66 @@ static void dense_free(Layer* layer) {
     if (layer->input) matrix_free(layer->input);
     if (layer->output) matrix_free(layer->output);
     if (layer->grad_input) matrix_free(layer->grad_input);
+    if (layer->pre_activation) matrix_free(layer->pre_activation);
+    activation_mask_free(layer->activation_mask);
+    quantized_matrix_free(layer->quantized);
+    sparse_free(layer->sparse_weights);
     free(layer);
 }
 
+int dense_layer_set_weight_dtype(Layer* layer, MatrixDType dtype) {
+    if (layer->type != LAYER_DENSE) return -1;
+    if (layer->weights->dtype == dtype) return 0;
+    
+    Matrix* converted = matrix_to_dtype(layer->weights, dtype);
+    matrix_free(layer->weights);
+    layer->weights = converted;
+    return 0;
+}
+
+int dense_layer_quantize(Layer* layer, float input_scale) {
+    if (layer->type != LAYER_DENSE) return -1;
+    
+    dense_layer_densify(layer);
+    quantized_matrix_free(layer->quantized);
+    layer->quantized = quantized_matrix_create(layer->weights);
+    layer->input_scale = input_scale;
+    return 0;
+}
+
+void dense_layer_dequantize(Layer* layer) {
+    if (layer->type != LAYER_DENSE) return;
+    quantized_matrix_free(layer->quantized);
+    layer->quantized = NULL;
+    layer->input_scale = 0.0f;
+}
+
+int dense_layer_sparsify(Layer* layer, float threshold, size_t block_rows, size_t block_cols) {
+    if (layer->type != LAYER_DENSE) return -1;
+    
+    dense_layer_dequantize(layer);
+    sparse_free(layer->sparse_weights);
+    
+    // One sparse row per output, the layout sparse_gemm reads
+    Matrix* weights = layer->weights->dtype == MATRIX_F32 ?
+                      layer->weights : matrix_to_dtype(layer->weights, MATRIX_F32);
+    Matrix* transposed = matrix_create(layer->output_size, layer->input_size);
+    matrix_transpose(weights, transposed);
+    layer->sparse_weights = (block_rows == 1 && block_cols == 1) ?
+                            sparse_from_dense(transposed, threshold) :
+                            sparse_bsr_from_dense(transposed, block_rows, block_cols, threshold);
+    
+    matrix_free(transposed);
+    if (weights != layer->weights) matrix_free(weights);
+    return 0;
+}
+
+void dense_layer_densify(Layer* layer) {
+    if (layer->type != LAYER_DENSE) return;
+    sparse_free(layer->sparse_weights);
+    layer->sparse_weights = NULL;
+}
+
 // Create a dense layer
 Layer* dense_layer(int input_size, int output_size, ActivationType activation) {
     Layer* layer = (Layer*)malloc(sizeof(Layer));
@@ -118,6 +237,7 @@ Layer* dense_layer(int input_size, int output_size, ActivationType activation) {
     layer->input_size = input_size;
     layer->output_size = output_size;
     layer->activation = activation;
+    layer->is_training = 1;  // Default to training mode
     
     // Initialize weights and biases
     layer->weights = matrix_create(input_size, output_size);
@@ -1,36 +1,38 @@
 #include "layer.h"
+#include "../parallel.h"
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 // Forward pass for dropout layer
 static void dropout_forward(Layer* layer, const Matrix* input) {
-    if (layer->input) matrix_free(layer->input);
-    // Create a copy of the input matrix
-    layer->input = matrix_create(input->rows, input->cols);
+    // Keep a copy of the input; the buffer is reused while the shape holds
+    layer->input = matrix_ensure(layer->input, input->rows, input->cols);
     matrix_copy(layer->input, input);
     
-    if (!layer->output) {
-        layer->output = matrix_create(input->rows, input->cols);
-    }
+    layer->output = matrix_ensure(layer->output, input->rows, input->cols);
     
     if (layer->is_training && layer->dropout_rate > 0) {
         // Create mask and apply dropout during training
-        if (!layer->mask) {
-            layer->mask = matrix_create(input->rows, input->cols);
-        }
+        layer->mask = matrix_ensure(layer->mask, input->rows, input->cols);
         
         float scale = 1.0f / (1.0f - layer->dropout_rate);
+        size_t cols = input->cols;
         
-        for (size_t i = 0; i < input->rows * input->cols; i++) {
-            if ((float)rand() / RAND_MAX < layer->dropout_rate) {
-                layer->mask->data[i] = 0.0f;
-                layer->output->data[i] = 0.0f;
-            } else {
-                layer->mask->data[i] = scale;
-                layer->output->data[i] = input->data[i] * scale;
+        // Uniforms for row i are values i * cols .. of the layer's stream,
+        // so rows can be drawn in parallel and the mask does not depend on
+        // the thread count. They are staged in the mask buffer itself.
+        #pragma omp parallel for if (input->rows * cols > NN_PARALLEL_THRESHOLD)
+        for (size_t i = 0; i < input->rows; i++) {
+            const float* in = input->data + i * input->stride;
+            float* mask = layer->mask->data + i * layer->mask->stride;
+            float* out = layer->output->data + i * layer->output->stride;
+            random_uniform_at(&layer->rng, (uint64_t)i * cols, mask, cols, 0.0f, 1.0f);
+            for (size_t j = 0; j < cols; j++) {
+                mask[j] = mask[j] < layer->dropout_rate ? 0.0f : scale;
+                out[j] = in[j] * mask[j];
             }
         }
+        random_advance(&layer->rng, (uint64_t)input->rows * cols);
     } else {
         // During inference, just pass through
         matrix_copy(layer->output, input);
@@ -42,13 +44,16 @@ static void dropout_backward(Layer* layer, const Matrix* output_grad) {
     if (!layer->input || !layer->mask) return;
     
     // Allocate grad_input if needed
-    if (!layer->grad_input) {
-        layer->grad_input = matrix_create(output_grad->rows, output_grad->cols);
-    }
+    layer->grad_input = matrix_ensure(layer->grad_input, output_grad->rows, output_grad->cols);
     
     // Apply the same mask to gradients
-    for (size_t i = 0; i < output_grad->rows * output_grad->cols; i++) {
-        layer->grad_input->data[i] = output_grad->data[i] * layer->mask->data[i];
+    for (size_t i = 0; i < output_grad->rows; i++) {
+        const float* grad = output_grad->data + i * output_grad->stride;
+        const float* mask = layer->mask->data + i * layer->mask->stride;
+        float* grad_in = layer->grad_input->data + i * layer->grad_input->stride;
+        for (size_t j = 0; j < output_grad->cols; j++) {
+            grad_in[j] = grad[j] * mask[j];
+        }
     }
 }
 
@@ -77,6 +82,7 @@ Layer* dropout_layer(float rate) {
     strcpy(layer->name, "dropout");
     layer->dropout_rate = rate;
     layer->is_training = 1;  // Default to training mode
+    layer->rng = random_stream_split();
     
     // Set method pointers
     layer->forward = dropout_forward;
@@ -3,6 +3,11 @@
 
 #include "../matrix.h"
 #include "../activations/activation.h"
+#include "../workspace.h"
+#include "../random.h"
+#include "../quantize.h"
+#include "../sparse.h"
+#include "../conv.h"
 
 typedef enum {
     LAYER_DENSE,
@@ -11,9 +16,19 @@ typedef enum {
     LAYER_LSTM,
     LAYER_ATTENTION,
     LAYER_DROPOUT,
-    LAYER_BATCHNORM
+    LAYER_BATCHNORM,
+    LAYER_LAYOUT
 } LayerType;
 
+// Shape of an NCHW batch: row n of the batch matrix is image n, stored as
+// channels x height x width values
+typedef struct {
+    int batch;
+    int channels;
+    int height;
+    int width;
+} TensorShape;
+
 typedef struct Layer {
     LayerType type;
     char name[64];
@@ -33,7 +48,9 @@ typedef struct Layer {
     Matrix* output;
     Matrix* hidden_state;  // For RNN/LSTM
     Matrix* mask;          // For dropout layers
-    Matrix* grad_input;    // For gradient propagation
+    Matrix* grad_input;    // Gradient w.r.t. the layer input, read by the previous layer
+    Matrix* pre_activation; // Pre-activation values kept for the backward pass
+    ActivationMask* activation_mask;  // Signs of the output kept for ReLU-family backward
     
     // Configuration
     float dropout_rate;
@@ -43,8 +60,19 @@ typedef struct Layer {
     int kernel_size;
     int stride;
     int padding;
+    TensorShape input_shape;   // NCHW shapes of the last batch (conv2d)
+    TensorShape output_shape;
     int heads;  // For attention
     int is_training;       // Training mode flag
+    int defer_softmax;     // Leave softmax outputs as logits, for a fused loss (dense)
+    Workspace* workspace;  // Scratch for per-step temporaries, owned by the network (may be NULL)
+    RandomStream rng;      // Random stream for dropout masks, re-derived by the network
+    QuantizedMatrix* quantized;  // int8 weights used for inference (dense), or NULL
+    float input_scale;     // Calibrated int8 input scale; 0 quantizes each batch by its own range
+    SparseMatrix* sparse_weights;  // Pruned weights used for inference (dense), or NULL
+    ConvPlan* conv_plan;   // Forward algorithm and transformed filters (conv2d)
+    ConvLayout input_layout;   // Channel layout of the batch rows (conv2d, layout)
+    ConvLayout output_layout;
     
     // Activation
     ActivationType activation;
@@ -63,8 +91,60 @@ typedef struct Layer {
 Layer* dense_layer(int input_size, int output_size, ActivationType activation);
 Layer* conv2d_layer(int in_channels, int out_channels, int kernel_size, int stride, int padding, ActivationType activation);
 Layer* rnn_layer(int input_size, int hidden_size, int output_size, ActivationType activation);
+// heads must divide embed_size; each head attends over its own
+// embed_size / heads columns
 Layer* attention_layer(int embed_size, int heads);
 Layer* dropout_layer(float rate);
 Layer* batchnorm_layer(int size);
 
+// Convert batches of images with `channels` channels from one layout to
+// another, e.g. from the blocked output of a conv2d layer back to NCHW in
+// front of a dense layer. The image size follows from the row length.
+Layer* layout_layer(int channels, ConvLayout from, ConvLayout to);
+
+// Set the image size a conv2d layer expects, e.g. for non-square inputs.
+// Until set, each batch row of in_channels * h * w values is taken as a
+// square image. Returns -1 for other layer types.
+int conv2d_layer_set_input_shape(Layer* layer, int height, int width);
+
+// Pick the forward algorithm of a conv2d layer. CONV_ALGO_AUTO (the
+// default) times im2col against Winograd F(2x2) and F(4x4) for 3 x 3,
+// stride 1 layers on the first batch; the backward pass always uses
+// im2col. Inference reuses the Winograd-transformed filters between
+// batches, so call this again (which drops them) after writing to the
+// weights by hand. Returns -1 for other layer types.
+int conv2d_layer_set_algorithm(Layer* layer, ConvAlgorithm algorithm);
+
+// Run a conv2d layer on channel-blocked batches (see ConvLayout) with the
+// direct convolution instead of im2col: the output is in output_layout
+// (NCHW8C or NCHW16C, see conv_layout_native), the input in input_layout,
+// which may stay NCHW for the first layer of a blocked pipeline. Put a
+// layout_layer between a blocked layer and a dense one. NCHW for both goes
+// back to im2col/Winograd. Returns -1 for other layer types or a blocked
+// input with NCHW output.
+int conv2d_layer_set_layout(Layer* layer, ConvLayout input_layout, ConvLayout output_layout);
+
+// Store a dense layer's weights as dtype (see MatrixDType). BF16/F16 halve
+// the weight traffic of inference; the GEMM still accumulates in float.
+// Training updates need MATRIX_F32 weights, so convert back before
+// training (the rounding is not undone). Returns -1 for other layer types.
+int dense_layer_set_weight_dtype(Layer* layer, MatrixDType dtype);
+
+// Switch a dense layer to int8 inference: per-output-channel int8 weights,
+// inputs quantized with input_scale (0: per batch) and int32 accumulation.
+// The float weights stay as the master copy for saving; a quantized layer
+// computes no gradients. Returns -1 for other layer types.
+int dense_layer_quantize(Layer* layer, float input_scale);
+void dense_layer_dequantize(Layer* layer);
+
+// Switch a dense layer to sparse inference: weights with |w| <= threshold
+// are dropped and the rest kept, one row per output, as CSR (1 x 1 blocks)
+// or as BSR with blocks of block_rows outputs x block_cols inputs, which
+// need fewer indices at the cost of storing some zeros. Like int8, the
+// float weights stay as the master copy and a sparse layer computes no
+// gradients; sparse and int8 inference are exclusive. Returns -1 for other
+// layer types.
+int dense_layer_sparsify(Layer* layer, float threshold, size_t block_rows, size_t block_cols);
+void dense_layer_densify(Layer* layer);
+
 #endif // LAYER_H
\ No newline at end of file
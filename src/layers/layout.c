@@ -0,0 +1,61 @@
+#include "layer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Forward pass for layout conversion: the same images, channels regrouped
+static void layout_forward(Layer* layer, const Matrix* input) {
+    size_t channels = (size_t)layer->input_size;
+    size_t plane = input->cols /
+                   conv_blocked_size(channels, 1, conv_layout_block(layer->input_layout));
+    layer->output = matrix_ensure(layer->output, input->rows,
+                                  conv_blocked_size(channels, plane,
+                                                    conv_layout_block(layer->output_layout)));
+    conv_layout_convert(channels, layer->input_layout, layer->output_layout, input,
+                        layer->output);
+}
+
+// Backward pass: the gradient goes back to the input layout
+static void layout_backward(Layer* layer, const Matrix* output_grad) {
+    size_t channels = (size_t)layer->input_size;
+    size_t plane = output_grad->cols /
+                   conv_blocked_size(channels, 1, conv_layout_block(layer->output_layout));
+    layer->grad_input = matrix_ensure(layer->grad_input, output_grad->rows,
+                                      conv_blocked_size(channels, plane,
+                                                        conv_layout_block(layer->input_layout)));
+    conv_layout_convert(channels, layer->output_layout, layer->input_layout, output_grad,
+                        layer->grad_input);
+}
+
+// Layout conversion has no parameters
+static void layout_update(Layer* layer, float learning_rate) {
+    (void)layer;
+    (void)learning_rate;
+}
+
+static void layout_free(Layer* layer) {
+    if (layer->output) matrix_free(layer->output);
+    if (layer->grad_input) matrix_free(layer->grad_input);
+    free(layer);
+}
+
+// Create a layout conversion layer
+Layer* layout_layer(int channels, ConvLayout from, ConvLayout to) {
+    Layer* layer = (Layer*)malloc(sizeof(Layer));
+    memset(layer, 0, sizeof(Layer));
+    
+    layer->type = LAYER_LAYOUT;
+    strcpy(layer->name, "layout");
+    layer->is_training = 1;  // Default to training mode
+    layer->input_size = channels;
+    layer->output_size = channels;
+    layer->input_layout = from;
+    layer->output_layout = to;
+    
+    // Set method pointers
+    layer->forward = layout_forward;
+    layer->backward = layout_backward;
+    layer->update = layout_update;
+    layer->free = layout_free;
+    
+    return layer;
+}
@@ -8,10 +8,12 @@ static void rnn_forward(Layer* layer, const Matrix* input) {
     // Implementation would go here
     // This is a simplified placeholder
     
-    if (layer->input) matrix_free(layer->input);
-    // Create a copy of the input matrix
-    layer->input = matrix_create(input->rows, input->cols);
-    matrix_copy(layer->input, input);
+    // Keep a copy of the input for training; the buffer is reused while the
+    // shape holds
+    if (layer->is_training) {
+        layer->input = matrix_ensure(layer->input, input->rows, input->cols);
+        matrix_copy(layer->input, input);
+    }
     
     // Initialize hidden state if needed
     if (!layer->hidden_state) {
@@ -20,12 +22,8 @@ static void rnn_forward(Layer* layer, const Matrix* input) {
     }
     
     // For now, just pass through (actual implementation would do RNN computation)
-    if (!layer->output) {
-        layer->output = matrix_create(input->rows, input->cols);
-        matrix_copy(layer->output, input);
-    } else {
-        matrix_copy(layer->output, input);
-    }
+    layer->output = matrix_ensure(layer->output, input->rows, input->cols);
+    matrix_copy(layer->output, input);
 }
 
 // Backward pass for RNN layer (BPTT)
@@ -61,6 +59,7 @@ Layer* rnn_layer(int input_size, int hidden_size, int output_size, ActivationTyp
     
     layer->type = LAYER_RNN;
     strcpy(layer->name, "rnn");
+    layer->is_training = 1;  // Default to training mode
     layer->input_size = input_size;
     layer->hidden_size = hidden_size;
     layer->output_size = output_size;
@@ -1,38 +1,344 @@
 #include "matrix.h"
+#include "gemm.h"
+#include "parallel.h"
+#include "random.h"
+#include "vecops.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <stdint.h>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
 #endif
 
 #ifdef USE_CUDA
 #include "cuda/cuda_ops.h"
 #endif
 
-Matrix* matrix_create(size_t rows, size_t cols) {
+// Elements per parallel work item for contiguous elementwise kernels
+#define MATRIX_CHUNK 4096
+
+static size_t matrix_alignment = MATRIX_DEFAULT_ALIGNMENT;
+static int matrix_padding = 0;
+
+int matrix_set_alignment(size_t bytes) {
+    if (bytes < sizeof(void*) || (bytes & (bytes - 1)) != 0) return -1;
+    matrix_alignment = bytes;
+    return 0;
+}
+
+size_t matrix_get_alignment(void) {
+    return matrix_alignment;
+}
+
+void matrix_set_padding(int enabled) {
+    matrix_padding = enabled != 0;
+}
+
+int matrix_get_padding(void) {
+    return matrix_padding;
+}
+
+int matrix_is_contiguous(const Matrix* m) {
+    return m->stride == m->cols || m->rows <= 1;
+}
+
+size_t matrix_default_stride(size_t cols) {
+    if (!matrix_padding || cols == 0) return cols;
+    
+    size_t unit = matrix_alignment / sizeof(float);
+    if (unit == 0) unit = 1;
+    size_t stride = (cols + unit - 1) / unit * unit;
+    
+    // A 4 KiB multiple puts every row at the same page offset, so a column
+    // walk keeps hitting the same few L1/L2 sets
+    if ((stride * sizeof(float)) % 4096 == 0) {
+        stride += unit;
+    }
+    return stride;
+}
+
+static MatrixAllocPolicy matrix_alloc_policy = {MATRIX_PAGES_DEFAULT, MATRIX_NUMA_DEFAULT};
+
+int matrix_set_alloc_policy(MatrixAllocPolicy policy) {
+#ifndef __linux__
+    if (policy.pages != MATRIX_PAGES_DEFAULT || policy.numa != MATRIX_NUMA_DEFAULT) return -1;
+#endif
+    matrix_alloc_policy = policy;
+    return 0;
+}
+
+MatrixAllocPolicy matrix_get_alloc_policy(void) {
+    return matrix_alloc_policy;
+}
+
+#ifdef __linux__
+
+#define MATRIX_PAGE_SIZE ((size_t)4096)
+#define MATRIX_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+#define MATRIX_MPOL_INTERLEAVE 3  // MPOL_INTERLEAVE from <numaif.h>, without needing libnuma
+
+// Storage mapped by matrix_map; matrix_free_data looks pointers up here to
+// know whether to unmap them
+typedef struct MatrixMapping {
+    void* base;
+    size_t length;
+    struct MatrixMapping* next;
+} MatrixMapping;
+
+static MatrixMapping* matrix_mappings = NULL;
+
+// Entries in matrix_mappings. Frees check it before taking the lock, so heap
+// storage costs nothing extra while no mapping is live.
+static size_t matrix_mapping_count = 0;
+
+static void* matrix_map_aligned(size_t length, size_t align) {
+    // Over-map by one alignment unit and trim both ends
+    char* raw = (char*)mmap(NULL, length + align, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == (char*)MAP_FAILED) return NULL;
+    
+    char* base = (char*)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+    if (base > raw) munmap(raw, (size_t)(base - raw));
+    size_t tail = (size_t)(raw + length + align - (base + length));
+    if (tail > 0) munmap(base + length, tail);
+    return base;
+}
+
+// Zeroed storage of at least `bytes` mapped under matrix_alloc_policy, or
+// NULL to fall back to the heap
+static void* matrix_map(size_t bytes) {
+    MatrixAllocPolicy policy = matrix_alloc_policy;
+    size_t align = matrix_alignment > MATRIX_PAGE_SIZE ? matrix_alignment : MATRIX_PAGE_SIZE;
+    size_t length = (bytes + MATRIX_PAGE_SIZE - 1) / MATRIX_PAGE_SIZE * MATRIX_PAGE_SIZE;
+    void* base = NULL;
+    
+    if (policy.pages == MATRIX_PAGES_HUGETLB && align <= MATRIX_HUGE_PAGE_SIZE) {
+        size_t huge_length = (bytes + MATRIX_HUGE_PAGE_SIZE - 1) / MATRIX_HUGE_PAGE_SIZE *
+                             MATRIX_HUGE_PAGE_SIZE;
+        base = mmap(NULL, huge_length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            base = NULL;
+        } else {
+            length = huge_length;
+        }
+    }
+    if (!base && policy.pages != MATRIX_PAGES_DEFAULT) {
+        if (align < MATRIX_HUGE_PAGE_SIZE) align = MATRIX_HUGE_PAGE_SIZE;
+        length = (bytes + MATRIX_HUGE_PAGE_SIZE - 1) / MATRIX_HUGE_PAGE_SIZE * MATRIX_HUGE_PAGE_SIZE;
+        base = matrix_map_aligned(length, align);
+        if (base) madvise(base, length, MADV_HUGEPAGE);  // Advice only; failure is harmless
+    }
+    if (!base) {
+        base = matrix_map_aligned(length, align);
+        if (!base) return NULL;
+    }
+    
+    // Placement is best effort as well: without NUMA support mbind fails
+    // and the pages stay where the kernel puts them
+    if (policy.numa == MATRIX_NUMA_INTERLEAVE) {
+        unsigned long nodes = ~0UL;
+        syscall(SYS_mbind, base, length, MATRIX_MPOL_INTERLEAVE, &nodes,
+                sizeof(nodes) * 8, 0);
+    } else if (policy.numa == MATRIX_NUMA_FIRST_TOUCH) {
+        size_t page = length >= MATRIX_HUGE_PAGE_SIZE && policy.pages != MATRIX_PAGES_DEFAULT ?
+                      MATRIX_HUGE_PAGE_SIZE : MATRIX_PAGE_SIZE;
+        size_t pages = length / page;
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < pages; i++) {
+            ((char*)base)[i * page] = 0;
+        }
+    }
+    
+    MatrixMapping* mapping = (MatrixMapping*)malloc(sizeof(MatrixMapping));
+    mapping->base = base;
+    mapping->length = length;
+    #pragma omp critical(matrix_mappings)
+    {
+        mapping->next = matrix_mappings;
+        matrix_mappings = mapping;
+        #pragma omp atomic update seq_cst
+        matrix_mapping_count++;
+    }
+    return base;
+}
+
+// Unmaps data if matrix_map returned it; returns 0 for heap storage
+static int matrix_unmap(void* data) {
+    // Storage is freed after matrix_map registered it, so a count of 0
+    // means data cannot be in the list
+    size_t live;
+    #pragma omp atomic read seq_cst
+    live = matrix_mapping_count;
+    if (live == 0) return 0;
+    
+    MatrixMapping* found = NULL;
+    #pragma omp critical(matrix_mappings)
+    {
+        for (MatrixMapping** link = &matrix_mappings; *link; link = &(*link)->next) {
+            if ((*link)->base == data) {
+                found = *link;
+                *link = found->next;
+                #pragma omp atomic update seq_cst
+                matrix_mapping_count--;
+                break;
+            }
+        }
+    }
+    if (!found) return 0;
+    
+    munmap(found->base, found->length);
+    free(found);
+    return 1;
+}
+
+#endif // __linux__
+
+// Zeroed storage aligned to matrix_alignment
+static void* matrix_alloc_data(size_t bytes) {
+    if (bytes == 0) bytes = matrix_alignment;
+    
+#ifdef __linux__
+    if (bytes >= MATRIX_LARGE_ALLOC_BYTES &&
+        (matrix_alloc_policy.pages != MATRIX_PAGES_DEFAULT ||
+         matrix_alloc_policy.numa != MATRIX_NUMA_DEFAULT)) {
+        void* mapped = matrix_map(bytes);
+        if (mapped) return mapped;
+    }
+#endif
+    
+    void* ptr = NULL;
+#ifdef _WIN32
+    ptr = _aligned_malloc(bytes, matrix_alignment);
+#else
+    if (posix_memalign(&ptr, matrix_alignment, bytes) != 0) ptr = NULL;
+#endif
+    if (ptr) memset(ptr, 0, bytes);
+    return ptr;
+}
+
+static void matrix_free_data(void* data) {
+#ifdef __linux__
+    if (data && matrix_unmap(data)) return;
+#endif
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+Matrix* matrix_create_strided(size_t rows, size_t cols, size_t stride) {
+    assert(stride >= cols);
+    
     Matrix* m = (Matrix*)malloc(sizeof(Matrix));
     m->rows = rows;
     m->cols = cols;
-    m->stride = cols;
+    m->stride = stride;
+    m->data16 = NULL;
+    m->dtype = MATRIX_F32;
     m->is_view = 0;
+    m->is_workspace = 0;
     
     #ifdef USE_CUDA
     if (cuda_available()) {
         cuda_matrix_alloc(m);
     } else {
-        m->data = (float*)calloc(rows * cols, sizeof(float));
+        m->data = (float*)matrix_alloc_data(rows * stride * sizeof(float));
     }
     #else
-    m->data = (float*)calloc(rows * cols, sizeof(float));
+    m->data = (float*)matrix_alloc_data(rows * stride * sizeof(float));
     #endif
     
     return m;
 }
 
+Matrix* matrix_create(size_t rows, size_t cols) {
+    return matrix_create_strided(rows, cols, matrix_default_stride(cols));
+}
+
+Matrix* matrix_create_dtype(size_t rows, size_t cols, MatrixDType dtype) {
+    if (dtype == MATRIX_F32) return matrix_create(rows, cols);
+    
+    Matrix* m = (Matrix*)malloc(sizeof(Matrix));
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = matrix_default_stride(cols);
+    m->data = NULL;
+    m->data16 = (uint16_t*)matrix_alloc_data(rows * m->stride * sizeof(uint16_t));
+    m->dtype = dtype;
+    m->is_view = 0;
+    m->is_workspace = 0;
+    return m;
+}
+
+size_t matrix_dtype_size(MatrixDType dtype) {
+    return dtype == MATRIX_F32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+const char* matrix_dtype_name(MatrixDType dtype) {
+    switch (dtype) {
+        case MATRIX_F32:  return "f32";
+        case MATRIX_BF16: return "bf16";
+        case MATRIX_F16:  return "f16";
+        default:          return "unknown";
+    }
+}
+
+const void* matrix_storage(const Matrix* m) {
+    return m->dtype == MATRIX_F32 ? (const void*)m->data : (const void*)m->data16;
+}
+
+void matrix_dtype_to_f32(float* dst, const void* src, MatrixDType dtype, size_t n) {
+    switch (dtype) {
+        case MATRIX_BF16: vec_bf16_to_f32(dst, (const uint16_t*)src, n); break;
+        case MATRIX_F16:  vec_f16_to_f32(dst, (const uint16_t*)src, n); break;
+        default:          vec_copy(dst, (const float*)src, n); break;
+    }
+}
+
+void matrix_dtype_from_f32(void* dst, MatrixDType dtype, const float* src, size_t n) {
+    switch (dtype) {
+        case MATRIX_BF16: vec_f32_to_bf16((uint16_t*)dst, src, n); break;
+        case MATRIX_F16:  vec_f32_to_f16((uint16_t*)dst, src, n); break;
+        default:          vec_copy((float*)dst, src, n); break;
+    }
+}
+
+// Address of element `offset` (in elements) of m's storage
+static const void* matrix_element(const Matrix* m, size_t offset) {
+    return (const char*)matrix_storage(m) + offset * matrix_dtype_size(m->dtype);
+}
+
+// n elements of m starting at `offset` as floats: F32 storage is returned
+// in place, reduced storage is widened into tmp
+static const float* matrix_widen(const Matrix* m, size_t offset, size_t n, float* tmp) {
+    if (m->dtype == MATRIX_F32) return m->data + offset;
+    matrix_dtype_to_f32(tmp, matrix_element(m, offset), m->dtype, n);
+    return tmp;
+}
+
 Matrix* matrix_view(Matrix* src, size_t row_start, size_t col_start, 
                    size_t rows, size_t cols) {
     assert(row_start + rows <= src->rows);
@@ -43,68 +349,228 @@ Matrix* matrix_view(Matrix* src, size_t row_start, size_t col_start,
     view->cols = cols;
     view->stride = src->stride;  // View must use parent's stride for correct indexing
     view->is_view = 1;
-    view->data = src->data + row_start * src->stride + col_start;
+    view->is_workspace = 0;
+    view->dtype = src->dtype;
+    view->data = src->data ? src->data + row_start * src->stride + col_start : NULL;
+    view->data16 = src->data16 ? src->data16 + row_start * src->stride + col_start : NULL;
     
     return view;
 }
 
+Matrix* matrix_wrap(float* data, size_t rows, size_t cols, size_t stride) {
+    assert(stride >= cols);
+    
+    Matrix* m = (Matrix*)malloc(sizeof(Matrix));
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = stride;
+    m->data = data;
+    m->data16 = NULL;
+    m->dtype = MATRIX_F32;
+    m->is_view = 1;  // Not ours to free
+    m->is_workspace = 0;
+    return m;
+}
+
 void matrix_free(Matrix* m) {
-    if (!m) return;
+    if (!m || m->is_workspace) return;
     
-    if (!m->is_view) {
+    if (!m->is_view && m->dtype != MATRIX_F32) {
+        matrix_free_data(m->data16);
+    } else if (!m->is_view) {
         #ifdef USE_CUDA
         if (cuda_available()) {
             cuda_matrix_free(m);
         } else {
-            free(m->data);
+            matrix_free_data(m->data);
         }
         #else
-        free(m->data);
+        matrix_free_data(m->data);
         #endif
     }
     
     free(m);
 }
 
+void matrix_reallocate(Matrix* m) {
+    if (m->is_view || m->is_workspace) return;
+    #ifdef USE_CUDA
+    if (cuda_available() && m->dtype == MATRIX_F32) return;
+    #endif
+    
+    size_t bytes = m->rows * m->stride * matrix_dtype_size(m->dtype);
+    void* old = m->dtype == MATRIX_F32 ? (void*)m->data : (void*)m->data16;
+    void* data = matrix_alloc_data(bytes);
+    if (!data) return;
+    
+    memcpy(data, old, bytes);
+    matrix_free_data(old);
+    if (m->dtype == MATRIX_F32) {
+        m->data = (float*)data;
+    } else {
+        m->data16 = (uint16_t*)data;
+    }
+}
+
+Matrix* matrix_ensure(Matrix* m, size_t rows, size_t cols) {
+    if (m && m->rows == rows && m->cols == cols && m->dtype == MATRIX_F32) return m;
+    matrix_free(m);
+    return matrix_create(rows, cols);
+}
+
+typedef void (*MatrixBinaryKernel)(float* x, const float* y, size_t n);
+typedef void (*MatrixScalarKernel)(float* x, float scalar, size_t n);
+
+// Work items for operands that need widening: chunks of at most
+// MATRIX_CHUNK elements of one row, or of the flat array when everything
+// is contiguous
+typedef struct {
+    size_t rows;    // 1 when flat
+    size_t cols;    // Elements per row, or all of them when flat
+    size_t chunks;  // Chunks per row
+} MatrixChunking;
+
+static MatrixChunking matrix_chunking(const Matrix* m, int flat) {
+    MatrixChunking ch;
+    ch.rows = flat ? 1 : m->rows;
+    ch.cols = flat ? m->rows * m->cols : m->cols;
+    ch.chunks = (ch.cols + MATRIX_CHUNK - 1) / MATRIX_CHUNK;
+    return ch;
+}
+
+// a op= b for a reduced-precision b: each chunk of b is widened into a
+// stack buffer right before the float kernel consumes it
+static void matrix_apply_binary_widened(Matrix* a, const Matrix* b, MatrixBinaryKernel kernel) {
+    MatrixChunking ch = matrix_chunking(a, matrix_is_contiguous(a) && matrix_is_contiguous(b));
+    
+    #pragma omp parallel for if (a->rows * a->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t item = 0; item < ch.rows * ch.chunks; item++) {
+        float tmp[MATRIX_CHUNK];
+        size_t i = item / ch.chunks;
+        size_t start = (item % ch.chunks) * MATRIX_CHUNK;
+        size_t len = ch.cols - start < MATRIX_CHUNK ? ch.cols - start : MATRIX_CHUNK;
+        kernel(a->data + i * a->stride + start,
+               matrix_widen(b, i * b->stride + start, len, tmp), len);
+    }
+}
+
+// a op= b. Two contiguous matrices are processed as one flat array split
+// into chunks, so a single wide row is still shared between threads;
+// anything else goes row by row.
+static void matrix_apply_binary(Matrix* a, const Matrix* b, MatrixBinaryKernel kernel) {
+    assert(a->dtype == MATRIX_F32);
+    if (b->dtype != MATRIX_F32) {
+        matrix_apply_binary_widened(a, b, kernel);
+        return;
+    }
+    
+    size_t n = a->rows * a->cols;
+    if (matrix_is_contiguous(a) && matrix_is_contiguous(b)) {
+        #pragma omp parallel for if (n > NN_PARALLEL_THRESHOLD)
+        for (size_t start = 0; start < n; start += MATRIX_CHUNK) {
+            size_t len = n - start < MATRIX_CHUNK ? n - start : MATRIX_CHUNK;
+            kernel(a->data + start, b->data + start, len);
+        }
+    } else {
+        #pragma omp parallel for if (n > NN_PARALLEL_THRESHOLD)
+        for (size_t i = 0; i < a->rows; i++) {
+            kernel(a->data + i * a->stride, b->data + i * b->stride, a->cols);
+        }
+    }
+}
+
+// m op= scalar, with the same splitting as matrix_apply_binary
+static void matrix_apply_scalar(Matrix* m, float scalar, MatrixScalarKernel kernel,
+                                size_t threshold) {
+    assert(m->dtype == MATRIX_F32);
+    size_t n = m->rows * m->cols;
+    if (matrix_is_contiguous(m)) {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t start = 0; start < n; start += MATRIX_CHUNK) {
+            size_t len = n - start < MATRIX_CHUNK ? n - start : MATRIX_CHUNK;
+            kernel(m->data + start, scalar, len);
+        }
+    } else {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t i = 0; i < m->rows; i++) {
+            kernel(m->data + i * m->stride, scalar, m->cols);
+        }
+    }
+}
+
 void matrix_copy(Matrix* dst, const Matrix* src) {
     assert(dst->rows == src->rows);
     assert(dst->cols == src->cols);
     
-    if (dst->rows == src->rows && dst->cols == src->cols) {
-        for (size_t i = 0; i < src->rows; i++) {
-            for (size_t j = 0; j < src->cols; j++) {
-                dst->data[i * dst->stride + j] = src->data[i * src->stride + j];
-            }
-        }
+    if (dst == src) return;
+    if (dst->dtype != MATRIX_F32) {
+        matrix_convert(dst, src);
+        return;
     }
+    matrix_apply_binary(dst, src, vec_copy);
 }
 
-void matrix_fill(Matrix* m, float value) {
-    for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            m->data[i * m->stride + j] = value;
-        }
+void matrix_convert(Matrix* dst, const Matrix* src) {
+    assert(dst->rows == src->rows);
+    assert(dst->cols == src->cols);
+    
+    if (dst->dtype == MATRIX_F32) {
+        matrix_copy(dst, src);
+        return;
+    }
+    
+    // Narrowing: widen the source chunk if needed, then round it down
+    MatrixChunking ch = matrix_chunking(dst, matrix_is_contiguous(dst) && matrix_is_contiguous(src));
+    #pragma omp parallel for if (dst->rows * dst->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t item = 0; item < ch.rows * ch.chunks; item++) {
+        float tmp[MATRIX_CHUNK];
+        size_t i = item / ch.chunks;
+        size_t start = (item % ch.chunks) * MATRIX_CHUNK;
+        size_t len = ch.cols - start < MATRIX_CHUNK ? ch.cols - start : MATRIX_CHUNK;
+        const float* values = matrix_widen(src, i * src->stride + start, len, tmp);
+        matrix_dtype_from_f32((void*)matrix_element(dst, i * dst->stride + start), dst->dtype,
+                              values, len);
     }
 }
 
+Matrix* matrix_to_dtype(const Matrix* src, MatrixDType dtype) {
+    Matrix* m = matrix_create_dtype(src->rows, src->cols, dtype);
+    matrix_convert(m, src);
+    return m;
+}
+
+void matrix_fill(Matrix* m, float value) {
+    matrix_apply_scalar(m, value, vec_fill, NN_PARALLEL_THRESHOLD);
+}
+
+// Value (i, j) is number i * cols + j of the global stream, so the result
+// depends on neither the stride nor the number of threads
 void matrix_random_uniform(Matrix* m, float min, float max) {
+    RandomStream* s = random_global();
+    if (matrix_is_contiguous(m)) {
+        random_uniform(s, m->data, m->rows * m->cols, min, max);
+        return;
+    }
+
+    #pragma omp parallel for if (m->rows * m->cols > NN_PARALLEL_THRESHOLD)
     for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            m->data[i * m->stride + j] = min + (max - min) * ((float)rand() / RAND_MAX);
-        }
+        random_uniform_at(s, (uint64_t)i * m->cols, m->data + i * m->stride, m->cols, min, max);
     }
+    random_advance(s, (uint64_t)m->rows * m->cols);
 }
 
 void matrix_random_normal(Matrix* m, float mean, float stddev) {
-    // Box-Muller transform for normal distribution
+    RandomStream* s = random_global();
+    if (matrix_is_contiguous(m)) {
+        random_normal(s, m->data, m->rows * m->cols, mean, stddev);
+        return;
+    }
+
+    #pragma omp parallel for if (m->rows * m->cols > NN_PARALLEL_THRESHOLD_HEAVY)
     for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            float u1 = (float)rand() / RAND_MAX;
-            float u2 = (float)rand() / RAND_MAX;
-            float z = sqrtf(-2.0f * logf(u1)) * cosf(2.0f * M_PI * u2);
-            m->data[i * m->stride + j] = mean + stddev * z;
-        }
+        random_normal_at(s, (uint64_t)i * m->cols, m->data + i * m->stride, m->cols, mean, stddev);
     }
+    random_advance(s, (uint64_t)m->rows * m->cols);
 }
 
 void matrix_add(Matrix* a, const Matrix* b) {
@@ -118,71 +584,199 @@ void matrix_add(Matrix* a, const Matrix* b) {
     }
     #endif
     
-    for (size_t i = 0; i < a->rows; i++) {
-        for (size_t j = 0; j < a->cols; j++) {
-            a->data[i * a->stride + j] += b->data[i * b->stride + j];
-        }
-    }
+    matrix_apply_binary(a, b, vec_add);
 }
 
 void matrix_subtract(Matrix* a, const Matrix* b) {
     assert(a->rows == b->rows);
     assert(a->cols == b->cols);
     
-    for (size_t i = 0; i < a->rows; i++) {
-        for (size_t j = 0; j < a->cols; j++) {
-            a->data[i * a->stride + j] -= b->data[i * b->stride + j];
-        }
-    }
+    matrix_apply_binary(a, b, vec_sub);
 }
 
 void matrix_multiply_elementwise(Matrix* a, const Matrix* b) {
     assert(a->rows == b->rows);
     assert(a->cols == b->cols);
     
-    for (size_t i = 0; i < a->rows; i++) {
-        for (size_t j = 0; j < a->cols; j++) {
-            a->data[i * a->stride + j] *= b->data[i * b->stride + j];
-        }
-    }
+    matrix_apply_binary(a, b, vec_mul);
 }
 
 void matrix_scale(Matrix* m, float scalar) {
-    for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            m->data[i * m->stride + j] *= scalar;
-        }
-    }
+    matrix_apply_scalar(m, scalar, vec_scale, NN_PARALLEL_THRESHOLD);
 }
 
 void matrix_add_scalar(Matrix* m, float scalar) {
-    for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            m->data[i * m->stride + j] += scalar;
+    matrix_apply_scalar(m, scalar, vec_add_scalar, NN_PARALLEL_THRESHOLD);
+}
+
+typedef struct {
+    float alpha;
+    float beta;
+    float eps;
+} MatrixFusedArgs;
+
+typedef void (*MatrixFusedKernel)(float* y, const float* a, const float* b, size_t n,
+                                  const MatrixFusedArgs* args);
+
+// y = f(y, a, b) for the fused updates; b may be NULL
+static void matrix_apply_fused(Matrix* y, const Matrix* a, const Matrix* b,
+                               MatrixFusedKernel kernel, const MatrixFusedArgs* args,
+                               size_t threshold) {
+    assert(y->rows == a->rows && y->cols == a->cols);
+    assert(!b || (y->rows == b->rows && y->cols == b->cols));
+    assert(y->dtype == MATRIX_F32);
+    
+    size_t n = y->rows * y->cols;
+    if (a->dtype != MATRIX_F32 || (b && b->dtype != MATRIX_F32)) {
+        int flat = matrix_is_contiguous(y) && matrix_is_contiguous(a) &&
+                   (!b || matrix_is_contiguous(b));
+        MatrixChunking ch = matrix_chunking(y, flat);
+        
+        #pragma omp parallel for if (n > threshold)
+        for (size_t item = 0; item < ch.rows * ch.chunks; item++) {
+            float tmp_a[MATRIX_CHUNK];
+            float tmp_b[MATRIX_CHUNK];
+            size_t i = item / ch.chunks;
+            size_t start = (item % ch.chunks) * MATRIX_CHUNK;
+            size_t len = ch.cols - start < MATRIX_CHUNK ? ch.cols - start : MATRIX_CHUNK;
+            kernel(y->data + i * y->stride + start,
+                   matrix_widen(a, i * a->stride + start, len, tmp_a),
+                   b ? matrix_widen(b, i * b->stride + start, len, tmp_b) : NULL,
+                   len, args);
+        }
+        return;
+    }
+    
+    if (matrix_is_contiguous(y) && matrix_is_contiguous(a) && (!b || matrix_is_contiguous(b))) {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t start = 0; start < n; start += MATRIX_CHUNK) {
+            size_t len = n - start < MATRIX_CHUNK ? n - start : MATRIX_CHUNK;
+            kernel(y->data + start, a->data + start, b ? b->data + start : NULL, len, args);
+        }
+    } else {
+        #pragma omp parallel for if (n > threshold)
+        for (size_t i = 0; i < y->rows; i++) {
+            kernel(y->data + i * y->stride, a->data + i * a->stride,
+                   b ? b->data + i * b->stride : NULL, y->cols, args);
         }
     }
 }
 
+static void matrix_axpby_kernel(float* y, const float* a, const float* b, size_t n,
+                                const MatrixFusedArgs* args) {
+    (void)b;
+    if (args->beta == 1.0f) {
+        vec_axpy(y, args->alpha, a, n);
+    } else {
+        vec_axpby(y, args->alpha, a, args->beta, n);
+    }
+}
+
+static void matrix_fma_kernel(float* y, const float* a, const float* b, size_t n,
+                              const MatrixFusedArgs* args) {
+    vec_fma(y, args->alpha, a, b, args->beta, n);
+}
+
+static void matrix_addcdiv_kernel(float* y, const float* a, const float* b, size_t n,
+                                  const MatrixFusedArgs* args) {
+    vec_addcdiv(y, args->alpha, a, b, args->eps, n);
+}
+
+void matrix_axpy(Matrix* y, float alpha, const Matrix* x) {
+    MatrixFusedArgs args = {alpha, 1.0f, 0.0f};
+    matrix_apply_fused(y, x, NULL, matrix_axpby_kernel, &args, NN_PARALLEL_THRESHOLD);
+}
+
+void matrix_axpby(Matrix* y, float alpha, const Matrix* x, float beta) {
+    MatrixFusedArgs args = {alpha, beta, 0.0f};
+    matrix_apply_fused(y, x, NULL, matrix_axpby_kernel, &args, NN_PARALLEL_THRESHOLD);
+}
+
+void matrix_fma(Matrix* y, float alpha, const Matrix* a, const Matrix* b, float beta) {
+    MatrixFusedArgs args = {alpha, beta, 0.0f};
+    matrix_apply_fused(y, a, b, matrix_fma_kernel, &args, NN_PARALLEL_THRESHOLD);
+}
+
+void matrix_addcmul(Matrix* y, float value, const Matrix* a, const Matrix* b) {
+    matrix_fma(y, value, a, b, 1.0f);
+}
+
+void matrix_addcdiv(Matrix* y, float value, const Matrix* a, const Matrix* b, float eps) {
+    MatrixFusedArgs args = {value, 0.0f, eps};
+    matrix_apply_fused(y, a, b, matrix_addcdiv_kernel, &args, NN_PARALLEL_THRESHOLD_HEAVY);
+}
+
 void matrix_multiply(const Matrix* a, const Matrix* b, Matrix* c) {
-    assert(a->cols == b->rows);
-    assert(a->rows == c->rows);
-    assert(b->cols == c->cols);
+    matrix_gemm(MATRIX_NO_TRANS, MATRIX_NO_TRANS, 1.0f, a, b, 0.0f, c);
+}
+
+void matrix_gemm(MatrixTranspose trans_a, MatrixTranspose trans_b, float alpha,
+                 const Matrix* a, const Matrix* b, float beta, Matrix* c) {
+    size_t m = trans_a == MATRIX_TRANS ? a->cols : a->rows;
+    size_t k = trans_a == MATRIX_TRANS ? a->rows : a->cols;
+    size_t n = trans_b == MATRIX_TRANS ? b->rows : b->cols;
+    
+    assert(k == (trans_b == MATRIX_TRANS ? b->cols : b->rows));
+    assert(m == c->rows);
+    assert(n == c->cols);
+    
+    assert(c->dtype == MATRIX_F32);
     
     #ifdef USE_CUDA
-    if (cuda_available()) {
+    if (cuda_available() && trans_a == MATRIX_NO_TRANS && trans_b == MATRIX_NO_TRANS &&
+        alpha == 1.0f && beta == 0.0f && a->dtype == MATRIX_F32 && b->dtype == MATRIX_F32) {
         cuda_matrix_multiply(a, b, c);
         return;
     }
     #endif
     
-    // Use simple triple loop for now - could be optimized with BLAS
-    for (size_t i = 0; i < a->rows; i++) {
-        for (size_t j = 0; j < b->cols; j++) {
-            float sum = 0.0f;
-            for (size_t k = 0; k < a->cols; k++) {
-                sum += a->data[i * a->stride + k] * b->data[k * b->stride + j];
+    gemm_mixed_ex(trans_a == MATRIX_TRANS, trans_b == MATRIX_TRANS, m, n, k,
+                  alpha, matrix_storage(a), a->dtype, a->stride,
+                  matrix_storage(b), b->dtype, b->stride,
+                  beta, c->data, c->stride, NULL);
+}
+
+void matrix_gemm_batched(MatrixTranspose trans_a, MatrixTranspose trans_b, float alpha,
+                         const Matrix* a, size_t a_offset, const Matrix* b, size_t b_offset,
+                         float beta, Matrix* c, size_t c_offset, size_t batch) {
+    size_t m = trans_a == MATRIX_TRANS ? a->cols : a->rows;
+    size_t k = trans_a == MATRIX_TRANS ? a->rows : a->cols;
+    size_t n = trans_b == MATRIX_TRANS ? b->rows : b->cols;
+    
+    assert(k == (trans_b == MATRIX_TRANS ? b->cols : b->rows));
+    assert(m == c->rows);
+    assert(n == c->cols);
+    assert(a->dtype == MATRIX_F32 && b->dtype == MATRIX_F32 && c->dtype == MATRIX_F32);
+    
+    gemm_sgemm_strided_batched(trans_a == MATRIX_TRANS, trans_b == MATRIX_TRANS, m, n, k,
+                               alpha, a->data, a->stride, a_offset,
+                               b->data, b->stride, b_offset,
+                               beta, c->data, c->stride, c_offset, batch);
+}
+
+// Transposes walk MATRIX_TRANSPOSE_TILE x MATRIX_TRANSPOSE_TILE tiles, small
+// enough that the source and destination rows of a tile stay in L1 and in
+// the TLB, made of 8 x 8 register blocks
+#define MATRIX_TRANSPOSE_TILE 32
+#define MATRIX_TRANSPOSE_BLOCK 8
+
+// dst(j, i) = src(i, j) over rows i0 .. i1 - 1 and columns j0 .. j1 - 1
+static void matrix_transpose_tile(const float* src, size_t lds, float* dst, size_t ldd,
+                                  size_t i0, size_t i1, size_t j0, size_t j1) {
+    const size_t B = MATRIX_TRANSPOSE_BLOCK;
+    for (size_t j = j0; j < j1; j += B) {
+        for (size_t i = i0; i < i1; i += B) {
+            if (i + B <= i1 && j + B <= j1) {
+                vec_transpose_8x8(dst + j * ldd + i, ldd, src + i * lds + j, lds);
+                continue;
+            }
+            size_t ie = i + B < i1 ? i + B : i1;
+            size_t je = j + B < j1 ? j + B : j1;
+            for (size_t ii = i; ii < ie; ii++) {
+                for (size_t jj = j; jj < je; jj++) {
+                    dst[jj * ldd + ii] = src[ii * lds + jj];
+                }
             }
-            c->data[i * c->stride + j] = sum;
         }
     }
 }
@@ -190,44 +784,161 @@ void matrix_multiply(const Matrix* a, const Matrix* b, Matrix* c) {
 void matrix_transpose(const Matrix* src, Matrix* dst) {
     assert(src->rows == dst->cols);
     assert(src->cols == dst->rows);
+    assert(src->dtype == MATRIX_F32 && dst->dtype == MATRIX_F32);
+    assert(src->data != dst->data);  // Square matrices: matrix_transpose_inplace
     
-    for (size_t i = 0; i < src->rows; i++) {
-        for (size_t j = 0; j < src->cols; j++) {
-            dst->data[j * dst->stride + i] = src->data[i * src->stride + j];
+    const size_t T = MATRIX_TRANSPOSE_TILE;
+    size_t row_tiles = (src->rows + T - 1) / T;
+    size_t col_tiles = (src->cols + T - 1) / T;
+    
+    // Tiles are ordered by destination rows so neighbouring threads write
+    // neighbouring rows of dst
+    #pragma omp parallel for collapse(2) schedule(static) if (src->rows * src->cols > NN_PARALLEL_THRESHOLD)
+    for (size_t tj = 0; tj < col_tiles; tj++) {
+        for (size_t ti = 0; ti < row_tiles; ti++) {
+            size_t i1 = (ti + 1) * T < src->rows ? (ti + 1) * T : src->rows;
+            size_t j1 = (tj + 1) * T < src->cols ? (tj + 1) * T : src->cols;
+            matrix_transpose_tile(src->data, src->stride, dst->data, dst->stride,
+                                  ti * T, i1, tj * T, j1);
         }
     }
 }
 
-float matrix_sum(const Matrix* m) {
-    float sum = 0.0f;
-    for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            sum += m->data[i * m->stride + j];
+void matrix_transpose_inplace(Matrix* m) {
+    assert(m->rows == m->cols);
+    assert(m->dtype == MATRIX_F32);
+    
+    const size_t B = MATRIX_TRANSPOSE_BLOCK;
+    const size_t T = MATRIX_TRANSPOSE_TILE;
+    size_t n = m->rows;
+    size_t ld = m->stride;
+    size_t full = n / B * B;
+    size_t tiles = (full + T - 1) / T;
+    
+    // Tile (ti, tj) is swapped with tile (tj, ti) block by block; the
+    // triangle of tile pairs is uneven, so it is handed out dynamically
+    #pragma omp parallel for schedule(dynamic) if (n * n > NN_PARALLEL_THRESHOLD)
+    for (size_t ti = 0; ti < tiles; ti++) {
+        for (size_t tj = ti; tj < tiles; tj++) {
+            size_t i1 = (ti + 1) * T < full ? (ti + 1) * T : full;
+            size_t j1 = (tj + 1) * T < full ? (tj + 1) * T : full;
+            for (size_t i = ti * T; i < i1; i += B) {
+                for (size_t j = ti == tj ? i : tj * T; j < j1; j += B) {
+                    vec_transpose_swap_8x8(m->data + i * ld + j, m->data + j * ld + i, ld);
+                }
+            }
+        }
+    }
+    
+    // The ragged last rows and columns, element by element
+    for (size_t i = full; i < n; i++) {
+        for (size_t j = 0; j < i; j++) {
+            float t = m->data[i * ld + j];
+            m->data[i * ld + j] = m->data[j * ld + i];
+            m->data[j * ld + i] = t;
         }
     }
+}
+
+// Deterministic reductions split the input into at most this many parts,
+// sized from the input alone, and combine the partial sums pairwise
+#define MATRIX_REDUCE_MAX_PARTS 1024
+#define MATRIX_REDUCE_MIN_PART 8192  // Elements
+
+static int matrix_deterministic = -1;  // -1: not read from the environment yet
+
+void matrix_set_deterministic(int enabled) {
+    matrix_deterministic = enabled != 0;
+}
+
+int matrix_get_deterministic(void) {
+    if (matrix_deterministic < 0) {
+        const char* env = getenv("NEUROFORGE_DETERMINISTIC");
+        matrix_deterministic = env && *env && strcmp(env, "0") != 0;
+    }
+    return matrix_deterministic;
+}
+
+float matrix_reduce(size_t count, size_t item_size, MatrixRangeSum fn, const void* ctx) {
+    if (count == 0) return 0.0f;
+    if (item_size == 0) item_size = 1;
+    size_t elements = count * item_size;
+    
+    if (matrix_get_deterministic()) {
+        // The partition depends only on count, so every thread count
+        // evaluates exactly the same tree
+        size_t min_items = (MATRIX_REDUCE_MIN_PART + item_size - 1) / item_size;
+        size_t part = (count + MATRIX_REDUCE_MAX_PARTS - 1) / MATRIX_REDUCE_MAX_PARTS;
+        if (part < min_items) part = min_items;
+        size_t parts = (count + part - 1) / part;
+        
+        float partial[MATRIX_REDUCE_MAX_PARTS];
+        #pragma omp parallel for if (elements > NN_PARALLEL_THRESHOLD)
+        for (size_t p = 0; p < parts; p++) {
+            size_t begin = p * part;
+            size_t end = begin + part < count ? begin + part : count;
+            partial[p] = fn(begin, end, ctx);
+        }
+        return vec_sum(partial, parts);
+    }
+    
+    // Fast mode: one contiguous range per thread, combined in whatever
+    // order the OpenMP runtime chooses
+    float sum = 0.0f;
+    #pragma omp parallel reduction(+:sum) if (elements > NN_PARALLEL_THRESHOLD)
+    {
+        size_t nthreads = 1, tid = 0;
+#ifdef _OPENMP
+        nthreads = (size_t)omp_get_num_threads();
+        tid = (size_t)omp_get_thread_num();
+#endif
+        size_t begin = count * tid / nthreads;
+        size_t end = count * (tid + 1) / nthreads;
+        if (begin < end) sum += fn(begin, end, ctx);
+    }
     return sum;
 }
 
+// Flat ranges of a contiguous matrix
+static float matrix_sum_flat(size_t begin, size_t end, const void* ctx) {
+    const Matrix* m = (const Matrix*)ctx;
+    return vec_sum(m->data + begin, end - begin);
+}
+
+// Row ranges of a strided matrix; the row sums are accumulated in double
+static float matrix_sum_rows(size_t begin, size_t end, const void* ctx) {
+    const Matrix* m = (const Matrix*)ctx;
+    double sum = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        sum += vec_sum(m->data + i * m->stride, m->cols);
+    }
+    return (float)sum;
+}
+
+float matrix_sum(const Matrix* m) {
+    if (matrix_is_contiguous(m)) {
+        return matrix_reduce(m->rows * m->cols, 1, matrix_sum_flat, m);
+    }
+    return matrix_reduce(m->rows, m->cols, matrix_sum_rows, m);
+}
+
+// max/min are exact in any order, so they need no deterministic variant
 float matrix_max(const Matrix* m) {
     float max_val = m->data[0];
+    #pragma omp parallel for reduction(max:max_val) if (m->rows * m->cols > NN_PARALLEL_THRESHOLD)
     for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            if (m->data[i * m->stride + j] > max_val) {
-                max_val = m->data[i * m->stride + j];
-            }
-        }
+        float row_max = vec_max(m->data + i * m->stride, m->cols);
+        if (row_max > max_val) max_val = row_max;
     }
     return max_val;
 }
 
 float matrix_min(const Matrix* m) {
     float min_val = m->data[0];
+    #pragma omp parallel for reduction(min:min_val) if (m->rows * m->cols > NN_PARALLEL_THRESHOLD)
     for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            if (m->data[i * m->stride + j] < min_val) {
-                min_val = m->data[i * m->stride + j];
-            }
-        }
+        float row_min = vec_min(m->data + i * m->stride, m->cols);
+        if (row_min < min_val) min_val = row_min;
     }
     return min_val;
 }
@@ -260,6 +971,7 @@ int matrix_equal(const Matrix* a, const Matrix* b, float tolerance) {
 }
 
 void matrix_from_array(Matrix* m, const float* data) {
+    #pragma omp parallel for if (m->rows * m->cols > NN_PARALLEL_THRESHOLD)
     for (size_t i = 0; i < m->rows; i++) {
         for (size_t j = 0; j < m->cols; j++) {
             m->data[i * m->stride + j] = data[i * m->cols + j];
@@ -267,10 +979,11 @@ void matrix_from_array(Matrix* m, const float* data) {
     }
 }
 
+static void matrix_sqrt_kernel(float* x, float unused, size_t n) {
+    (void)unused;
+    vec_sqrt(x, n);
+}
+
 void matrix_sqrt(Matrix* m) {
-    for (size_t i = 0; i < m->rows; i++) {
-        for (size_t j = 0; j < m->cols; j++) {
-            m->data[i * m->stride + j] = sqrtf(m->data[i * m->stride + j]);
-        }
-    }
+    matrix_apply_scalar(m, 0.0f, matrix_sqrt_kernel, NN_PARALLEL_THRESHOLD_HEAVY);
 }
\ No newline at end of file
@@ -2,19 +2,127 @@
 #define MATRIX_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+// Implementations available behind matrix_multiply and friends
+typedef enum {
+    MATRIX_GEMM_BUILTIN,  // Packed, cache-blocked kernel in gemm.c
+    MATRIX_GEMM_BLAS      // Any CBLAS (OpenBLAS, MKL, ...); needs NN_HAVE_CBLAS
+} MatrixGemmBackend;
+
+// Operand layout for matrix_gemm
+typedef enum {
+    MATRIX_NO_TRANS,  // Use the operand as stored
+    MATRIX_TRANS      // Use the transpose, read in place without copying
+} MatrixTranspose;
+
+// Element type of a matrix's storage. Reduced-precision matrices halve the
+// bytes moved per element; they are widened to float wherever they are read,
+// so all arithmetic and accumulation stays in single precision.
+typedef enum {
+    MATRIX_F32,   // float, in data
+    MATRIX_BF16,  // bfloat16, in data16
+    MATRIX_F16    // IEEE half precision, in data16
+} MatrixDType;
+
+// Default byte alignment of matrix storage (one cache line, one AVX-512 vector)
+#ifndef MATRIX_DEFAULT_ALIGNMENT
+#define MATRIX_DEFAULT_ALIGNMENT 64
+#endif
 
 typedef struct {
     size_t rows;
     size_t cols;
-    size_t stride;
-    float *data;
-    int is_view;
+    size_t stride;  // Elements between the starts of consecutive rows (>= cols)
+    float *data;       // Storage of MATRIX_F32 matrices (NULL otherwise)
+    uint16_t *data16;  // Storage of MATRIX_BF16/MATRIX_F16 matrices (NULL otherwise)
+    MatrixDType dtype;
+    int is_view;       // Storage belongs to another matrix or to the caller (matrix_wrap)
+    int is_workspace;  // Header and data belong to a Workspace (see workspace.h)
 } Matrix;
 
 // Creation and destruction
 Matrix* matrix_create(size_t rows, size_t cols);
+// Like matrix_create but with an explicit leading dimension (stride >= cols)
+Matrix* matrix_create_strided(size_t rows, size_t cols, size_t stride);
 Matrix* matrix_view(Matrix* src, size_t row_start, size_t col_start, size_t rows, size_t cols);
+// Float matrix over caller-owned memory, without copying: rows x cols
+// elements, rows stride (>= cols) elements apart. matrix_free releases only
+// the header; data must stay valid while the matrix is in use.
+Matrix* matrix_wrap(float* data, size_t rows, size_t cols, size_t stride);
 void matrix_free(Matrix* m);
+// Reuse m for a rows x cols float result: returns m unchanged when the
+// shape already matches, otherwise frees it and returns a new matrix
+Matrix* matrix_ensure(Matrix* m, size_t rows, size_t cols);
+
+// Allocation policy for matrix_create. Storage is aligned to `bytes`, a
+// power of two (default MATRIX_DEFAULT_ALIGNMENT); returns -1 for invalid
+// values. With padding enabled every row starts on an aligned boundary and
+// strides that are a multiple of 4 KiB get one extra alignment unit, so the
+// rows of 256/512/1024-wide matrices stop mapping onto the same cache sets.
+// Padding elements are zero and never read by the kernels.
+int matrix_set_alignment(size_t bytes);
+size_t matrix_get_alignment(void);
+void matrix_set_padding(int enabled);
+int matrix_get_padding(void);
+
+// Placement of large matrix storage. Buffers of MATRIX_LARGE_ALLOC_BYTES and
+// up are mapped directly from the OS under this policy; smaller ones always
+// come from the aligned heap. Huge pages cut the TLB misses of GEMMs over
+// big weight matrices; on multi-socket machines the NUMA placement decides
+// which node's memory the threads read.
+#define MATRIX_LARGE_ALLOC_BYTES ((size_t)2 << 20)
+
+typedef enum {
+    MATRIX_PAGES_DEFAULT,  // Regular pages from the aligned heap
+    MATRIX_PAGES_HUGE,     // 2 MiB aligned mapping advised for transparent huge pages
+    MATRIX_PAGES_HUGETLB   // Explicit huge pages (MAP_HUGETLB) while the reserved pool lasts,
+                           // transparent ones after that
+} MatrixPages;
+
+typedef enum {
+    MATRIX_NUMA_DEFAULT,      // Node of the thread that first writes a page
+    MATRIX_NUMA_INTERLEAVE,   // Pages spread round-robin over all nodes
+    MATRIX_NUMA_FIRST_TOUCH   // Zeroed by all OpenMP threads in a static schedule, so
+                              // each thread's share of the buffer is local to it
+} MatrixNuma;
+
+typedef struct {
+    MatrixPages pages;
+    MatrixNuma numa;
+} MatrixAllocPolicy;
+
+// Policy for matrices created from now on. Returns -1, leaving the policy
+// unchanged, where only the default is available (everything but Linux).
+int matrix_set_alloc_policy(MatrixAllocPolicy policy);
+MatrixAllocPolicy matrix_get_alloc_policy(void);
+// Move m's storage into a fresh allocation made under the current policy,
+// keeping its contents. Views and workspace matrices are left alone.
+void matrix_reallocate(Matrix* m);
+
+// Leading dimension matrix_create uses for `cols` columns under the policy
+size_t matrix_default_stride(size_t cols);
+
+// Whether the rows are stored back to back (stride == cols)
+int matrix_is_contiguous(const Matrix* m);
+
+// Reduced-precision storage. A BF16/F16 matrix can be the source of
+// matrix_copy, matrix_convert, the elementwise operations and the fused
+// updates (as the operand that is read, never the one written) and either
+// input of matrix_multiply/matrix_gemm. Everything else expects MATRIX_F32.
+Matrix* matrix_create_dtype(size_t rows, size_t cols, MatrixDType dtype);
+size_t matrix_dtype_size(MatrixDType dtype);
+const char* matrix_dtype_name(MatrixDType dtype);
+// Start of the storage, whatever the element type
+const void* matrix_storage(const Matrix* m);
+// dst = src with conversion between any two element types (same shape);
+// narrowing rounds to nearest even
+void matrix_convert(Matrix* dst, const Matrix* src);
+// New matrix holding src converted to dtype
+Matrix* matrix_to_dtype(const Matrix* src, MatrixDType dtype);
+// n elements of the given type widened to float, and back
+void matrix_dtype_to_f32(float* dst, const void* src, MatrixDType dtype, size_t n);
+void matrix_dtype_from_f32(void* dst, MatrixDType dtype, const float* src, size_t n);
 
 // Basic operations
 void matrix_copy(Matrix* dst, const Matrix* src);
@@ -29,15 +137,63 @@ void matrix_multiply_elementwise(Matrix* a, const Matrix* b);
 void matrix_scale(Matrix* m, float scalar);
 void matrix_add_scalar(Matrix* m, float scalar);
 
+// Fused updates, each a single pass over the operands
+// y += alpha * x
+void matrix_axpy(Matrix* y, float alpha, const Matrix* x);
+// y = alpha * x + beta * y
+void matrix_axpby(Matrix* y, float alpha, const Matrix* x, float beta);
+// y = alpha * a * b + beta * y (elementwise product)
+void matrix_fma(Matrix* y, float alpha, const Matrix* a, const Matrix* b, float beta);
+// y += value * a * b
+void matrix_addcmul(Matrix* y, float value, const Matrix* a, const Matrix* b);
+// y += value * a / (sqrt(b) + eps), the Adam/RMSProp step shape
+void matrix_addcdiv(Matrix* y, float value, const Matrix* a, const Matrix* b, float eps);
+
 // BLAS operations
 void matrix_multiply(const Matrix* a, const Matrix* b, Matrix* c);
+// c = alpha * op(a) * op(b) + beta * c, where op() optionally transposes
+void matrix_gemm(MatrixTranspose trans_a, MatrixTranspose trans_b, float alpha,
+                 const Matrix* a, const Matrix* b, float beta, Matrix* c);
+// matrix_gemm over a batch of same-shaped products. a, b and c describe
+// product 0 (typically views); product i uses the same shapes and strides
+// starting i * a_offset, i * b_offset and i * c_offset elements further on,
+// e.g. col_start + i * head_size for the heads of one matrix or
+// i * rows * stride for stacked sequences. Float operands only.
+void matrix_gemm_batched(MatrixTranspose trans_a, MatrixTranspose trans_b, float alpha,
+                         const Matrix* a, size_t a_offset, const Matrix* b, size_t b_offset,
+                         float beta, Matrix* c, size_t c_offset, size_t batch);
+// dst = src^T, tile by tile on all threads; src and dst must not overlap
 void matrix_transpose(const Matrix* src, Matrix* dst);
+// Square matrices only: transposes m without a destination buffer
+void matrix_transpose_inplace(Matrix* m);
+
+// GEMM backend selection. The default is fixed at build time and can be
+// overridden with NEUROFORGE_GEMM_BACKEND=builtin|blas. Returns -1 if the
+// requested backend was not compiled in.
+int matrix_set_gemm_backend(MatrixGemmBackend backend);
+MatrixGemmBackend matrix_get_gemm_backend(void);
+const char* matrix_gemm_backend_name(MatrixGemmBackend backend);
 
 // Reduction operations
 float matrix_sum(const Matrix* m);
 float matrix_max(const Matrix* m);
 float matrix_min(const Matrix* m);
 
+// Sums fn(begin, end, ctx) over a partition of [0, count) in parallel.
+// item_size is the number of elements one item stands for (1 for flat
+// ranges, cols for rows) and only sizes the work. Used by matrix_sum and
+// the loss functions.
+typedef float (*MatrixRangeSum)(size_t begin, size_t end, const void* ctx);
+float matrix_reduce(size_t count, size_t item_size, MatrixRangeSum fn, const void* ctx);
+
+// Deterministic mode fixes the reduction tree (and keeps GEMM on the
+// built-in kernel), so sums and losses are bit-identical for any thread
+// count. Sums are also the same on every ISA; GEMM and activation results
+// are not, so pin the ISA (cpu_set_isa) to compare runs across machines.
+// Off by default; NEUROFORGE_DETERMINISTIC=1 turns it on.
+void matrix_set_deterministic(int enabled);
+int matrix_get_deterministic(void);
+
 // Utility functions
 void matrix_print(const Matrix* m, const char* name);
 int matrix_equal(const Matrix* a, const Matrix* b, float tolerance);
@@ -3,13 +3,23 @@
 #include "activations/activation.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 Network* network_create() {
     Network* net = (Network*)malloc(sizeof(Network));
     memset(net, 0, sizeof(Network));
+    net->workspace = workspace_create(0);
+    net->seed = RANDOM_DEFAULT_SEED;
+    net->is_training = 1;
     return net;
 }
 
+// Layer streams use the upper half of the stream id space so they never
+// coincide with the global stream or with random_stream_split()
+static RandomStream network_layer_stream(uint64_t seed, int index) {
+    return random_stream(seed, (1ULL << 63) | (uint64_t)index);
+}
+
 void network_add_layer(Network* net, Layer* layer) {
     if (!net->input_layer) {
         net->input_layer = layer;
@@ -18,10 +28,107 @@ void network_add_layer(Network* net, Layer* layer) {
         net->output_layer->next = layer;
         net->output_layer = layer;
     }
+    layer->workspace = net->workspace;
+    layer->is_training = net->is_training;
+    layer->rng = network_layer_stream(net->seed, net->layer_count);
     net->layer_count++;
 }
 
+int network_set_weight_dtype(Network* net, MatrixDType dtype) {
+    int converted = 0;
+    for (Layer* layer = net->input_layer; layer; layer = layer->next) {
+        if (dense_layer_set_weight_dtype(layer, dtype) == 0) converted++;
+    }
+    return converted;
+}
+
+int network_quantize(Network* net, const Matrix* calibration) {
+    // Calibrate on the float path, in inference mode
+    network_dequantize(net);
+    workspace_reset(net->workspace);
+    
+    int count = 0;
+    const Matrix* current = calibration;
+    for (Layer* layer = net->input_layer; layer; layer = layer->next) {
+        float scale = 0.0f;
+        if (calibration) {
+            float hi = matrix_max(current);
+            float lo = matrix_min(current);
+            scale = quantize_scale(hi > -lo ? hi : -lo);
+            
+            int was_training = layer->is_training;
+            layer->is_training = 0;
+            layer->forward(layer, current);
+            layer->is_training = was_training;
+            current = layer->output;
+        }
+        if (dense_layer_quantize(layer, scale) == 0) count++;
+    }
+    return count;
+}
+
+void network_dequantize(Network* net) {
+    for (Layer* layer = net->input_layer; layer; layer = layer->next) {
+        dense_layer_dequantize(layer);
+    }
+}
+
+void network_set_training(Network* net, int training) {
+    net->is_training = training;
+    for (Layer* layer = net->input_layer; layer; layer = layer->next) {
+        layer->is_training = training;
+    }
+}
+
+void network_set_seed(Network* net, uint64_t seed) {
+    net->seed = seed;
+    int index = 0;
+    for (Layer* layer = net->input_layer; layer; layer = layer->next) {
+        layer->rng = network_layer_stream(seed, index++);
+    }
+}
+
+// Switch to the network's allocation policy for the duration of a call;
+// network_policy_leave restores the one returned
+static MatrixAllocPolicy network_policy_enter(Network* net) {
+    MatrixAllocPolicy previous = matrix_get_alloc_policy();
+    if (net->has_alloc_policy) matrix_set_alloc_policy(net->alloc_policy);
+    return previous;
+}
+
+static void network_policy_leave(Network* net, MatrixAllocPolicy previous) {
+    if (net->has_alloc_policy) matrix_set_alloc_policy(previous);
+}
+
+int network_set_alloc_policy(Network* net, MatrixAllocPolicy policy) {
+    MatrixAllocPolicy previous = matrix_get_alloc_policy();
+    if (matrix_set_alloc_policy(policy) != 0) return -1;
+    
+    for (Layer* layer = net->input_layer; layer; layer = layer->next) {
+        Matrix* buffers[] = {
+            layer->weights, layer->biases, layer->running_mean, layer->running_variance,
+            layer->grad_weights, layer->grad_biases, layer->input, layer->output,
+            layer->hidden_state, layer->mask, layer->grad_input, layer->pre_activation
+        };
+        for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+            if (buffers[i]) matrix_reallocate(buffers[i]);
+        }
+    }
+    if (net->optimizer && net->optimizer->m) {
+        for (int i = 0; i < net->optimizer->param_count; i++) {
+            matrix_reallocate(net->optimizer->m[i]);
+            matrix_reallocate(net->optimizer->v[i]);
+        }
+    }
+    
+    matrix_set_alloc_policy(previous);
+    net->alloc_policy = policy;
+    net->has_alloc_policy = 1;
+    return 0;
+}
+
 void network_compile(Network* net, Optimizer* optimizer, float l2_lambda) {
+    MatrixAllocPolicy previous = network_policy_enter(net);
     net->optimizer = optimizer;
     net->l2_lambda = l2_lambda;
     
@@ -69,51 +176,58 @@ void network_compile(Network* net, Optimizer* optimizer, float l2_lambda) {
         
         net->optimizer->param_count = i;
     }
+    network_policy_leave(net, previous);
 }
 
 void network_set_optimizer(Network* net, Optimizer* optimizer) {
     net->optimizer = optimizer;
 }
 
-Matrix* network_forward(Network* net, const Matrix* input) {
+// Run every layer and return the output layer's own output buffer
+static const Matrix* network_run(Network* net, const Matrix* input) {
+    MatrixAllocPolicy previous = network_policy_enter(net);
+    workspace_reset(net->workspace);
+    
     Layer* layer = net->input_layer;
-    Matrix* current_output = (Matrix*)input;  // Cast away const
+    const Matrix* current_output = input;
     
     while (layer) {
         layer->forward(layer, current_output);
         current_output = layer->output;
         layer = layer->next;
     }
+    network_policy_leave(net, previous);
+    return current_output;
+}
+
+Matrix* network_forward(Network* net, const Matrix* input) {
+    const Matrix* output = network_run(net, input);
     
     // Create a copy of the output
-    Matrix* output_copy = matrix_create(current_output->rows, current_output->cols);
-    matrix_copy(output_copy, current_output);
+    Matrix* output_copy = matrix_create(output->rows, output->cols);
+    matrix_copy(output_copy, output);
     return output_copy;
 }
 
-void network_backward(Network* net, const Matrix* target) {
+// Backpropagate the gradient w.r.t. the output layer's output
+static void network_backward_from(Network* net, const Matrix* output_grad) {
     // Start from output layer and move backwards
     Layer* layer = net->output_layer;
-    Matrix* grad = NULL;
+    const Matrix* grad = output_grad;
     
     while (layer) {
-        if (layer == net->output_layer) {
-            // Output layer: compute derivative of loss
-            grad = matrix_create(layer->output->rows, layer->output->cols);
-            // Create a copy of target for subtraction
-            Matrix* target_copy = matrix_create(target->rows, target->cols);
-            matrix_copy(target_copy, target);
-            matrix_subtract(layer->output, target_copy);
-            matrix_copy(grad, layer->output);
-            matrix_free(target_copy);
-        } else {
-            // Hidden layer: backpropagate the gradient
-            Matrix* new_grad = matrix_create(layer->output->rows, layer->output->cols);
-            // This would be computed based on the next layer's backward pass
-            // For now, just copy (simplified)
-            matrix_copy(new_grad, grad);
-            matrix_free(grad);
-            grad = new_grad;
+        if (layer != net->output_layer) {
+            // Hidden layer: the gradient w.r.t. this layer's output is the
+            // gradient the next layer computed w.r.t. its input. Layers that
+            // do not produce one pass the incoming gradient through unchanged.
+            const Matrix* next_grad = layer->next->grad_input;
+            if (next_grad && next_grad->rows == layer->output->rows &&
+                next_grad->cols == layer->output->cols) {
+                grad = next_grad;
+            } else if (grad->rows != layer->output->rows ||
+                       grad->cols != layer->output->cols) {
+                break;  // Gradient cannot flow through a shape change
+            }
         }
         
         layer->backward(layer, grad);
@@ -124,21 +238,70 @@ void network_backward(Network* net, const Matrix* target) {
         }
         layer = prev_layer;
     }
+}
+
+void network_backward(Network* net, const Matrix* target) {
+    MatrixAllocPolicy previous = network_policy_enter(net);
+    workspace_reset(net->workspace);
+    
+    // Output layer: compute derivative of loss (output - target)
+    Layer* layer = net->output_layer;
+    Matrix* output_grad = workspace_matrix(net->workspace, layer->output->rows, layer->output->cols);
+    matrix_copy(output_grad, layer->output);
+    matrix_subtract(output_grad, target);
+    network_backward_from(net, output_grad);
     
-    if (grad) matrix_free(grad);
+    matrix_free(output_grad);
+    network_policy_leave(net, previous);
 }
 
 void network_update(Network* net) {
+    workspace_reset(net->workspace);
     if (net->optimizer) {
         net->optimizer->update(net->optimizer);
     }
 }
 
+// A dense softmax output layer trains on its logits: the loss and its
+// gradient come from softmax_cross_entropy in one sweep, with no separate
+// softmax, log and subtraction passes over the output
+static int network_fused_softmax(const Network* net) {
+    const Layer* layer = net->output_layer;
+    return layer && layer->type == LAYER_DENSE && layer->activation == ACTIVATION_SOFTMAX;
+}
+
+// One training step on a softmax output layer, against target rows or labels
+static float network_train_softmax(Network* net, const Matrix* input, const Matrix* target,
+                                   const int* labels) {
+    network_set_training(net, 1);
+    
+    Layer* layer = net->output_layer;
+    layer->defer_softmax = 1;
+    const Matrix* logits = network_run(net, input);
+    layer->defer_softmax = 0;
+    
+    MatrixAllocPolicy previous = network_policy_enter(net);
+    workspace_reset(net->workspace);
+    Matrix* output_grad = workspace_matrix(net->workspace, logits->rows, logits->cols);
+    float loss = target ? softmax_cross_entropy(logits, target, output_grad)
+                        : softmax_cross_entropy_labels(logits, labels, output_grad);
+    network_backward_from(net, output_grad);
+    matrix_free(output_grad);
+    network_policy_leave(net, previous);
+    
+    network_update(net);
+    return loss;
+}
+
 float network_train(Network* net, const Matrix* input, const Matrix* target) {
-    net->is_training = 1;
+    if (network_fused_softmax(net)) {
+        return network_train_softmax(net, input, target, NULL);
+    }
     
-    // Forward pass
-    Matrix* output = network_forward(net, input);
+    network_set_training(net, 1);
+    
+    // Forward pass; the loss is read straight from the output layer
+    const Matrix* output = network_run(net, input);
     
     // Compute loss
     float loss = cross_entropy_loss(output, target);
@@ -149,23 +312,58 @@ float network_train(Network* net, const Matrix* input, const Matrix* target) {
     // Update parameters
     network_update(net);
     
-    matrix_free(output);
+    return loss;
+}
+
+float network_train_labels(Network* net, const Matrix* input, const int* labels) {
+    if (network_fused_softmax(net)) {
+        return network_train_softmax(net, input, NULL, labels);
+    }
+    
+    // Other output layers need the dense targets
+    Matrix* target = matrix_create(input->rows, (size_t)net->output_layer->output_size);
+    matrix_fill(target, 0.0f);
+    for (size_t i = 0; i < target->rows; i++) {
+        target->data[i * target->stride + labels[i]] = 1.0f;
+    }
+    float loss = network_train(net, input, target);
+    matrix_free(target);
     return loss;
 }
 
 float network_test(Network* net, const Matrix* input, const Matrix* target) {
-    net->is_training = 0;
+    network_set_training(net, 0);
     
     // Forward pass
-    Matrix* output = network_forward(net, input);
+    const Matrix* output = network_run(net, input);
     
     // Compute loss
     float loss = cross_entropy_loss(output, target);
     
-    matrix_free(output);
     return loss;
 }
 
+float network_test_labels(Network* net, const Matrix* input, const int* labels) {
+    network_set_training(net, 0);
+    
+    // The loss is taken from the logits, so the softmax is skipped as well
+    Layer* layer = net->output_layer;
+    int fused = network_fused_softmax(net);
+    layer->defer_softmax = fused;
+    const Matrix* output = network_run(net, input);
+    layer->defer_softmax = 0;
+    
+    if (fused) {
+        return softmax_cross_entropy_labels(output, labels, NULL);
+    }
+    
+    double loss = 0.0;
+    for (size_t i = 0; i < output->rows; i++) {
+        loss += -logf(output->data[i * output->stride + labels[i]] + 1e-10f);
+    }
+    return (float)(loss / output->rows);
+}
+
 void network_free(Network* net) {
     Layer* layer = net->input_layer;
     while (layer) {
@@ -178,5 +376,6 @@ void network_free(Network* net) {
         net->optimizer->free(net->optimizer);
     }
     
+    workspace_free(net->workspace);
     free(net);
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "matrix.h"
 #include "layers/layer.h"
 #include "optimizers/optimizer.h"
+#include "workspace.h"
+#include "random.h"
 
 typedef struct {
     Layer* input_layer;
@@ -19,6 +21,18 @@ typedef struct {
     
     // Training state
     int is_training;
+    
+    // Seed of the layers' random streams (dropout masks)
+    uint64_t seed;
+    
+    // Per-step scratch shared by the layers and the optimizer. It is reset
+    // at the start of every forward, backward and update call.
+    Workspace* workspace;
+    
+    // Allocation policy in force while the network runs (see
+    // network_set_alloc_policy); unused while has_alloc_policy is 0
+    MatrixAllocPolicy alloc_policy;
+    int has_alloc_policy;
 } Network;
 
 // Network creation and management
@@ -26,16 +40,49 @@ Network* network_create();
 void network_add_layer(Network* net, Layer* layer);
 void network_compile(Network* net, Optimizer* optimizer, float l2_lambda);
 void network_set_optimizer(Network* net, Optimizer* optimizer);
+// Give every layer a fresh stream derived from seed and its position, so
+// training with the same seed repeats the same dropout masks. Weights are
+// initialized when a layer is created; call random_seed() before building
+// the network to make those reproducible as well.
+void network_set_seed(Network* net, uint64_t seed);
+// Convert the weights of every dense layer to dtype, e.g. MATRIX_BF16 for
+// inference (see dense_layer_set_weight_dtype). Returns the number of
+// layers converted.
+int network_set_weight_dtype(Network* net, MatrixDType dtype);
+// Post-training int8 quantization of every dense layer. The calibration
+// rows are run through the float network once to record the range of each
+// dense layer's input; with calibration == NULL inputs are scaled per batch.
+// The quantized network is for inference; network_dequantize() goes back
+// to the float path. Returns the number of layers quantized.
+int network_quantize(Network* net, const Matrix* calibration);
+void network_dequantize(Network* net);
+// Place the network's matrices under policy (huge pages, NUMA placement;
+// see MatrixAllocPolicy): the existing parameters, gradients, buffers and
+// optimizer state are moved now, and everything the network allocates
+// later while compiling, running or training follows the policy. Returns -1
+// if the platform does not support it.
+int network_set_alloc_policy(Network* net, MatrixAllocPolicy policy);
 void network_free(Network* net);
 
-// Forward and backward pass
+// Training (the default) or inference mode for every layer. In inference
+// mode dropout is off and layers keep no copies of their inputs for the
+// backward pass, so a batch wrapped with matrix_wrap is read in place.
+// network_train and network_test switch modes themselves.
+void network_set_training(Network* net, int training);
+
+// Forward and backward pass; network_backward needs a forward in training mode
 Matrix* network_forward(Network* net, const Matrix* input);
 void network_backward(Network* net, const Matrix* target);
 void network_update(Network* net);
 
-// Training functions
+// Training functions. A dense softmax output layer is trained on its
+// logits with the fused softmax_cross_entropy, so after network_train its
+// output holds logits; network_forward still returns probabilities.
 float network_train(Network* net, const Matrix* input, const Matrix* target);
 float network_test(Network* net, const Matrix* input, const Matrix* target);
+// Same with the class index of every input row instead of one-hot targets
+float network_train_labels(Network* net, const Matrix* input, const int* labels);
+float network_test_labels(Network* net, const Matrix* input, const int* labels);
 
 // Serialization
 void network_save(Network* net, const char* filename);
@@ -13,46 +13,29 @@ static void adam_update(void* optimizer_ptr) {
     float beta2_t = powf(optimizer->beta2, optimizer->t);
     float lr_t = optimizer->learning_rate * sqrtf(1 - beta2_t) / (1 - beta1_t);
     
+    // The step below is lr_t * m_hat / (sqrt(v_hat) + epsilon) with the bias
+    // corrections m_hat = m / (1 - beta1^t) and v_hat = v / (1 - beta2^t)
+    // folded into the scalars, so m and v are never copied
+    float c2 = sqrtf(1.0f - beta2_t);
+    float step = -lr_t * c2 / (1.0f - beta1_t);
+    float eps = optimizer->epsilon * c2;
+    
     for (int i = 0; i < optimizer->param_count; i++) {
         Matrix* param = optimizer->params[i];
         Matrix* grad = optimizer->grads[i];
         Matrix* m = optimizer->m[i];
         Matrix* v = optimizer->v[i];
         
-        // Update biased first moment estimate: m = beta1 * m + (1 - beta1) * grad
-        matrix_scale(m, optimizer->beta1);
-        matrix_scale(grad, 1.0f - optimizer->beta1);
-        matrix_add(m, grad);
-        matrix_scale(grad, 1.0f / (1.0f - optimizer->beta1));  // Restore grad
-        
-        // Update biased second raw moment estimate: v = beta2 * v + (1 - beta2) * grad^2
-        Matrix* grad_squared = matrix_create(grad->rows, grad->cols);
-        matrix_copy(grad_squared, grad);
-        matrix_multiply_elementwise(grad_squared, grad_squared);
-        
-        matrix_scale(v, optimizer->beta2);
-        matrix_scale(grad_squared, 1.0f - optimizer->beta2);
-        matrix_add(v, grad_squared);
-        matrix_free(grad_squared);
-        
-        // Compute bias-corrected moments
-        Matrix* m_hat = matrix_create(m->rows, m->cols);
-        matrix_copy(m_hat, m);
-        matrix_scale(m_hat, 1.0f / (1.0f - beta1_t));
+        // m = beta1 * m + (1 - beta1) * grad
+        matrix_axpby(m, 1.0f - optimizer->beta1, grad, optimizer->beta1);
         
-        Matrix* v_hat = matrix_create(v->rows, v->cols);
-        matrix_copy(v_hat, v);
-        matrix_scale(v_hat, 1.0f / (1.0f - beta2_t));
+        // v = beta2 * v + (1 - beta2) * grad^2
+        matrix_fma(v, 1.0f - optimizer->beta2, grad, grad, optimizer->beta2);
         
-        // Update parameters: param = param - lr_t * m_hat / (sqrt(v_hat) + epsilon)
-        for (size_t j = 0; j < param->rows * param->cols; j++) {
-            float denominator = sqrtf(v_hat->data[j]) + optimizer->epsilon;
-            param->data[j] -= lr_t * m_hat->data[j] / denominator;
-        }
+        // param -= lr_t * m_hat / (sqrt(v_hat) + epsilon)
+        matrix_addcdiv(param, step, m, v, eps);
         
-        matrix_free(m_hat);
-        matrix_free(v_hat);
-        matrix_scale(grad, 0.0f);  // Reset gradients
+        matrix_fill(grad, 0.0f);  // Reset gradients
     }
 }
 
@@ -13,21 +13,14 @@ static void rmsprop_update(void* optimizer_ptr) {
         Matrix* cache = optimizer->v[i];  // Using v for cache in RMSProp
         
         // Update cache: cache = decay * cache + (1 - decay) * grad^2
-        matrix_multiply_elementwise(grad, grad);  // grad = grad^2
-        matrix_scale(cache, optimizer->beta1);     // decay is stored in beta1
-        matrix_scale(grad, 1.0f - optimizer->beta1);
-        matrix_add(cache, grad);
-        matrix_sqrt(grad);  // Restore grad to original values: grad = sqrt(grad^2)
-        matrix_scale(grad, 1.0f / (1.0f - optimizer->beta1));  // Complete restoration
+        // (decay is stored in beta1)
+        matrix_fma(cache, 1.0f - optimizer->beta1, grad, grad, optimizer->beta1);
         
         // Update parameters: param = param - learning_rate * grad / (sqrt(cache) + epsilon)
-        for (size_t j = 0; j < param->rows * param->cols; j++) {
-            float denominator = sqrtf(cache->data[j]) + optimizer->epsilon;
-            param->data[j] -= optimizer->learning_rate * grad->data[j] / denominator;
-        }
+        matrix_addcdiv(param, -optimizer->learning_rate, grad, cache, optimizer->epsilon);
         
         // Reset gradients
-        matrix_scale(grad, 0.0f);
+        matrix_fill(grad, 0.0f);
     }
     
     optimizer->t++;
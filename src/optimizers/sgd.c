@@ -8,9 +8,8 @@ static void sgd_update(void* optimizer_ptr) {
     
     for (int i = 0; i < optimizer->param_count; i++) {
         // param = param - learning_rate * grad
-        matrix_scale(optimizer->grads[i], -optimizer->learning_rate);
-        matrix_add(optimizer->params[i], optimizer->grads[i]);
-        matrix_scale(optimizer->grads[i], 0.0f);  // Reset gradients
+        matrix_axpy(optimizer->params[i], -optimizer->learning_rate, optimizer->grads[i]);
+        matrix_fill(optimizer->grads[i], 0.0f);  // Reset gradients
     }
     
     optimizer->t++;
@@ -0,0 +1,17 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Element count below which elementwise kernels and reductions stay serial.
+// Waking an OpenMP team costs a few microseconds, which is more than the
+// work itself on small matrices (biases, tiny batches).
+#ifndef NN_PARALLEL_THRESHOLD
+#define NN_PARALLEL_THRESHOLD 32768
+#endif
+
+// Elementwise kernels whose per-element cost is dominated by a
+// transcendental (exp, tanh, log) pay off at a much smaller size
+#ifndef NN_PARALLEL_THRESHOLD_HEAVY
+#define NN_PARALLEL_THRESHOLD_HEAVY 4096
+#endif
+
+#endif // PARALLEL_H
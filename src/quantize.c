@@ -0,0 +1,141 @@
+#include "quantize.h"
+#include "parallel.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+// Below this many multiply-adds the int8 GEMM stays on one thread
+#define QUANT_PARALLEL_OPS (128 * 128 * 128)
+
+// Round half away from zero, saturated to [-127, 127]. Branch-free so the
+// loops over it vectorize.
+static int8_t quantize_value(float v) {
+    v = v > 127.0f ? 127.0f : v;
+    v = v < -127.0f ? -127.0f : v;
+    return (int8_t)(int32_t)(v + copysignf(0.5f, v));
+}
+
+float quantize_scale(float max_abs) {
+    return max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+}
+
+QuantizedMatrix* quantized_matrix_create(const Matrix* weights) {
+    size_t k = weights->rows;
+    size_t n = weights->cols;
+    size_t n_padded = (n + QUANT_N_BLOCK - 1) / QUANT_N_BLOCK * QUANT_N_BLOCK;
+
+    QuantizedMatrix* q = (QuantizedMatrix*)malloc(sizeof(QuantizedMatrix));
+    q->rows = k;
+    q->cols = n;
+    q->k_padded = (k + QUANT_K_ALIGN - 1) / QUANT_K_ALIGN * QUANT_K_ALIGN;
+    if (q->k_padded == 0) q->k_padded = QUANT_K_ALIGN;
+    q->data = (int8_t*)calloc(n_padded * q->k_padded, sizeof(int8_t));
+    q->scales = (float*)malloc(n * sizeof(float));
+    q->sums = (int32_t*)calloc(n_padded, sizeof(int32_t));
+
+    // Widened copy of W^T, so both passes below read output channels contiguously
+    float* wt = (float*)malloc(n * k * sizeof(float));
+    float* row = (float*)malloc(n * sizeof(float));
+    for (size_t p = 0; p < k; p++) {
+        matrix_dtype_to_f32(row, (const char*)matrix_storage(weights) +
+                                 p * weights->stride * matrix_dtype_size(weights->dtype),
+                            weights->dtype, n);
+        for (size_t j = 0; j < n; j++) {
+            wt[j * k + p] = row[j];
+        }
+    }
+
+    #pragma omp parallel for if (n * k > NN_PARALLEL_THRESHOLD)
+    for (size_t j = 0; j < n; j++) {
+        const float* w = wt + j * k;
+        float max_abs = 0.0f;
+        for (size_t p = 0; p < k; p++) {
+            float v = fabsf(w[p]);
+            if (v > max_abs) max_abs = v;
+        }
+
+        float scale = quantize_scale(max_abs);
+        int8_t* dst = q->data + j * q->k_padded;
+        int32_t sum = 0;
+        for (size_t p = 0; p < k; p++) {
+            dst[p] = quantize_value(w[p] / scale);
+            sum += dst[p];
+        }
+        q->scales[j] = scale;
+        q->sums[j] = sum;
+    }
+
+    free(row);
+    free(wt);
+    return q;
+}
+
+void quantized_matrix_free(QuantizedMatrix* q) {
+    if (!q) return;
+    free(q->data);
+    free(q->scales);
+    free(q->sums);
+    free(q);
+}
+
+void quantize_rows(const Matrix* x, float scale, int8_t* dst, size_t ld) {
+    assert(x->dtype == MATRIX_F32);
+    assert(ld >= x->cols);
+
+    // Stores through int8_t may alias anything, so keep the shape in locals
+    // or the loop bound is reloaded every iteration and nothing vectorizes
+    float inv_scale = 1.0f / scale;
+    size_t rows = x->rows;
+    size_t cols = x->cols;
+    #pragma omp parallel for if (rows * cols > NN_PARALLEL_THRESHOLD)
+    for (size_t i = 0; i < rows; i++) {
+        const float* src = x->data + i * x->stride;
+        int8_t* out = dst + i * ld;
+        for (size_t j = 0; j < cols; j++) {
+            out[j] = quantize_value(src[j] * inv_scale);
+        }
+        memset(out + cols, 0, ld - cols);
+    }
+}
+
+void quantized_gemm(size_t m, const int8_t* a, float a_scale, const QuantizedMatrix* q,
+                    const float* bias, ActivationType activation, float* c, size_t ldc) {
+    const QuantKernel* qk = &kernels()->quant;
+    size_t k = q->k_padded;
+    size_t blocks = (q->cols + QUANT_N_BLOCK - 1) / QUANT_N_BLOCK;
+
+    // Column blocks outermost: the QUANT_N_BLOCK weight rows stay in L1
+    // while the activation rows stream past them
+    size_t row_blocks = (m + qk->m_block - 1) / qk->m_block;
+    #pragma omp parallel for collapse(2) schedule(static) if (m * q->cols * k >= QUANT_PARALLEL_OPS)
+    for (size_t jb = 0; jb < blocks; jb++) {
+        for (size_t ib = 0; ib < row_blocks; ib++) {
+            size_t i0 = ib * qk->m_block;
+            size_t j0 = jb * QUANT_N_BLOCK;
+            size_t rows = m - i0 < qk->m_block ? m - i0 : qk->m_block;
+            size_t count = q->cols - j0 < QUANT_N_BLOCK ? q->cols - j0 : QUANT_N_BLOCK;
+            
+            // A short last row block repeats its last row; the extra
+            // results are dropped
+            const int8_t* arows[KERNEL_QUANT_M_MAX];
+            for (size_t r = 0; r < qk->m_block; r++) {
+                arows[r] = a + (i0 + (r < rows ? r : rows - 1)) * k;
+            }
+            int32_t acc[KERNEL_QUANT_M_MAX * QUANT_N_BLOCK];
+            qk->kernel(arows, q->data + j0 * k, k, k, acc);
+
+            // Requantize to float, add the bias and activate in one step
+            for (size_t r = 0; r < rows; r++) {
+                float* crow = c + (i0 + r) * ldc + j0;
+                for (size_t j = 0; j < count; j++) {
+                    int32_t v = acc[r * QUANT_N_BLOCK + j] - qk->input_offset * q->sums[j0 + j];
+                    crow[j] = (float)v * (a_scale * q->scales[j0 + j]) +
+                              (bias ? bias[j0 + j] : 0.0f);
+                }
+                activate_array(crow, count, activation);
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "matrix.h"
+#include "activations/activation.h"
+
+// Reduction length of the int8 kernels is padded to a multiple of this with
+// zeros, so the dot products run on whole vectors without tails
+#define QUANT_K_ALIGN 64
+
+// Output channels are processed four at a time; the weight rows are padded
+// to a multiple of this with zero rows
+#define QUANT_N_BLOCK 4
+
+// Symmetric per-output-channel int8 weights of a k x n float matrix,
+// stored transposed (one row of k_padded values per output channel) so that
+// every output is a contiguous int8 dot product
+typedef struct {
+    size_t rows;      // k, inputs
+    size_t cols;      // n, output channels
+    size_t k_padded;  // Row length of data
+    int8_t* data;     // n_padded x k_padded
+    float* scales;    // Per output channel: weight = scale * q
+    int32_t* sums;    // Per output channel sum of q, for the unsigned-input kernels
+} QuantizedMatrix;
+
+QuantizedMatrix* quantized_matrix_create(const Matrix* weights);
+void quantized_matrix_free(QuantizedMatrix* q);
+
+// Scale that maps [-max_abs, max_abs] onto [-127, 127]
+float quantize_scale(float max_abs);
+
+// dst[i * ld + j] = round(x(i, j) / scale), saturated to [-127, 127];
+// the row is zero-padded up to ld
+void quantize_rows(const Matrix* x, float scale, int8_t* dst, size_t ld);
+
+// c = act(dequantize(a * q) + bias) for m rows of int8 activations a
+// (leading dimension q->k_padded) with scale a_scale. Accumulation is int32;
+// the scaling, bias and activation are applied while each block of outputs
+// is still in registers. Softmax is left to the caller. bias may be NULL.
+void quantized_gemm(size_t m, const int8_t* a, float a_scale, const QuantizedMatrix* q,
+                    const float* bias, ActivationType activation, float* c, size_t ldc);
+
+#endif // QUANTIZE_H
@@ -0,0 +1,167 @@
+#include "random.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Philox4x32-10 constants (Salmon et al., "Parallel random numbers: as
+// easy as 1, 2, 3", SC'11)
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// Counter blocks generated together. The rounds run over structure-of-
+// arrays lanes so the compiler can keep a whole batch in vector registers.
+#define RANDOM_BATCH 16
+
+// Values per parallel work item in random_uniform/random_normal
+#define RANDOM_CHUNK 4096
+
+static RandomStream random_global_stream = {RANDOM_DEFAULT_SEED, 0, 0};
+static uint64_t random_next_id = 1;  // Stream 0 is the global stream
+
+RandomStream random_stream(uint64_t seed, uint64_t id) {
+    RandomStream s;
+    s.seed = seed;
+    s.id = id;
+    s.offset = 0;
+    return s;
+}
+
+void random_seed(uint64_t seed) {
+    random_global_stream = random_stream(seed, 0);
+    random_next_id = 1;
+}
+
+RandomStream* random_global(void) {
+    return &random_global_stream;
+}
+
+RandomStream random_stream_split(void) {
+    uint64_t id;
+    #pragma omp atomic capture
+    id = random_next_id++;
+    return random_stream(random_global_stream.seed, id);
+}
+
+void random_advance(RandomStream* s, uint64_t count) {
+    s->offset += count;
+}
+
+// 4 x RANDOM_BATCH random words for counter blocks block .. block + RANDOM_BATCH - 1,
+// stored block by block
+static void philox_batch(const RandomStream* s, uint64_t block, uint32_t* out) {
+    uint32_t c0[RANDOM_BATCH], c1[RANDOM_BATCH], c2[RANDOM_BATCH], c3[RANDOM_BATCH];
+    for (size_t b = 0; b < RANDOM_BATCH; b++) {
+        uint64_t ctr = block + b;
+        c0[b] = (uint32_t)ctr;
+        c1[b] = (uint32_t)(ctr >> 32);
+        c2[b] = (uint32_t)s->id;
+        c3[b] = (uint32_t)(s->id >> 32);
+    }
+
+    uint32_t k0 = (uint32_t)s->seed;
+    uint32_t k1 = (uint32_t)(s->seed >> 32);
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        for (size_t b = 0; b < RANDOM_BATCH; b++) {
+            uint64_t p0 = (uint64_t)PHILOX_M0 * c0[b];
+            uint64_t p1 = (uint64_t)PHILOX_M1 * c2[b];
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[b] ^ k0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[b] ^ k1;
+            c1[b] = (uint32_t)p1;
+            c3[b] = (uint32_t)p0;
+            c0[b] = n0;
+            c2[b] = n2;
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    for (size_t b = 0; b < RANDOM_BATCH; b++) {
+        out[4 * b + 0] = c0[b];
+        out[4 * b + 1] = c1[b];
+        out[4 * b + 2] = c2[b];
+        out[4 * b + 3] = c3[b];
+    }
+}
+
+// Top 24 bits as a float in [0, 1)
+static float random_unit(uint32_t x) {
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// Writes values first .. first + n - 1; transform turns one batch of words
+// into RANDOM_BATCH * 4 floats in stream order
+typedef void (*RandomTransform)(const uint32_t* words, float* values, float a, float b);
+
+static void random_generate(const RandomStream* s, uint64_t first, float* out, size_t n,
+                            RandomTransform transform, float a, float b) {
+    const uint64_t per_batch = RANDOM_BATCH * 4;
+    uint64_t pos = s->offset + first;
+    uint64_t end = pos + n;
+    uint32_t words[RANDOM_BATCH * 4];
+    float values[RANDOM_BATCH * 4];
+
+    while (pos < end) {
+        uint64_t batch_start = pos / per_batch * per_batch;
+        philox_batch(s, batch_start / 4, words);
+        transform(words, values, a, b);
+
+        uint64_t stop = batch_start + per_batch < end ? batch_start + per_batch : end;
+        memcpy(out, values + (pos - batch_start), (size_t)(stop - pos) * sizeof(float));
+        out += stop - pos;
+        pos = stop;
+    }
+}
+
+static void random_transform_uniform(const uint32_t* words, float* values, float min, float max) {
+    float scale = max - min;
+    for (size_t i = 0; i < RANDOM_BATCH * 4; i++) {
+        values[i] = min + scale * random_unit(words[i]);
+    }
+}
+
+// Box-Muller on each pair of words; both the cosine and the sine branch are kept
+static void random_transform_normal(const uint32_t* words, float* values, float mean, float stddev) {
+    for (size_t i = 0; i < RANDOM_BATCH * 4; i += 2) {
+        float u1 = random_unit(words[i]) + (1.0f / 16777216.0f);  // (0, 1]
+        float u2 = random_unit(words[i + 1]);
+        float r = stddev * sqrtf(-2.0f * logf(u1));
+        float theta = 2.0f * (float)M_PI * u2;
+        values[i] = mean + r * cosf(theta);
+        values[i + 1] = mean + r * sinf(theta);
+    }
+}
+
+void random_uniform_at(const RandomStream* s, uint64_t first, float* out, size_t n,
+                       float min, float max) {
+    random_generate(s, first, out, n, random_transform_uniform, min, max);
+}
+
+void random_normal_at(const RandomStream* s, uint64_t first, float* out, size_t n,
+                      float mean, float stddev) {
+    random_generate(s, first, out, n, random_transform_normal, mean, stddev);
+}
+
+void random_uniform(RandomStream* s, float* out, size_t n, float min, float max) {
+    #pragma omp parallel for if (n > NN_PARALLEL_THRESHOLD)
+    for (size_t start = 0; start < n; start += RANDOM_CHUNK) {
+        size_t len = n - start < RANDOM_CHUNK ? n - start : RANDOM_CHUNK;
+        random_uniform_at(s, start, out + start, len, min, max);
+    }
+    random_advance(s, n);
+}
+
+void random_normal(RandomStream* s, float* out, size_t n, float mean, float stddev) {
+    #pragma omp parallel for if (n > NN_PARALLEL_THRESHOLD_HEAVY)
+    for (size_t start = 0; start < n; start += RANDOM_CHUNK) {
+        size_t len = n - start < RANDOM_CHUNK ? n - start : RANDOM_CHUNK;
+        random_normal_at(s, start, out + start, len, mean, stddev);
+    }
+    random_advance(s, n);
+}
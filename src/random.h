@@ -0,0 +1,43 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Counter-based random numbers (Philox4x32-10). Value number i of a stream
+// is a pure function of (seed, stream id, i), so any range of a stream can
+// be generated by any thread in any order and the result does not depend
+// on how the work was split. A stream only remembers how far it has been
+// consumed.
+typedef struct {
+    uint64_t seed;    // Philox key
+    uint64_t id;      // Stream number, the upper half of the counter
+    uint64_t offset;  // Values consumed so far
+} RandomStream;
+
+#define RANDOM_DEFAULT_SEED 0x5EEDULL
+
+RandomStream random_stream(uint64_t seed, uint64_t id);
+
+// Seed of the global stream behind matrix_random_uniform/normal and of the
+// streams handed out by random_stream_split(). Resets both.
+void random_seed(uint64_t seed);
+RandomStream* random_global(void);
+
+// A fresh stream derived from the global seed, e.g. for a new layer
+RandomStream random_stream_split(void);
+
+// Fill out[k] with value number first + k of the stream, for k < n.
+// These do not advance the stream; use random_advance() once the whole
+// range has been consumed.
+void random_uniform_at(const RandomStream* s, uint64_t first, float* out, size_t n,
+                       float min, float max);
+void random_normal_at(const RandomStream* s, uint64_t first, float* out, size_t n,
+                      float mean, float stddev);
+void random_advance(RandomStream* s, uint64_t count);
+
+// Fill n values and advance the stream
+void random_uniform(RandomStream* s, float* out, size_t n, float min, float max);
+void random_normal(RandomStream* s, float* out, size_t n, float mean, float stddev);
+
+#endif // RANDOM_H
@@ -12,6 +12,31 @@
 #define NN_MAGIC 0x4E4E4C31  // "NNL1"
 #define NN_VERSION 1
 
+// Matrix payloads are written densely, row by row, so the file format does
+// not depend on the in-memory stride
+// Values are always written as float; reduced-precision matrices are
+// widened row by row
+static void write_matrix_data(FILE* fp, const Matrix* m) {
+    if (m->dtype != MATRIX_F32) {
+        float* row = (float*)malloc(m->cols * sizeof(float));
+        for (size_t i = 0; i < m->rows; i++) {
+            matrix_dtype_to_f32(row, m->data16 + i * m->stride, m->dtype, m->cols);
+            fwrite(row, sizeof(float), m->cols, fp);
+        }
+        free(row);
+        return;
+    }
+    for (size_t i = 0; i < m->rows; i++) {
+        fwrite(m->data + i * m->stride, sizeof(float), m->cols, fp);
+    }
+}
+
+static void read_matrix_data(FILE* fp, Matrix* m) {
+    for (size_t i = 0; i < m->rows; i++) {
+        fread(m->data + i * m->stride, sizeof(float), m->cols, fp);
+    }
+}
+
 void network_serialize(Network* net, const char* filename) {
     FILE* fp = fopen(filename, "wb");
     if (!fp) {
@@ -46,14 +71,12 @@ void network_serialize(Network* net, const char* filename) {
                 // Write weights matrix
                 fwrite(&layer->weights->rows, sizeof(size_t), 1, fp);
                 fwrite(&layer->weights->cols, sizeof(size_t), 1, fp);
-                fwrite(layer->weights->data, sizeof(float), 
-                      layer->weights->rows * layer->weights->cols, fp);
+                write_matrix_data(fp, layer->weights);
                 
                 // Write biases matrix
                 fwrite(&layer->biases->rows, sizeof(size_t), 1, fp);
                 fwrite(&layer->biases->cols, sizeof(size_t), 1, fp);
-                fwrite(layer->biases->data, sizeof(float), 
-                      layer->biases->rows * layer->biases->cols, fp);
+                write_matrix_data(fp, layer->biases);
                 break;
                 
             case LAYER_CONV2D:
@@ -64,6 +87,12 @@ void network_serialize(Network* net, const char* filename) {
                 // Implementation for RNN layer
                 break;
                 
+            case LAYER_LAYOUT:
+                fwrite(&layer->input_size, sizeof(int), 1, fp);
+                fwrite(&layer->input_layout, sizeof(int), 1, fp);
+                fwrite(&layer->output_layout, sizeof(int), 1, fp);
+                break;
+                
             default:
                 fprintf(stderr, "Unknown layer type: %d\n", layer->type);
                 break;
@@ -130,7 +159,7 @@ Network* network_deserialize(const char* filename) {
                     return NULL;
                 }
                 
-                fread(layer->weights->data, sizeof(float), rows * cols, fp);
+                read_matrix_data(fp, layer->weights);
                 
                 // Read biases
                 fread(&rows, sizeof(size_t), 1, fp);
@@ -143,7 +172,7 @@ Network* network_deserialize(const char* filename) {
                     return NULL;
                 }
                 
-                fread(layer->biases->data, sizeof(float), rows * cols, fp);
+                read_matrix_data(fp, layer->biases);
                 break;
             }
                 
@@ -155,6 +184,15 @@ Network* network_deserialize(const char* filename) {
                 // Implementation for RNN layer
                 break;
                 
+            case LAYER_LAYOUT: {
+                int channels, from, to;
+                fread(&channels, sizeof(int), 1, fp);
+                fread(&from, sizeof(int), 1, fp);
+                fread(&to, sizeof(int), 1, fp);
+                layer = layout_layer(channels, (ConvLayout)from, (ConvLayout)to);
+                break;
+            }
+                
             default:
                 fprintf(stderr, "Unknown layer type: %d\n", layer_type);
                 fclose(fp);
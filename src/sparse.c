@@ -0,0 +1,200 @@
+#include "sparse.h"
+#include "parallel.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+// Widen rows p0 .. p0 + count - 1 of m into tmp (count x cols floats);
+// rows past the end of m are zero
+static void sparse_load_rows(const Matrix* m, size_t p0, size_t count, float* tmp) {
+    size_t elem = matrix_dtype_size(m->dtype);
+    for (size_t r = 0; r < count; r++) {
+        float* dst = tmp + r * m->cols;
+        if (p0 + r < m->rows) {
+            const char* src = (const char*)matrix_storage(m) + (p0 + r) * m->stride * elem;
+            matrix_dtype_to_f32(dst, src, m->dtype, m->cols);
+        } else {
+            memset(dst, 0, m->cols * sizeof(float));
+        }
+    }
+}
+
+static int sparse_block_kept(const float* tmp, size_t ld, size_t br, size_t j0, size_t width,
+                             float threshold) {
+    for (size_t r = 0; r < br; r++) {
+        for (size_t j = 0; j < width; j++) {
+            if (fabsf(tmp[r * ld + j0 + j]) > threshold) return 1;
+        }
+    }
+    return 0;
+}
+
+static SparseMatrix* sparse_build(const Matrix* m, SparseFormat format, size_t br, size_t bc,
+                                  float threshold) {
+    assert(br > 0 && bc > 0);
+
+    size_t block_rows = (m->rows + br - 1) / br;
+    size_t block_cols = (m->cols + bc - 1) / bc;
+    size_t block_size = br * bc;
+
+    SparseMatrix* s = (SparseMatrix*)malloc(sizeof(SparseMatrix));
+    s->format = format;
+    s->rows = m->rows;
+    s->cols = m->cols;
+    s->block_rows = br;
+    s->block_cols = bc;
+    s->row_ptr = (size_t*)malloc((block_rows + 1) * sizeof(size_t));
+
+    float* tmp = (float*)malloc(br * m->cols * sizeof(float) + 1);
+
+    // Count the kept blocks of every block row, then fill them in
+    s->row_ptr[0] = 0;
+    for (size_t P = 0; P < block_rows; P++) {
+        sparse_load_rows(m, P * br, br, tmp);
+        size_t kept = 0;
+        for (size_t J = 0; J < block_cols; J++) {
+            size_t width = m->cols - J * bc < bc ? m->cols - J * bc : bc;
+            kept += sparse_block_kept(tmp, m->cols, br, J * bc, width, threshold);
+        }
+        s->row_ptr[P + 1] = s->row_ptr[P] + kept;
+    }
+
+    s->blocks = s->row_ptr[block_rows];
+    s->col_idx = (size_t*)malloc(s->blocks * sizeof(size_t) + 1);
+    s->values = (float*)calloc(s->blocks * block_size + 1, sizeof(float));
+
+    for (size_t P = 0; P < block_rows; P++) {
+        sparse_load_rows(m, P * br, br, tmp);
+        size_t e = s->row_ptr[P];
+        for (size_t J = 0; J < block_cols; J++) {
+            size_t width = m->cols - J * bc < bc ? m->cols - J * bc : bc;
+            if (!sparse_block_kept(tmp, m->cols, br, J * bc, width, threshold)) continue;
+
+            float* block = s->values + e * block_size;
+            for (size_t r = 0; r < br; r++) {
+                for (size_t j = 0; j < width; j++) {
+                    float v = tmp[r * m->cols + J * bc + j];
+                    block[r * bc + j] = fabsf(v) > threshold ? v : 0.0f;
+                }
+            }
+            s->col_idx[e++] = J;
+        }
+    }
+
+    free(tmp);
+    return s;
+}
+
+SparseMatrix* sparse_from_dense(const Matrix* m, float threshold) {
+    return sparse_build(m, SPARSE_CSR, 1, 1, threshold);
+}
+
+SparseMatrix* sparse_bsr_from_dense(const Matrix* m, size_t block_rows, size_t block_cols,
+                                    float threshold) {
+    return sparse_build(m, SPARSE_BSR, block_rows, block_cols, threshold);
+}
+
+void sparse_free(SparseMatrix* s) {
+    if (!s) return;
+    free(s->row_ptr);
+    free(s->col_idx);
+    free(s->values);
+    free(s);
+}
+
+void sparse_to_dense(const SparseMatrix* s, Matrix* dst) {
+    assert(dst->rows == s->rows && dst->cols == s->cols);
+    matrix_fill(dst, 0.0f);
+
+    size_t br = s->block_rows;
+    size_t bc = s->block_cols;
+    size_t block_rows = (s->rows + br - 1) / br;
+    for (size_t P = 0; P < block_rows; P++) {
+        for (size_t e = s->row_ptr[P]; e < s->row_ptr[P + 1]; e++) {
+            const float* block = s->values + e * br * bc;
+            size_t j0 = s->col_idx[e] * bc;
+            for (size_t r = 0; r < br && P * br + r < s->rows; r++) {
+                float* row = dst->data + (P * br + r) * dst->stride;
+                for (size_t j = 0; j < bc && j0 + j < s->cols; j++) {
+                    row[j0 + j] = block[r * bc + j];
+                }
+            }
+        }
+    }
+}
+
+float sparse_density(const SparseMatrix* s) {
+    if (s->rows == 0 || s->cols == 0) return 0.0f;
+    float stored = (float)s->blocks * s->block_rows * s->block_cols;
+    return stored / ((float)s->rows * s->cols);
+}
+
+void sparse_gemm(const Matrix* a, const SparseMatrix* s, Matrix* c,
+                 const float* bias, ActivationType activation) {
+    assert(a->cols == s->cols);
+    assert(c->rows == a->rows && c->cols == s->rows);
+    assert(a->dtype == MATRIX_F32 && c->dtype == MATRIX_F32);
+
+    size_t m = a->rows;
+    size_t k = s->cols;
+    size_t n = s->rows;
+    size_t br = s->block_rows;
+    size_t bc = s->block_cols;
+    size_t block_size = br * bc;
+    size_t block_rows = (n + br - 1) / br;
+    size_t k_padded = (k + bc - 1) / bc * bc;
+    size_t groups = (m + SPARSE_ROW_GROUP - 1) / SPARSE_ROW_GROUP;
+    int parallel = m * s->blocks * block_size > NN_PARALLEL_THRESHOLD;
+
+    // a transposed group by group: row p of group g holds a[i0 + r][p] in
+    // lane r, so every stored weight scales one contiguous vector. Lanes past
+    // the last row and rows past k (under the padded blocks) are zero.
+    Matrix* a_t = matrix_create_strided(groups * k_padded, SPARSE_ROW_GROUP, SPARSE_ROW_GROUP);
+    // Results in the same layout, copied out in tiles at the end: storing
+    // them straight into c would put SPARSE_ROW_GROUP stores per output on
+    // rows a whole stride apart
+    Matrix* c_t = matrix_create_strided(groups * n, SPARSE_ROW_GROUP, SPARSE_ROW_GROUP);
+
+    #pragma omp parallel for collapse(2) if (parallel)
+    for (size_t g = 0; g < groups; g++) {
+        for (size_t p = 0; p < k; p++) {
+            size_t i0 = g * SPARSE_ROW_GROUP;
+            size_t rows = m - i0 < SPARSE_ROW_GROUP ? m - i0 : SPARSE_ROW_GROUP;
+            float* dst = a_t->data + (g * k_padded + p) * SPARSE_ROW_GROUP;
+            for (size_t r = 0; r < rows; r++) dst[r] = a->data[(i0 + r) * a->stride + p];
+        }
+    }
+
+    const KernelTable* table = kernels();
+    #pragma omp parallel for collapse(2) schedule(dynamic, 16) if (parallel)
+    for (size_t g = 0; g < groups; g++) {
+        for (size_t P = 0; P < block_rows; P++) {
+            table->sparse_block_row(s, P, a_t->data + g * k_padded * SPARSE_ROW_GROUP, bias,
+                                    c_t->data + g * n * SPARSE_ROW_GROUP);
+        }
+    }
+
+    #pragma omp parallel for collapse(2) if (parallel)
+    for (size_t g = 0; g < groups; g++) {
+        for (size_t j0 = 0; j0 < n; j0 += SPARSE_ROW_GROUP) {
+            size_t i0 = g * SPARSE_ROW_GROUP;
+            size_t rows = m - i0 < SPARSE_ROW_GROUP ? m - i0 : SPARSE_ROW_GROUP;
+            size_t cols = n - j0 < SPARSE_ROW_GROUP ? n - j0 : SPARSE_ROW_GROUP;
+            const float* src = c_t->data + (g * n + j0) * SPARSE_ROW_GROUP;
+            for (size_t r = 0; r < rows; r++) {
+                float* row = c->data + (i0 + r) * c->stride + j0;
+                for (size_t j = 0; j < cols; j++) row[j] = src[j * SPARSE_ROW_GROUP + r];
+            }
+        }
+    }
+
+    matrix_free(a_t);
+    matrix_free(c_t);
+
+    #pragma omp parallel for if (parallel)
+    for (size_t i = 0; i < m; i++) {
+        activate_array(c->data + i * c->stride, n, activation);
+    }
+}
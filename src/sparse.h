@@ -0,0 +1,54 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stddef.h>
+#include "matrix.h"
+#include "activations/activation.h"
+
+typedef enum {
+    SPARSE_CSR,  // Compressed sparse rows, one value per entry
+    SPARSE_BSR   // Block sparse rows, dense block_rows x block_cols blocks
+} SparseFormat;
+
+// Rows of the dense operand that share one pass over the sparse blocks in
+// sparse_gemm; one vector of accumulators per output
+#define SPARSE_ROW_GROUP 16
+
+// Sparse matrix in CSR or BSR form. CSR is BSR with 1 x 1 blocks, so both
+// share the layout: block row P owns blocks row_ptr[P] .. row_ptr[P + 1] - 1,
+// block e sits at block column col_idx[e] and its values are stored row-major
+// at values + e * block_rows * block_cols. Blocks that hang over the right or
+// bottom edge are zero-padded.
+typedef struct {
+    SparseFormat format;
+    size_t rows;
+    size_t cols;
+    size_t block_rows;
+    size_t block_cols;
+    size_t blocks;     // Stored blocks (entries for CSR)
+    size_t* row_ptr;   // Block rows + 1 offsets into col_idx
+    size_t* col_idx;   // Block column of every stored block
+    float* values;     // blocks * block_rows * block_cols values
+} SparseMatrix;
+
+// Keep the entries of m with |value| > threshold. For BSR a block is stored
+// when any of its entries is kept; the dropped entries inside it are zero.
+SparseMatrix* sparse_from_dense(const Matrix* m, float threshold);
+SparseMatrix* sparse_bsr_from_dense(const Matrix* m, size_t block_rows, size_t block_cols,
+                                    float threshold);
+void sparse_free(SparseMatrix* s);
+
+void sparse_to_dense(const SparseMatrix* s, Matrix* dst);
+// Fraction of the matrix that is stored (1.0 for a fully dense one)
+float sparse_density(const SparseMatrix* s);
+
+// c = act(a * s^T + bias) for a dense a (m x k) and a sparse s (n x k) that
+// holds one row per output, like the weight rows of QuantizedMatrix. Each
+// output accumulates in registers over its stored entries for a group of
+// rows of a at once, so there are no scattered stores and output rows can
+// run in parallel even for a single input row. Softmax is left to the
+// caller; bias may be NULL.
+void sparse_gemm(const Matrix* a, const SparseMatrix* s, Matrix* c,
+                 const float* bias, ActivationType activation);
+
+#endif // SPARSE_H
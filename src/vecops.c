@@ -0,0 +1,110 @@
+#include "vecops.h"
+#include "kernels.h"
+
+// The kernels live in kernels/vec_kernels.h and kernels/math_kernels.h, one
+// copy per instruction set;
+// these forward to the copy selected for this CPU
+
+void vec_copy(float* dst, const float* src, size_t n) {
+    kernels()->vec_copy(dst, src, n);
+}
+
+void vec_fill(float* x, float value, size_t n) {
+    kernels()->vec_fill(x, value, n);
+}
+
+void vec_add(float* x, const float* y, size_t n) {
+    kernels()->vec_add(x, y, n);
+}
+
+void vec_sub(float* x, const float* y, size_t n) {
+    kernels()->vec_sub(x, y, n);
+}
+
+void vec_mul(float* x, const float* y, size_t n) {
+    kernels()->vec_mul(x, y, n);
+}
+
+void vec_scale(float* x, float scalar, size_t n) {
+    kernels()->vec_scale(x, scalar, n);
+}
+
+void vec_add_scalar(float* x, float scalar, size_t n) {
+    kernels()->vec_add_scalar(x, scalar, n);
+}
+
+void vec_sqrt(float* x, size_t n) {
+    kernels()->vec_sqrt(x, n);
+}
+
+void vec_exp(float* x, size_t n, VecMathPrecision precision) {
+    kernels()->vec_exp(x, n, precision);
+}
+
+void vec_tanh(float* x, size_t n, VecMathPrecision precision) {
+    kernels()->vec_tanh(x, n, precision);
+}
+
+void vec_sigmoid(float* x, size_t n, VecMathPrecision precision) {
+    kernels()->vec_sigmoid(x, n, precision);
+}
+
+void vec_log1p(float* x, size_t n, VecMathPrecision precision) {
+    kernels()->vec_log1p(x, n, precision);
+}
+
+void vec_erf(float* x, size_t n, VecMathPrecision precision) {
+    kernels()->vec_erf(x, n, precision);
+}
+
+float vec_sum(const float* x, size_t n) {
+    return kernels()->vec_sum(x, n);
+}
+
+float vec_max(const float* x, size_t n) {
+    return kernels()->vec_max(x, n);
+}
+
+float vec_min(const float* x, size_t n) {
+    return kernels()->vec_min(x, n);
+}
+
+void vec_axpy(float* y, float alpha, const float* x, size_t n) {
+    kernels()->vec_axpy(y, alpha, x, n);
+}
+
+void vec_axpby(float* y, float alpha, const float* x, float beta, size_t n) {
+    kernels()->vec_axpby(y, alpha, x, beta, n);
+}
+
+void vec_fma(float* y, float alpha, const float* a, const float* b, float beta, size_t n) {
+    kernels()->vec_fma(y, alpha, a, b, beta, n);
+}
+
+void vec_addcdiv(float* y, float value, const float* a, const float* b, float eps, size_t n) {
+    kernels()->vec_addcdiv(y, value, a, b, eps, n);
+}
+
+void vec_bf16_to_f32(float* dst, const uint16_t* src, size_t n) {
+    kernels()->vec_bf16_to_f32(dst, src, n);
+}
+
+void vec_f32_to_bf16(uint16_t* dst, const float* src, size_t n) {
+    kernels()->vec_f32_to_bf16(dst, src, n);
+}
+
+void vec_f16_to_f32(float* dst, const uint16_t* src, size_t n) {
+    kernels()->vec_f16_to_f32(dst, src, n);
+}
+
+void vec_f32_to_f16(uint16_t* dst, const float* src, size_t n) {
+    kernels()->vec_f32_to_f16(dst, src, n);
+}
+
+void vec_transpose_8x8(float* dst, size_t ldd, const float* src, size_t lds) {
+    kernels()->vec_transpose_8x8(dst, ldd, src, lds);
+}
+
+void vec_transpose_swap_8x8(float* a, float* b, size_t ld) {
+    kernels()->vec_transpose_swap_8x8(a, b, ld);
+}
@@ -0,0 +1,75 @@
+#ifndef VECOPS_H
+#define VECOPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SIMD kernels over n contiguous floats. They are the building blocks of
+// the Matrix elementwise operations: a contiguous matrix is handled as one
+// flat array, a view row by row. Unaligned pointers are fine; the binary
+// operations require that the two arrays are identical or do not overlap.
+
+void vec_copy(float* dst, const float* src, size_t n);
+void vec_fill(float* x, float value, size_t n);
+
+// x op= y
+void vec_add(float* x, const float* y, size_t n);
+void vec_sub(float* x, const float* y, size_t n);
+void vec_mul(float* x, const float* y, size_t n);
+
+// x op= scalar
+void vec_scale(float* x, float scalar, size_t n);
+void vec_add_scalar(float* x, float scalar, size_t n);
+
+void vec_sqrt(float* x, size_t n);
+
+// Accuracy of the transcendental kernels below. PRECISE calls libm for
+// every element; the other tiers are branch-free polynomials that
+// vectorize: ACCURATE stays within ~1e-6 relative error (a few ulp), FAST
+// within ~1e-3 on shorter polynomials.
+typedef enum {
+    VEC_MATH_PRECISE,
+    VEC_MATH_ACCURATE,
+    VEC_MATH_FAST
+} VecMathPrecision;
+
+// x = f(x). vec_exp overflows to infinity and underflows to 0 like expf;
+// vec_log1p is -inf at -1 and NaN below.
+void vec_exp(float* x, size_t n, VecMathPrecision precision);
+void vec_tanh(float* x, size_t n, VecMathPrecision precision);
+void vec_sigmoid(float* x, size_t n, VecMathPrecision precision);
+void vec_log1p(float* x, size_t n, VecMathPrecision precision);
+void vec_erf(float* x, size_t n, VecMathPrecision precision);
+
+// Reductions. vec_sum uses pairwise summation with a tree that depends
+// only on n, so the result is reproducible. vec_max/vec_min need n > 0.
+float vec_sum(const float* x, size_t n);
+float vec_max(const float* x, size_t n);
+float vec_min(const float* x, size_t n);
+
+// Fused BLAS-1 style updates, one pass over the data each
+// y += alpha * x
+void vec_axpy(float* y, float alpha, const float* x, size_t n);
+// y = alpha * x + beta * y
+void vec_axpby(float* y, float alpha, const float* x, float beta, size_t n);
+// y = alpha * a * b + beta * y
+void vec_fma(float* y, float alpha, const float* a, const float* b, float beta, size_t n);
+// y += value * a / (sqrt(b) + eps)
+void vec_addcdiv(float* y, float value, const float* a, const float* b, float eps, size_t n);
+
+// Conversions for reduced-precision storage. bf16 is the upper half of a
+// float (8 exponent, 7 mantissa bits), f16 is IEEE binary16. Narrowing
+// rounds to nearest even; NaN stays NaN and f16 overflows to infinity.
+void vec_bf16_to_f32(float* dst, const uint16_t* src, size_t n);
+void vec_f32_to_bf16(uint16_t* dst, const float* src, size_t n);
+void vec_f16_to_f32(float* dst, const uint16_t* src, size_t n);
+void vec_f32_to_f16(uint16_t* dst, const float* src, size_t n);
+
+// 8 x 8 block transposes, the tiles of matrix_transpose. Row strides are in
+// elements. vec_transpose_8x8 writes dst[j * ldd + i] = src[i * lds + j];
+// vec_transpose_swap_8x8 replaces two blocks of one matrix with each
+// other's transpose (a == b transposes a single block in place).
+void vec_transpose_8x8(float* dst, size_t ldd, const float* src, size_t lds);
+void vec_transpose_swap_8x8(float* a, float* b, size_t ld);
+
+#endif // VECOPS_H
@@ -0,0 +1,228 @@
+#include "conv.h"
+#include "gemm.h"
+#include "parallel.h"
+#include "kernels.h"
+#include <string.h>
+#include <assert.h>
+
+// Transforms of Lavin & Gray, "Fast Algorithms for Convolutional Neural
+// Networks": output = A^T [(G w G^T) .* (B^T d B)] A. G is applied once
+// per filter through the tables; B^T and A^T run on every tile, see
+// kernels/winograd_kernels.h.
+static const float winograd_g2[4 * 3] = {
+    1.0f,  0.0f, 0.0f,
+    0.5f,  0.5f, 0.5f,
+    0.5f, -0.5f, 0.5f,
+    0.0f,  0.0f, 1.0f,
+};
+static const float winograd_g4[6 * 3] = {
+    1.0f / 4,   0.0f,       0.0f,
+    -1.0f / 6,  -1.0f / 6,  -1.0f / 6,
+    -1.0f / 6,  1.0f / 6,   -1.0f / 6,
+    1.0f / 24,  1.0f / 12,  1.0f / 6,
+    1.0f / 24,  -1.0f / 12, 1.0f / 6,
+    0.0f,       0.0f,       1.0f,
+};
+
+// out (rows x rows) = l x l^T with l rows x k and x k x k
+static void winograd_sandwich(const float* l, const float* x, float* out, size_t rows,
+                              size_t k) {
+    float tmp[CONV_WINOGRAD_ALPHA_MAX * 3];
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < k; j++) {
+            float sum = 0.0f;
+            for (size_t p = 0; p < k; p++) sum += l[i * k + p] * x[p * k + j];
+            tmp[i * k + j] = sum;
+        }
+    }
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < rows; j++) {
+            float sum = 0.0f;
+            for (size_t p = 0; p < k; p++) sum += tmp[i * k + p] * l[j * k + p];
+            out[i * rows + j] = sum;
+        }
+    }
+}
+
+int conv_winograd_supported(const ConvGeometry* g) {
+    return g->kernel == 3 && g->stride == 1;
+}
+
+size_t conv_winograd_filter_rows(const ConvGeometry* g, size_t m) {
+    return (m + 2) * (m + 2) * g->filters;
+}
+
+void conv_winograd_filters(const ConvGeometry* g, size_t m, const Matrix* weights, Matrix* u) {
+    assert(m == 2 || m == 4);
+    const float* gt = m == 2 ? winograd_g2 : winograd_g4;
+    size_t alpha = m + 2;
+    size_t elems = alpha * alpha;
+    assert(conv_winograd_supported(g));
+    assert(u->rows == conv_winograd_filter_rows(g, m) && u->cols == g->channels);
+
+    #pragma omp parallel for collapse(2) if (g->filters * g->channels * elems > NN_PARALLEL_THRESHOLD)
+    for (size_t f = 0; f < g->filters; f++) {
+        for (size_t c = 0; c < g->channels; c++) {
+            const float* w = weights->data + f * weights->stride + c * 9;
+            float v[CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_ALPHA_MAX];
+            winograd_sandwich(gt, w, v, alpha, 3);
+            for (size_t xi = 0; xi < elems; xi++) {
+                u->data[(xi * g->filters + f) * u->stride + c] = v[xi];
+            }
+        }
+    }
+}
+
+// Tiles of the block starting at tile0
+static inline size_t winograd_lanes(size_t tiles, size_t tile0) {
+    return tiles - tile0 < CONV_WINOGRAD_LANES ? tiles - tile0 : CONV_WINOGRAD_LANES;
+}
+
+// Tile `tile` of a group: image, and the row and column of its input tile
+// origin in unpadded image coordinates
+static inline void winograd_tile_origin(const ConvGeometry* g, size_t m, size_t tile,
+                                        size_t per_image, size_t tiles_w, size_t* n, long* y,
+                                        long* x) {
+    *n = tile / per_image;
+    *y = (long)(tile % per_image / tiles_w * m) - (long)g->padding;
+    *x = (long)(tile % tiles_w * m) - (long)g->padding;
+}
+
+// Input transform of channel c for tiles tile0 .. tile0 + count - 1 of the
+// images starting at `images`, into columns tile0.. of v
+static inline void winograd_input_tiles(const ConvGeometry* g, size_t m, const Matrix* input,
+                                        size_t images, size_t c, size_t tile0, size_t count,
+                                        size_t per_image, size_t tiles_w, Matrix* v) {
+    const size_t alpha = m + 2, lanes = CONV_WINOGRAD_LANES;
+    float d[CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_LANES];
+    float out[CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_LANES];
+
+    // Gather, with zeros outside the image and in the unused lanes
+    for (size_t l = 0; l < lanes; l++) {
+        if (l >= count) {
+            for (size_t e = 0; e < alpha * alpha; e++) d[e * lanes + l] = 0.0f;
+            continue;
+        }
+        size_t n;
+        long y0, x0;
+        winograd_tile_origin(g, m, tile0 + l, per_image, tiles_w, &n, &y0, &x0);
+        const float* plane = input->data + (images + n) * input->stride +
+                             c * g->height * g->width;
+        int inside = y0 >= 0 && x0 >= 0 && y0 + (long)alpha <= (long)g->height &&
+                     x0 + (long)alpha <= (long)g->width;
+        for (size_t i = 0; i < alpha; i++) {
+            long y = y0 + (long)i;
+            for (size_t j = 0; j < alpha; j++) {
+                long x = x0 + (long)j;
+                int valid = inside || (y >= 0 && x >= 0 && y < (long)g->height &&
+                                       x < (long)g->width);
+                d[(i * alpha + j) * lanes + l] = valid ? plane[y * (long)g->width + x] : 0.0f;
+            }
+        }
+    }
+
+    kernels()->winograd_input(m, d, out);
+    for (size_t xi = 0; xi < alpha * alpha; xi++) {
+        float* dst = v->data + (xi * g->channels + c) * v->stride + tile0;
+        for (size_t l = 0; l < count; l++) dst[l] = out[xi * lanes + l];
+    }
+}
+
+// Output transform of filter f for tiles tile0 .. tile0 + count - 1 from
+// the products p, plus the bias, clipped at the right and bottom edges
+static inline void winograd_output_tiles(const ConvGeometry* g, size_t m, const Matrix* p,
+                                         float bias, size_t images, size_t f, size_t tile0,
+                                         size_t count, size_t per_image, size_t tiles_w,
+                                         Matrix* output) {
+    const size_t alpha = m + 2, lanes = CONV_WINOGRAD_LANES;
+    float prod[CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_ALPHA_MAX * CONV_WINOGRAD_LANES];
+    float y[4 * 4 * CONV_WINOGRAD_LANES];
+
+    for (size_t xi = 0; xi < alpha * alpha; xi++) {
+        const float* src = p->data + (xi * g->filters + f) * p->stride + tile0;
+        for (size_t l = 0; l < lanes; l++) prod[xi * lanes + l] = l < count ? src[l] : 0.0f;
+    }
+    kernels()->winograd_output(m, prod, y);
+
+    size_t positions = conv_out_positions(g);
+    for (size_t l = 0; l < count; l++) {
+        size_t n;
+        long oy, ox;
+        winograd_tile_origin(g, m, tile0 + l, per_image, tiles_w, &n, &oy, &ox);
+        oy += (long)g->padding;
+        ox += (long)g->padding;
+        float* dst = output->data + (images + n) * output->stride + f * positions;
+        size_t rows = g->out_height - (size_t)oy < m ? g->out_height - (size_t)oy : m;
+        size_t cols = g->out_width - (size_t)ox < m ? g->out_width - (size_t)ox : m;
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                dst[((size_t)oy + i) * g->out_width + (size_t)ox + j] =
+                    y[(i * m + j) * lanes + l] + bias;
+            }
+        }
+    }
+}
+
+// Output tiles of images n0 .. n0 + count - 1 go through the transforms in
+// the order (image, tile row, tile column), CONV_WINOGRAD_LANES at a time
+void conv_forward_winograd(const ConvGeometry* g, size_t m, const Matrix* input,
+                           const Matrix* u, const float* bias, Matrix* output, Workspace* ws) {
+    assert(m == 2 || m == 4);
+    size_t alpha = m + 2;
+    size_t elems = alpha * alpha;
+    size_t batch = input->rows;
+    size_t tiles_h = (g->out_height + m - 1) / m;
+    size_t tiles_w = (g->out_width + m - 1) / m;
+    size_t per_image = tiles_h * tiles_w;
+    assert(conv_winograd_supported(g));
+    assert(output->rows == batch && output->cols == g->filters * conv_out_positions(g));
+    assert(u->rows == conv_winograd_filter_rows(g, m) && u->cols == g->channels);
+
+    // Images per group, so the transformed inputs and products stay within
+    // the im2col scratch budget
+    size_t floats_per_image = elems * (g->channels + g->filters) * per_image;
+    size_t group = floats_per_image > 0 ? CONV_COL_FLOATS / floats_per_image : batch;
+    if (group == 0) group = 1;
+    if (group > batch) group = batch;
+
+    // v: element xi of every input tile, (elems * channels) x tiles;
+    // p: the products, (elems * filters) x tiles
+    Matrix* v = workspace_matrix(ws, elems * g->channels, group * per_image);
+    Matrix* p = workspace_matrix(ws, elems * g->filters, group * per_image);
+
+    for (size_t n0 = 0; n0 < batch; n0 += group) {
+        size_t count = batch - n0 < group ? batch - n0 : group;
+        size_t tiles = count * per_image;
+        size_t blocks = (tiles + CONV_WINOGRAD_LANES - 1) / CONV_WINOGRAD_LANES;
+
+        // Input transform, B^T d B
+        #pragma omp parallel for collapse(2) if (tiles * g->channels * elems > NN_PARALLEL_THRESHOLD)
+        for (size_t c = 0; c < g->channels; c++) {
+            for (size_t b = 0; b < blocks; b++) {
+                size_t tile0 = b * CONV_WINOGRAD_LANES;
+                winograd_input_tiles(g, m, input, n0, c, tile0, winograd_lanes(tiles, tile0),
+                                     per_image, tiles_w, v);
+            }
+        }
+
+        // One product per transform element: filters x tiles = u_xi * v_xi
+        gemm_sgemm_strided_batched(0, 0, g->filters, tiles, g->channels,
+                                   1.0f, u->data, u->stride, g->filters * u->stride,
+                                   v->data, v->stride, g->channels * v->stride,
+                                   0.0f, p->data, p->stride, g->filters * p->stride,
+                                   elems);
+
+        // Output transform, A^T p A
+        #pragma omp parallel for collapse(2) if (tiles * g->filters * elems > NN_PARALLEL_THRESHOLD)
+        for (size_t f = 0; f < g->filters; f++) {
+            for (size_t b = 0; b < blocks; b++) {
+                size_t tile0 = b * CONV_WINOGRAD_LANES;
+                winograd_output_tiles(g, m, p, bias ? bias[f] : 0.0f, n0, f, tile0,
+                                      winograd_lanes(tiles, tile0), per_image, tiles_w, output);
+            }
+        }
+    }
+
+    matrix_free(v);
+    matrix_free(p);
+}
@@ -0,0 +1,117 @@
+#include "workspace.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Smallest block worth allocating
+#define WORKSPACE_MIN_BLOCK (64 * 1024)
+
+struct WorkspaceBlock {
+    WorkspaceBlock* next;
+    size_t size;    // Usable bytes after the header
+    size_t offset;  // Bytes handed out from this block
+};
+
+static unsigned char* workspace_block_data(WorkspaceBlock* block) {
+    return (unsigned char*)(block + 1);
+}
+
+static WorkspaceBlock* workspace_new_block(Workspace* ws, size_t size) {
+    WorkspaceBlock* block = (WorkspaceBlock*)malloc(sizeof(WorkspaceBlock) + size);
+    if (!block) return NULL;
+    block->next = ws->blocks;
+    block->size = size;
+    block->offset = 0;
+    ws->blocks = block;
+    ws->heap_allocs++;
+    return block;
+}
+
+static void workspace_release_blocks(Workspace* ws) {
+    WorkspaceBlock* block = ws->blocks;
+    while (block) {
+        WorkspaceBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    ws->blocks = NULL;
+}
+
+Workspace* workspace_create(size_t initial_bytes) {
+    Workspace* ws = (Workspace*)malloc(sizeof(Workspace));
+    memset(ws, 0, sizeof(Workspace));
+    if (initial_bytes > 0) {
+        workspace_new_block(ws, initial_bytes);
+    }
+    return ws;
+}
+
+void workspace_free(Workspace* ws) {
+    if (!ws) return;
+    workspace_release_blocks(ws);
+    free(ws);
+}
+
+void workspace_reset(Workspace* ws) {
+    if (!ws) return;
+
+    // Overflowed into several blocks: replace them with one that fits the
+    // whole step, so the next step bumps through a single block
+    if (ws->blocks && ws->blocks->next) {
+        size_t total = 0;
+        for (WorkspaceBlock* b = ws->blocks; b; b = b->next) {
+            total += b->size;
+        }
+        workspace_release_blocks(ws);
+        workspace_new_block(ws, total > ws->peak ? total : ws->peak);
+    }
+
+    if (ws->blocks) ws->blocks->offset = 0;
+    ws->used = 0;
+}
+
+void* workspace_alloc(Workspace* ws, size_t bytes, size_t alignment) {
+    if (alignment == 0) alignment = sizeof(void*);
+
+    WorkspaceBlock* block = ws->blocks;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (block) {
+            uintptr_t base = (uintptr_t)workspace_block_data(block);
+            uintptr_t start = (base + block->offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            size_t end = (size_t)(start - base) + bytes;
+            if (end <= block->size) {
+                ws->used += end - block->offset;
+                if (ws->used > ws->peak) ws->peak = ws->used;
+                block->offset = end;
+                return (void*)start;
+            }
+        }
+
+        // Grow geometrically so a step needs only a handful of blocks
+        size_t size = block ? block->size * 2 : WORKSPACE_MIN_BLOCK;
+        if (size < bytes + alignment) size = bytes + alignment;
+        block = workspace_new_block(ws, size);
+        if (!block) return NULL;
+    }
+    return NULL;
+}
+
+Matrix* workspace_matrix(Workspace* ws, size_t rows, size_t cols) {
+    if (!ws) return matrix_create(rows, cols);
+
+    size_t stride = matrix_default_stride(cols);
+    Matrix* m = (Matrix*)workspace_alloc(ws, sizeof(Matrix), sizeof(void*));
+    float* data = (float*)workspace_alloc(ws, rows * stride * sizeof(float),
+                                          matrix_get_alignment());
+    if (!m || !data) return matrix_create(rows, cols);
+
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = stride;
+    m->data = data;
+    m->data16 = NULL;
+    m->dtype = MATRIX_F32;
+    m->is_view = 0;
+    m->is_workspace = 1;
+    return m;
+}
@@ -0,0 +1,36 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stddef.h>
+#include "matrix.h"
+
+// Bump allocator for per-step temporaries (gradient scratch, optimizer
+// intermediates, attention scores). Allocation is a pointer increment and
+// workspace_reset() releases everything at once. Storage that outgrows the
+// current block is chained into new blocks; the next reset merges them into
+// a single block sized for the high-water mark, so after the first few
+// steps a training loop runs without touching the heap.
+typedef struct WorkspaceBlock WorkspaceBlock;
+
+typedef struct Workspace {
+    WorkspaceBlock* blocks;  // Most recent block first
+    size_t used;             // Bytes handed out since the last reset
+    size_t peak;             // Largest `used` seen so far
+    size_t heap_allocs;      // Blocks obtained from malloc over the lifetime
+} Workspace;
+
+Workspace* workspace_create(size_t initial_bytes);
+void workspace_free(Workspace* ws);
+
+// Invalidate every allocation made since the previous reset
+void workspace_reset(Workspace* ws);
+
+// Uninitialized storage aligned to `alignment` (a power of two)
+void* workspace_alloc(Workspace* ws, size_t bytes, size_t alignment);
+
+// Uninitialized rows x cols matrix whose header and data both live in the
+// workspace; matrix_free() on it is a no-op. With ws == NULL this falls back
+// to matrix_create(), so callers can free the result unconditionally.
+Matrix* workspace_matrix(Workspace* ws, size_t rows, size_t cols);
+
+#endif // WORKSPACE_H
@@ -2,9 +2,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "../src/layers/layer.h"
 #include "../src/activations/activation.h"
 #include "../src/matrix.h"
+#include "../src/network.h"
 
 void test_dense_layer_forward() {
     printf("Testing dense layer forward pass...\n");
@@ -64,6 +66,163 @@ void test_dense_layer_backward() {
     layer->free(layer);
 }
 
+void test_dense_layer_input_gradient() {
+    printf("Testing dense layer input gradient...\n");
+    
+    // Without an activation, dL/dinput = output_grad * weights^T
+    Layer* layer = dense_layer(3, 2, ACTIVATION_NONE);
+    
+    Matrix* input = matrix_create(2, 3);
+    float input_data[] = {1.0f, 2.0f, 3.0f, -1.0f, 0.5f, 2.0f};
+    matrix_from_array(input, input_data);
+    layer->forward(layer, input);
+    
+    Matrix* output_grad = matrix_create(2, 2);
+    float grad_data[] = {1.0f, -2.0f, 0.5f, 3.0f};
+    matrix_from_array(output_grad, grad_data);
+    layer->backward(layer, output_grad);
+    
+    assert(layer->grad_input != NULL);
+    assert(layer->grad_input->rows == 2);
+    assert(layer->grad_input->cols == 3);
+    
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            float expected = 0.0f;
+            for (size_t k = 0; k < 2; k++) {
+                expected += grad_data[i * 2 + k] * layer->weights->data[j * layer->weights->stride + k];
+            }
+            assert(fabsf(layer->grad_input->data[i * layer->grad_input->stride + j] - expected) < 1e-5f);
+        }
+    }
+    
+    printf("Dense layer input gradient: PASSED\n");
+    
+    // Cleanup
+    matrix_free(input);
+    matrix_free(output_grad);
+    layer->free(layer);
+}
+
+void test_dense_layer_fused_forward() {
+    printf("Testing dense layer fused forward...\n");
+    
+    // Large enough to take the blocked GEMM path, with edge tiles on both axes
+    const size_t batch = 37, in = 300, out = 70;
+    ActivationType acts[] = {ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_SOFTMAX,
+                             ACTIVATION_GELU};
+    
+    for (size_t a = 0; a < sizeof(acts) / sizeof(acts[0]); a++) {
+        Layer* layer = dense_layer((int)in, (int)out, acts[a]);
+        matrix_random_uniform(layer->biases, -0.5f, 0.5f);
+        
+        Matrix* input = matrix_create(batch, in);
+        matrix_random_uniform(input, -1.0f, 1.0f);
+        layer->forward(layer, input);
+        
+        // Only activations differentiated from their input keep a copy of it
+        int keeps_input = activation_backward_needs(acts[a]) == ACTIVATION_BACKWARD_INPUT;
+        assert((layer->pre_activation != NULL) == keeps_input);
+        
+        Matrix* expected = matrix_create(batch, out);
+        matrix_multiply(input, layer->weights, expected);
+        for (size_t i = 0; i < batch; i++) {
+            for (size_t j = 0; j < out; j++) {
+                expected->data[i * expected->stride + j] += layer->biases->data[j];
+                if (!keeps_input) continue;
+                assert(fabsf(layer->pre_activation->data[i * layer->pre_activation->stride + j] -
+                             expected->data[i * expected->stride + j]) < 1e-4f);
+            }
+        }
+        activate(expected, acts[a]);
+        
+        for (size_t i = 0; i < batch; i++) {
+            for (size_t j = 0; j < out; j++) {
+                assert(fabsf(layer->output->data[i * layer->output->stride + j] -
+                             expected->data[i * expected->stride + j]) < 1e-4f);
+            }
+        }
+        
+        matrix_free(expected);
+        matrix_free(input);
+        layer->free(layer);
+    }
+    
+    printf("Dense layer fused forward: PASSED\n");
+}
+
+void test_dense_layer_backward_state() {
+    printf("Testing dense layer backward state...\n");
+    
+    // Bit masks and output-based derivatives must give the gradients of
+    // the pre-activation formula; 70 columns leave a partial mask word
+    const size_t batch = 9, in = 40, out = 70;
+    ActivationType acts[] = {ACTIVATION_RELU, ACTIVATION_LEAKY_RELU, ACTIVATION_SIGMOID,
+                             ACTIVATION_TANH, ACTIVATION_ELU, ACTIVATION_SELU};
+    
+    for (size_t a = 0; a < sizeof(acts) / sizeof(acts[0]); a++) {
+        Layer* layer = dense_layer((int)in, (int)out, acts[a]);
+        matrix_random_uniform(layer->biases, -0.5f, 0.5f);
+        
+        Matrix* input = matrix_create(batch, in);
+        Matrix* output_grad = matrix_create(batch, out);
+        matrix_random_uniform(input, -1.0f, 1.0f);
+        matrix_random_uniform(output_grad, -1.0f, 1.0f);
+        
+        layer->forward(layer, input);
+        assert(layer->pre_activation == NULL);
+        assert((layer->activation_mask != NULL) ==
+               (activation_backward_needs(acts[a]) == ACTIVATION_BACKWARD_MASK));
+        layer->backward(layer, output_grad);
+        
+        // Reference: derivative at the recomputed pre-activation values
+        Matrix* pre = matrix_create(batch, out);
+        matrix_multiply(input, layer->weights, pre);
+        for (size_t i = 0; i < batch; i++) {
+            for (size_t j = 0; j < out; j++) {
+                pre->data[i * pre->stride + j] += layer->biases->data[j];
+            }
+        }
+        Matrix* expected = matrix_create(batch, out);
+        matrix_copy(expected, output_grad);
+        activate_derivative(pre, expected, acts[a]);
+        
+        for (size_t j = 0; j < out; j++) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < batch; i++) sum += expected->data[i * expected->stride + j];
+            assert(fabsf(layer->grad_biases->data[j] - sum) < 1e-4f * (1.0f + fabsf(sum)));
+        }
+        
+        matrix_free(expected);
+        matrix_free(pre);
+        matrix_free(output_grad);
+        matrix_free(input);
+        layer->free(layer);
+    }
+    
+    // Mask words for a length that is not a multiple of the vector widths
+    ActivationMask* mask = activation_mask_ensure(NULL, 3, 131);
+    Matrix* m = matrix_create(3, 131);
+    Matrix* grad = matrix_create(3, 131);
+    matrix_random_uniform(m, -1.0f, 1.0f);
+    matrix_fill(grad, 2.0f);
+    activation_mask_store(mask, m);
+    activate_derivative_mask(mask, grad, ACTIVATION_LEAKY_RELU);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 131; j++) {
+            float expected = m->data[i * m->stride + j] > 0 ? 2.0f : 0.02f;
+            assert(fabsf(grad->data[i * grad->stride + j] - expected) < 1e-6f);
+        }
+        assert((mask->bits[i * mask->stride + 2] >> 3) == 0);  // bits past the row
+    }
+    
+    matrix_free(grad);
+    matrix_free(m);
+    activation_mask_free(mask);
+    
+    printf("Dense layer backward state: PASSED\n");
+}
+
 void test_dense_layer_update() {
     printf("Testing dense layer parameter update...\n");
     
@@ -122,6 +281,603 @@ void test_dense_layer_update() {
     layer->free(layer);
 }
 
+void test_dense_layer_bf16_weights() {
+    printf("Testing dense layer with bf16 weights...\n");
+    
+    Layer* ref = dense_layer(300, 40, ACTIVATION_RELU);
+    Layer* half = dense_layer(300, 40, ACTIVATION_RELU);
+    matrix_copy(half->weights, ref->weights);
+    matrix_copy(half->biases, ref->biases);
+    int rc = dense_layer_set_weight_dtype(half, MATRIX_BF16);
+    assert(rc == 0);
+    (void)rc;
+    assert(half->weights->dtype == MATRIX_BF16);
+    
+    Matrix* input = matrix_create(16, 300);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    ref->forward(ref, input);
+    half->forward(half, input);
+    
+    // bf16 keeps 8 significant bits; with fp32 accumulation the outputs
+    // stay within a few bf16 ulps of the sum's magnitude
+    assert(matrix_equal(ref->output, half->output, 0.05f));
+    assert(!matrix_equal(ref->output, half->output, 0.0f));
+    
+    // Back to float for training
+    rc = dense_layer_set_weight_dtype(half, MATRIX_F32);
+    assert(rc == 0);
+    half->forward(half, input);
+    half->backward(half, half->output);
+    half->update(half, 0.01f);
+    
+    Layer* dropout = dropout_layer(0.5f);
+    assert(dense_layer_set_weight_dtype(dropout, MATRIX_BF16) == -1);
+    
+    printf("Dense layer with bf16 weights: PASSED\n");
+    
+    // Cleanup
+    matrix_free(input);
+    ref->free(ref);
+    half->free(half);
+    dropout->free(dropout);
+}
+
+void test_dense_layer_padded_storage() {
+    printf("Testing dense layer on padded storage...\n");
+    
+    // The same step on dense and on padded matrices must agree exactly
+    Layer* ref = dense_layer(37, 19, ACTIVATION_TANH);
+    Matrix* input = matrix_create(4, 37);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    Matrix* grad = matrix_create(4, 19);
+    matrix_random_uniform(grad, -1.0f, 1.0f);
+    
+    matrix_set_padding(1);
+    Layer* padded = dense_layer(37, 19, ACTIVATION_TANH);
+    Matrix* padded_input = matrix_create(4, 37);
+    Matrix* padded_grad = matrix_create(4, 19);
+    assert(padded->weights->stride != padded->weights->cols);
+    assert(padded_input->stride != padded_input->cols);
+    
+    matrix_copy(padded->weights, ref->weights);
+    matrix_copy(padded->biases, ref->biases);
+    matrix_copy(padded_input, input);
+    matrix_copy(padded_grad, grad);
+    
+    ref->forward(ref, input);
+    padded->forward(padded, padded_input);
+    assert(matrix_equal(ref->output, padded->output, 1e-6f));
+    
+    ref->backward(ref, grad);
+    padded->backward(padded, padded_grad);
+    assert(matrix_equal(ref->grad_weights, padded->grad_weights, 1e-5f));
+    assert(matrix_equal(ref->grad_input, padded->grad_input, 1e-5f));
+    
+    ref->update(ref, 0.1f);
+    padded->update(padded, 0.1f);
+    assert(matrix_equal(ref->weights, padded->weights, 1e-6f));
+    assert(matrix_equal(ref->biases, padded->biases, 1e-6f));
+    matrix_set_padding(0);
+    
+    printf("Dense layer on padded storage: PASSED\n");
+    
+    // Cleanup
+    matrix_free(input);
+    matrix_free(grad);
+    matrix_free(padded_input);
+    matrix_free(padded_grad);
+    ref->free(ref);
+    padded->free(padded);
+}
+
+// Direct convolution of one NCHW image, weights[f][c][ki][kj]
+static float conv_reference(const float* image, const float* weights, size_t c_in, size_t h,
+                            size_t w, size_t k, size_t stride, size_t pad, size_t f,
+                            size_t oy, size_t ox) {
+    float sum = 0.0f;
+    for (size_t c = 0; c < c_in; c++) {
+        for (size_t ki = 0; ki < k; ki++) {
+            for (size_t kj = 0; kj < k; kj++) {
+                long iy = (long)(oy * stride + ki) - (long)pad;
+                long ix = (long)(ox * stride + kj) - (long)pad;
+                if (iy < 0 || ix < 0 || iy >= (long)h || ix >= (long)w) continue;
+                sum += image[(c * h + iy) * w + ix] * weights[((f * c_in + c) * k + ki) * k + kj];
+            }
+        }
+    }
+    return sum;
+}
+
+void test_conv2d_forward() {
+    printf("Testing conv2d forward pass...\n");
+    
+    // {channels, filters, kernel, stride, padding, height, width, batch}:
+    // strided and padded, non-square, pointwise, and a batch split into
+    // several im2col groups
+    size_t cases[4][8] = {
+        {3, 5, 3, 2, 1, 9, 9, 4},
+        {2, 4, 3, 1, 1, 5, 7, 3},
+        {6, 3, 1, 1, 0, 4, 4, 2},
+        {16, 4, 5, 1, 2, 64, 64, 3},
+    };
+    
+    for (size_t t = 0; t < 4; t++) {
+        size_t c_in = cases[t][0], filters = cases[t][1], k = cases[t][2];
+        size_t stride = cases[t][3], pad = cases[t][4], h = cases[t][5], w = cases[t][6];
+        size_t batch = cases[t][7];
+        size_t out_h = (h + 2 * pad - k) / stride + 1, out_w = (w + 2 * pad - k) / stride + 1;
+        
+        Layer* layer = conv2d_layer((int)c_in, (int)filters, (int)k, (int)stride, (int)pad,
+                                    ACTIVATION_RELU);
+        if (h != w) {
+            int rc = conv2d_layer_set_input_shape(layer, (int)h, (int)w);
+            assert(rc == 0);
+            (void)rc;
+        }
+        matrix_random_uniform(layer->biases, -0.5f, 0.5f);
+        
+        Matrix* input = matrix_create(batch, c_in * h * w);
+        matrix_random_uniform(input, -1.0f, 1.0f);
+        layer->forward(layer, input);
+        
+        assert(layer->output->rows == batch && layer->output->cols == filters * out_h * out_w);
+        assert(layer->output_shape.channels == (int)filters);
+        assert(layer->output_shape.height == (int)out_h && layer->output_shape.width == (int)out_w);
+        
+        for (size_t n = 0; n < batch; n++) {
+            const float* image = input->data + n * input->stride;
+            for (size_t f = 0; f < filters; f++) {
+                for (size_t oy = 0; oy < out_h; oy++) {
+                    for (size_t ox = 0; ox < out_w; ox++) {
+                        float v = conv_reference(image, layer->weights->data, c_in, h, w, k,
+                                                 stride, pad, f, oy, ox) +
+                                  layer->biases->data[f];
+                        v = v > 0.0f ? v : 0.0f;
+                        float actual = layer->output->data[n * layer->output->stride +
+                                                           (f * out_h + oy) * out_w + ox];
+                        assert(fabsf(actual - v) < 1e-4f * (1.0f + fabsf(v)));
+                    }
+                }
+            }
+        }
+        
+        matrix_free(input);
+        layer->free(layer);
+    }
+    
+    printf("Conv2d forward pass: PASSED\n");
+}
+
+void test_conv2d_backward() {
+    printf("Testing conv2d backward pass...\n");
+    
+    // Strided and non-square, then a batch of several im2col groups whose
+    // weight gradients accumulate across the groups
+    size_t cases[2][8] = {
+        {3, 4, 3, 2, 1, 7, 6, 3},
+        {16, 2, 5, 1, 2, 64, 64, 3},
+    };
+    
+    for (size_t t = 0; t < 2; t++) {
+        size_t c_in = cases[t][0], filters = cases[t][1], k = cases[t][2];
+        size_t stride = cases[t][3], pad = cases[t][4], h = cases[t][5], w = cases[t][6];
+        size_t batch = cases[t][7], pixels = c_in * h * w;
+        size_t out_h = (h + 2 * pad - k) / stride + 1, out_w = (w + 2 * pad - k) / stride + 1;
+        
+        Layer* layer = conv2d_layer((int)c_in, (int)filters, (int)k, (int)stride, (int)pad,
+                                    ACTIVATION_NONE);
+        conv2d_layer_set_input_shape(layer, (int)h, (int)w);
+        Matrix* input = matrix_create(batch, pixels);
+        Matrix* output_grad = matrix_create(batch, filters * out_h * out_w);
+        matrix_random_uniform(input, -1.0f, 1.0f);
+        matrix_random_uniform(output_grad, -1.0f, 1.0f);
+        
+        layer->forward(layer, input);
+        layer->backward(layer, output_grad);
+        
+        // Every output accumulates input * weight, so its gradient flows
+        // back to both factors of each of those products
+        size_t weight_count = filters * c_in * k * k;
+        double* grad_w = (double*)calloc(weight_count, sizeof(double));
+        double* grad_b = (double*)calloc(filters, sizeof(double));
+        double* grad_x = (double*)calloc(batch * pixels, sizeof(double));
+        for (size_t n = 0; n < batch; n++) {
+            const float* image = input->data + n * input->stride;
+            for (size_t f = 0; f < filters; f++) {
+                for (size_t oy = 0; oy < out_h; oy++) {
+                    for (size_t ox = 0; ox < out_w; ox++) {
+                        double dy = output_grad->data[n * output_grad->stride +
+                                                      (f * out_h + oy) * out_w + ox];
+                        grad_b[f] += dy;
+                        for (size_t c = 0; c < c_in; c++) {
+                            for (size_t ki = 0; ki < k; ki++) {
+                                for (size_t kj = 0; kj < k; kj++) {
+                                    long iy = (long)(oy * stride + ki) - (long)pad;
+                                    long ix = (long)(ox * stride + kj) - (long)pad;
+                                    if (iy < 0 || ix < 0 || iy >= (long)h || ix >= (long)w) {
+                                        continue;
+                                    }
+                                    size_t wi = ((f * c_in + c) * k + ki) * k + kj;
+                                    size_t xi = (c * h + iy) * w + ix;
+                                    grad_w[wi] += dy * image[xi];
+                                    grad_x[n * pixels + xi] += dy * layer->weights->data[wi];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        
+        for (size_t i = 0; i < weight_count; i++) {
+            assert(fabs(layer->grad_weights->data[i] - grad_w[i]) < 1e-4 * (1.0 + fabs(grad_w[i])));
+        }
+        for (size_t f = 0; f < filters; f++) {
+            assert(fabs(layer->grad_biases->data[f] - grad_b[f]) < 1e-4 * (1.0 + fabs(grad_b[f])));
+        }
+        for (size_t n = 0; n < batch; n++) {
+            for (size_t i = 0; i < pixels; i++) {
+                double expected = grad_x[n * pixels + i];
+                assert(fabs(layer->grad_input->data[n * layer->grad_input->stride + i] - expected) <
+                       1e-4 * (1.0 + fabs(expected)));
+            }
+        }
+        
+        free(grad_w);
+        free(grad_b);
+        free(grad_x);
+        matrix_free(output_grad);
+        matrix_free(input);
+        layer->free(layer);
+    }
+    
+    printf("Conv2d backward pass: PASSED\n");
+}
+
+// Largest |actual - reference| of a batch of conv outputs relative to the
+// largest reference value, with the bias added and no activation
+static float conv_max_error(const Matrix* input, const Matrix* output, const float* weights,
+                            const float* bias, size_t c_in, size_t filters, size_t h, size_t w,
+                            size_t pad) {
+    size_t out_h = h + 2 * pad - 2, out_w = w + 2 * pad - 2;
+    float error = 0.0f, scale = 1.0f;
+    for (size_t n = 0; n < input->rows; n++) {
+        const float* image = input->data + n * input->stride;
+        for (size_t f = 0; f < filters; f++) {
+            for (size_t oy = 0; oy < out_h; oy++) {
+                for (size_t ox = 0; ox < out_w; ox++) {
+                    float v = conv_reference(image, weights, c_in, h, w, 3, 1, pad, f, oy, ox) +
+                              bias[f];
+                    float actual = output->data[n * output->stride + (f * out_h + oy) * out_w + ox];
+                    if (fabsf(actual - v) > error) error = fabsf(actual - v);
+                    if (fabsf(v) > scale) scale = fabsf(v);
+                }
+            }
+        }
+    }
+    return error / scale;
+}
+
+void test_conv2d_winograd() {
+    printf("Testing Winograd convolution...\n");
+    
+    // {channels, filters, height, width, padding, batch}: output sizes that
+    // are not multiples of the tile, no padding, and a batch split into
+    // several groups
+    size_t cases[4][6] = {
+        {3, 4, 7, 5, 1, 2},
+        {4, 3, 9, 10, 0, 3},
+        {2, 5, 4, 4, 1, 1},
+        {16, 8, 64, 64, 1, 12},
+    };
+    
+    for (size_t t = 0; t < 4; t++) {
+        size_t c_in = cases[t][0], filters = cases[t][1], h = cases[t][2], w = cases[t][3];
+        size_t pad = cases[t][4], batch = cases[t][5];
+        ConvGeometry g = conv_geometry(c_in, h, w, filters, 3, 1, pad);
+        assert(conv_winograd_supported(&g));
+        
+        Matrix* weights = matrix_create(filters, conv_patch_size(&g));
+        Matrix* input = matrix_create(batch, c_in * h * w);
+        Matrix* output = matrix_create(batch, filters * conv_out_positions(&g));
+        float bias[8];
+        matrix_random_uniform(weights, -0.5f, 0.5f);
+        matrix_random_uniform(input, -1.0f, 1.0f);
+        for (size_t f = 0; f < filters; f++) bias[f] = 0.1f * (float)f - 0.2f;
+        
+        // F(4x4) amplifies rounding more than F(2x2)
+        for (size_t m = 2; m <= 4; m += 2) {
+            Matrix* u = matrix_create(conv_winograd_filter_rows(&g, m), c_in);
+            conv_winograd_filters(&g, m, weights, u);
+            matrix_fill(output, NAN);
+            conv_forward_winograd(&g, m, input, u, bias, output, NULL);
+            float error = conv_max_error(input, output, weights->data, bias, c_in, filters, h, w,
+                                         pad);
+            assert(error < (m == 2 ? 1e-5f : 1e-4f));
+            (void)error;
+            matrix_free(u);
+        }
+        
+        matrix_free(weights);
+        matrix_free(input);
+        matrix_free(output);
+    }
+    
+    printf("Winograd convolution: PASSED\n");
+}
+
+void test_conv2d_algorithm_plan() {
+    printf("Testing conv2d algorithm selection...\n");
+    
+    size_t c_in = 4, filters = 6, h = 10, w = 10, batch = 3;
+    Layer* layer = conv2d_layer((int)c_in, (int)filters, 3, 1, 1, ACTIVATION_NONE);
+    Matrix* input = matrix_create(batch, c_in * h * w);
+    Matrix* output_grad = matrix_create(batch, filters * h * w);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    matrix_random_uniform(output_grad, -1.0f, 1.0f);
+    matrix_random_uniform(layer->biases, -0.5f, 0.5f);
+    
+    // Auto picks one of the candidates and computes the same convolution
+    layer->forward(layer, input);
+    ConvAlgorithm chosen = layer->conv_plan->algorithm;
+    assert(chosen == CONV_ALGO_IM2COL || chosen == CONV_ALGO_WINOGRAD_2X2 ||
+           chosen == CONV_ALGO_WINOGRAD_4X4);
+    (void)chosen;
+    assert(conv_max_error(input, layer->output, layer->weights->data, layer->biases->data, c_in,
+                          filters, h, w, 1) < 1e-4f);
+    
+    // Deterministic mode does not depend on timing
+    matrix_set_deterministic(1);
+    conv2d_layer_set_algorithm(layer, CONV_ALGO_AUTO);
+    layer->forward(layer, input);
+    assert(layer->conv_plan->algorithm == CONV_ALGO_IM2COL);
+    matrix_set_deterministic(0);
+    
+    // Inference keeps the transformed filters between batches
+    int rc = conv2d_layer_set_algorithm(layer, CONV_ALGO_WINOGRAD_4X4);
+    assert(rc == 0);
+    layer->is_training = 0;
+    layer->forward(layer, input);
+    Matrix* filters_before = layer->conv_plan->filters;
+    (void)filters_before;
+    assert(layer->conv_plan->filters_valid);
+    layer->forward(layer, input);
+    assert(layer->conv_plan->filters == filters_before && layer->conv_plan->filters_valid);
+    
+    // A training step changes the weights and drops them
+    layer->is_training = 1;
+    layer->forward(layer, input);
+    layer->backward(layer, output_grad);
+    layer->update(layer, 0.1f);
+    assert(!layer->conv_plan->filters_valid);
+    layer->is_training = 0;
+    layer->forward(layer, input);
+    assert(layer->conv_plan->filters_valid);
+    assert(conv_max_error(input, layer->output, layer->weights->data, layer->biases->data, c_in,
+                          filters, h, w, 1) < 1e-4f);
+    
+    // Geometries Winograd cannot handle fall back to im2col
+    Layer* strided = conv2d_layer((int)c_in, (int)filters, 3, 2, 1, ACTIVATION_NONE);
+    conv2d_layer_set_algorithm(strided, CONV_ALGO_WINOGRAD_2X2);
+    strided->forward(strided, input);
+    assert(strided->conv_plan->algorithm == CONV_ALGO_IM2COL);
+    Layer* dense = dense_layer(2, 2, ACTIVATION_NONE);
+    rc = conv2d_layer_set_algorithm(dense, CONV_ALGO_AUTO);
+    assert(rc == -1);
+    (void)rc;
+    dense->free(dense);
+    
+    strided->free(strided);
+    matrix_free(output_grad);
+    matrix_free(input);
+    layer->free(layer);
+    
+    printf("Conv2d algorithm selection: PASSED\n");
+}
+
+void test_conv_layout_convert() {
+    printf("Testing NCHWc layout conversion...\n");
+    
+    // 5 channels leave padding in the last block of both blocked layouts
+    size_t channels = 5, plane = 6, batch = 2;
+    Matrix* nchw = matrix_create(batch, channels * plane);
+    Matrix* c16 = matrix_create(batch, conv_blocked_size(channels, plane, 16));
+    Matrix* c8 = matrix_create(batch, conv_blocked_size(channels, plane, 8));
+    Matrix* back = matrix_create(batch, channels * plane);
+    matrix_random_uniform(nchw, -1.0f, 1.0f);
+    matrix_fill(c8, NAN);
+    
+    conv_layout_convert(channels, CONV_LAYOUT_NCHW, CONV_LAYOUT_NCHW16C, nchw, c16);
+    conv_layout_convert(channels, CONV_LAYOUT_NCHW16C, CONV_LAYOUT_NCHW8C, c16, c8);
+    conv_layout_convert(channels, CONV_LAYOUT_NCHW8C, CONV_LAYOUT_NCHW, c8, back);
+    
+    for (size_t n = 0; n < batch; n++) {
+        for (size_t p = 0; p < plane; p++) {
+            for (size_t c = 0; c < 8; c++) {
+                float expected = c < channels ? nchw->data[n * nchw->stride + c * plane + p] : 0.0f;
+                assert(c8->data[n * c8->stride + p * 8 + c] == expected);
+                assert(c16->data[n * c16->stride + p * 16 + c] == expected);
+            }
+        }
+        for (size_t i = 0; i < channels * plane; i++) {
+            assert(back->data[n * back->stride + i] == nchw->data[n * nchw->stride + i]);
+        }
+    }
+    
+    matrix_free(nchw);
+    matrix_free(c16);
+    matrix_free(c8);
+    matrix_free(back);
+    
+    printf("NCHWc layout conversion: PASSED\n");
+}
+
+void test_conv2d_blocked_layout() {
+    printf("Testing conv2d on NCHWc batches...\n");
+    
+    // {channels, filters, kernel, stride, padding, size, input layout,
+    // output layout}: an NCHW input into a blocked pipeline, channel
+    // counts that leave padding, strides, and a 1x1 kernel
+    size_t cases[5][8] = {
+        {3, 16, 3, 1, 1, 10, CONV_LAYOUT_NCHW, CONV_LAYOUT_NCHW16C},
+        {5, 7, 3, 2, 1, 9, CONV_LAYOUT_NCHW8C, CONV_LAYOUT_NCHW8C},
+        {20, 12, 5, 1, 2, 12, CONV_LAYOUT_NCHW16C, CONV_LAYOUT_NCHW16C},
+        {16, 24, 1, 1, 0, 7, CONV_LAYOUT_NCHW16C, CONV_LAYOUT_NCHW8C},
+        {8, 16, 3, 1, 0, 21, CONV_LAYOUT_NCHW8C, CONV_LAYOUT_NCHW16C},
+    };
+    
+    for (size_t t = 0; t < 5; t++) {
+        size_t c_in = cases[t][0], filters = cases[t][1], k = cases[t][2];
+        size_t stride = cases[t][3], pad = cases[t][4], size = cases[t][5], batch = 3;
+        ConvLayout in_layout = (ConvLayout)cases[t][6], out_layout = (ConvLayout)cases[t][7];
+        size_t in_block = conv_layout_block(in_layout), out_block = conv_layout_block(out_layout);
+        size_t out_size = (size + 2 * pad - k) / stride + 1;
+        size_t positions = out_size * out_size;
+        
+        // The same convolution on NCHW and on blocked batches; sigmoid
+        // moves the padding channels off 0 before they are cleared
+        Layer* plain = conv2d_layer((int)c_in, (int)filters, (int)k, (int)stride, (int)pad,
+                                    ACTIVATION_SIGMOID);
+        Layer* blocked = conv2d_layer((int)c_in, (int)filters, (int)k, (int)stride, (int)pad,
+                                      ACTIVATION_SIGMOID);
+        int rc = conv2d_layer_set_layout(blocked, in_layout, out_layout);
+        assert(rc == 0);
+        (void)rc;
+        matrix_copy(blocked->weights, plain->weights);
+        matrix_random_uniform(plain->biases, -0.5f, 0.5f);
+        matrix_copy(blocked->biases, plain->biases);
+        
+        Matrix* input = matrix_create(batch, c_in * size * size);
+        Matrix* blocked_input = matrix_create(batch, conv_blocked_size(c_in, size * size, in_block));
+        Matrix* output_grad = matrix_create(batch, filters * positions);
+        Matrix* blocked_grad = matrix_create(batch, conv_blocked_size(filters, positions, out_block));
+        Matrix* converted = matrix_create(batch, filters * positions);
+        Matrix* converted_input = matrix_create(batch, c_in * size * size);
+        matrix_random_uniform(input, -1.0f, 1.0f);
+        matrix_random_uniform(output_grad, -1.0f, 1.0f);
+        conv_layout_convert(c_in, CONV_LAYOUT_NCHW, in_layout, input, blocked_input);
+        conv_layout_convert(filters, CONV_LAYOUT_NCHW, out_layout, output_grad, blocked_grad);
+        
+        plain->forward(plain, input);
+        blocked->forward(blocked, blocked_input);
+        assert(blocked->conv_plan->algorithm == CONV_ALGO_DIRECT);
+        assert(blocked->output->cols == conv_blocked_size(filters, positions, out_block));
+        conv_layout_convert(filters, out_layout, CONV_LAYOUT_NCHW, blocked->output, converted);
+        for (size_t n = 0; n < batch; n++) {
+            for (size_t i = 0; i < filters * positions; i++) {
+                float expected = plain->output->data[n * plain->output->stride + i];
+                assert(fabsf(converted->data[n * converted->stride + i] - expected) < 1e-5f);
+            }
+            const float* last = blocked->output->data + n * blocked->output->stride +
+                                filters / out_block * positions * out_block;
+            for (size_t p = 0; p < positions && filters % out_block; p++) {
+                for (size_t o = filters % out_block; o < out_block; o++) {
+                    assert(last[p * out_block + o] == 0.0f);
+                }
+            }
+        }
+        
+        // Backward goes through NCHW and lands in the input layout
+        plain->backward(plain, output_grad);
+        blocked->backward(blocked, blocked_grad);
+        for (size_t i = 0; i < filters * c_in * k * k; i++) {
+            float expected = plain->grad_weights->data[i];
+            assert(fabsf(blocked->grad_weights->data[i] - expected) < 1e-4f * (1.0f + fabsf(expected)));
+        }
+        for (size_t f = 0; f < filters; f++) {
+            float expected = plain->grad_biases->data[f];
+            assert(fabsf(blocked->grad_biases->data[f] - expected) < 1e-4f * (1.0f + fabsf(expected)));
+        }
+        assert(blocked->grad_input->cols == blocked_input->cols);
+        conv_layout_convert(c_in, in_layout, CONV_LAYOUT_NCHW, blocked->grad_input, converted_input);
+        for (size_t n = 0; n < batch; n++) {
+            for (size_t i = 0; i < c_in * size * size; i++) {
+                float expected = plain->grad_input->data[n * plain->grad_input->stride + i];
+                assert(fabsf(converted_input->data[n * converted_input->stride + i] - expected) <
+                       1e-4f * (1.0f + fabsf(expected)));
+            }
+        }
+        
+        matrix_free(input);
+        matrix_free(blocked_input);
+        matrix_free(output_grad);
+        matrix_free(blocked_grad);
+        matrix_free(converted);
+        matrix_free(converted_input);
+        plain->free(plain);
+        blocked->free(blocked);
+    }
+    
+    // A blocked input cannot produce NCHW output
+    Layer* conv = conv2d_layer(4, 4, 3, 1, 1, ACTIVATION_NONE);
+    int rc = conv2d_layer_set_layout(conv, CONV_LAYOUT_NCHW8C, CONV_LAYOUT_NCHW);
+    assert(rc == -1);
+    (void)rc;
+    conv->free(conv);
+    
+    printf("Conv2d on NCHWc batches: PASSED\n");
+}
+
+void test_network_blocked_pipeline() {
+    printf("Testing blocked conv pipeline with layout layers...\n");
+    
+    // conv -> conv -> dense, once on NCHW batches and once blocked with a
+    // layout layer in front of the dense layer
+    ConvLayout layout = conv_layout_native();
+    Network* plain = network_create();
+    Network* blocked = network_create();
+    Layer* plain_layers[3] = {conv2d_layer(2, 8, 3, 1, 1, ACTIVATION_RELU),
+                              conv2d_layer(8, 12, 3, 2, 1, ACTIVATION_RELU),
+                              dense_layer(12 * 4 * 4, 3, ACTIVATION_SIGMOID)};
+    Layer* blocked_layers[3] = {conv2d_layer(2, 8, 3, 1, 1, ACTIVATION_RELU),
+                                conv2d_layer(8, 12, 3, 2, 1, ACTIVATION_RELU),
+                                dense_layer(12 * 4 * 4, 3, ACTIVATION_SIGMOID)};
+    conv2d_layer_set_layout(blocked_layers[0], CONV_LAYOUT_NCHW, layout);
+    conv2d_layer_set_layout(blocked_layers[1], layout, layout);
+    for (int i = 0; i < 3; i++) {
+        matrix_copy(blocked_layers[i]->weights, plain_layers[i]->weights);
+        matrix_copy(blocked_layers[i]->biases, plain_layers[i]->biases);
+        network_add_layer(plain, plain_layers[i]);
+        if (i == 2) network_add_layer(blocked, layout_layer(12, layout, CONV_LAYOUT_NCHW));
+        network_add_layer(blocked, blocked_layers[i]);
+    }
+    network_compile(plain, sgd_optimizer(0.01f, 0.0f), 0.0f);
+    network_compile(blocked, sgd_optimizer(0.01f, 0.0f), 0.0f);
+    
+    Matrix* input = matrix_create(4, 2 * 8 * 8);
+    Matrix* target = matrix_create(4, 3);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    matrix_random_uniform(target, 0.1f, 0.9f);
+    
+    // The gradient flows back through the layout layer, so both networks
+    // take the same training steps
+    for (int step = 0; step < 3; step++) {
+        float a = network_train(plain, input, target);
+        float b = network_train(blocked, input, target);
+        assert(fabsf(a - b) < 1e-4f * (1.0f + fabsf(a)));
+    }
+    
+    network_set_training(plain, 0);
+    network_set_training(blocked, 0);
+    Matrix* a = network_forward(plain, input);
+    Matrix* b = network_forward(blocked, input);
+    for (size_t n = 0; n < a->rows; n++) {
+        for (size_t j = 0; j < a->cols; j++) {
+            float expected = a->data[n * a->stride + j];
+            assert(fabsf(b->data[n * b->stride + j] - expected) < 1e-4f * (1.0f + fabsf(expected)));
+        }
+    }
+    
+    matrix_free(a);
+    matrix_free(b);
+    matrix_free(input);
+    matrix_free(target);
+    network_free(plain);
+    network_free(blocked);
+    
+    printf("Blocked conv pipeline with layout layers: PASSED\n");
+}
+
 void test_activation_functions() {
     printf("Testing activation functions...\n");
     
@@ -143,6 +899,109 @@ void test_activation_functions() {
     matrix_free(m);
 }
 
+void test_activation_precision() {
+    printf("Testing activation precision tiers...\n");
+    
+    VecMathPrecision saved = activation_get_precision();
+    ActivationType types[] = {ACTIVATION_SIGMOID, ACTIVATION_TANH, ACTIVATION_ELU,
+                              ACTIVATION_SELU, ACTIVATION_SWISH, ACTIVATION_MISH,
+                              ACTIVATION_GELU, ACTIVATION_SOFTMAX};
+    Matrix* z = matrix_create(7, 61);
+    for (size_t i = 0; i < 7 * 61; i++) {
+        z->data[i] = -12.0f + 24.0f * (float)((i * 37) % (7 * 61)) / (7 * 61);
+    }
+    
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        Matrix* out[3];
+        Matrix* grad[3];
+        for (int p = VEC_MATH_PRECISE; p <= VEC_MATH_FAST; p++) {
+            activation_set_precision((VecMathPrecision)p);
+            assert(activation_get_precision() == (VecMathPrecision)p);
+            out[p] = matrix_create(7, 61);
+            matrix_copy(out[p], z);
+            activate(out[p], types[t]);
+            grad[p] = matrix_create(7, 61);
+            matrix_fill(grad[p], 1.0f);
+            activate_derivative(z, grad[p], types[t]);
+        }
+        
+        // Accurate within a few ulp of libm, fast within ~1e-3
+        for (size_t i = 0; i < 7 * 61; i++) {
+            float ref = out[VEC_MATH_PRECISE]->data[i];
+            float dref = grad[VEC_MATH_PRECISE]->data[i];
+            assert(fabsf(out[VEC_MATH_ACCURATE]->data[i] - ref) <= 1e-5f * fabsf(ref) + 1e-6f);
+            assert(fabsf(out[VEC_MATH_FAST]->data[i] - ref) <= 2e-3f * fabsf(ref) + 1e-5f);
+            assert(fabsf(grad[VEC_MATH_ACCURATE]->data[i] - dref) <= 1e-5f * fabsf(dref) + 1e-6f);
+            assert(fabsf(grad[VEC_MATH_FAST]->data[i] - dref) <= 2e-3f * fabsf(dref) + 1e-5f);
+        }
+        
+        for (int p = 0; p < 3; p++) {
+            matrix_free(out[p]);
+            matrix_free(grad[p]);
+        }
+    }
+    
+    activation_set_precision(saved);
+    printf("Activation precision tiers: PASSED\n");
+    
+    // Cleanup
+    matrix_free(z);
+}
+
+void test_softmax_cross_entropy() {
+    printf("Testing fused softmax cross-entropy...\n");
+    
+    // 37 classes leave a partial set of online-softmax lanes
+    const size_t rows = 5, classes = 37;
+    Matrix* logits = matrix_create(rows, classes);
+    matrix_random_uniform(logits, -4.0f, 4.0f);
+    int labels[5] = {0, 36, 7, 18, 7};
+    Matrix* target = matrix_create(rows, classes);
+    matrix_fill(target, 0.0f);
+    for (size_t i = 0; i < rows; i++) {
+        target->data[i * target->stride + labels[i]] = 1.0f;
+    }
+    
+    // Reference: softmax, then the loss on probabilities and p - y
+    Matrix* probs = matrix_create(rows, classes);
+    matrix_copy(probs, logits);
+    activate(probs, ACTIVATION_SOFTMAX);
+    float expected = cross_entropy_loss(probs, target);
+    
+    Matrix* grad = matrix_create(rows, classes);
+    Matrix* grad_labels = matrix_create(rows, classes);
+    float loss = softmax_cross_entropy(logits, target, grad);
+    float loss_labels = softmax_cross_entropy_labels(logits, labels, grad_labels);
+    assert(fabsf(loss - expected) < 1e-4f);
+    assert(fabsf(loss_labels - expected) < 1e-4f);
+    assert(fabsf(softmax_cross_entropy_labels(logits, labels, NULL) - loss_labels) < 1e-6f);
+    
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < classes; j++) {
+            float g = probs->data[i * probs->stride + j] - target->data[i * target->stride + j];
+            assert(fabsf(grad->data[i * grad->stride + j] - g) < 1e-5f);
+            assert(fabsf(grad_labels->data[i * grad_labels->stride + j] - g) < 1e-5f);
+        }
+    }
+    
+    // Logits far beyond the range of exp: log-sum-exp stays finite (to the
+    // float spacing at 1000)
+    matrix_fill(logits, 1000.0f);
+    logits->data[3] = 1010.0f;
+    loss = softmax_cross_entropy_labels(logits, labels, grad_labels);
+    assert(isfinite(loss) && loss > 0.0f);
+    assert(fabsf(grad_labels->data[3] - expf(10.0f) / (expf(10.0f) + 36.0f)) < 1e-3f);
+    
+    printf("Fused softmax cross-entropy: PASSED\n");
+    
+    // Cleanup
+    matrix_free(grad_labels);
+    matrix_free(grad);
+    matrix_free(probs);
+    matrix_free(target);
+    matrix_free(logits);
+}
+
 void test_dropout_layer() {
     printf("Testing dropout layer...\n");
     
@@ -190,14 +1049,465 @@ void test_dropout_layer() {
     layer->free(layer);
 }
 
+void test_dropout_seeded_masks() {
+    printf("Testing seeded dropout masks...\n");
+    
+    Network* net = network_create();
+    network_add_layer(net, dropout_layer(0.5f));
+    Layer* layer = net->input_layer;
+    
+    Matrix* input = matrix_create(64, 300);
+    matrix_fill(input, 1.0f);
+    
+    network_set_seed(net, 1234);
+    layer->forward(layer, input);
+    Matrix* first = matrix_create(input->rows, input->cols);
+    matrix_copy(first, layer->mask);
+    
+    // The stream moves on: the next mask differs
+    layer->forward(layer, input);
+    assert(memcmp(first->data, layer->mask->data, first->rows * first->stride * sizeof(float)) != 0);
+    
+    // Reseeding repeats the first mask
+    network_set_seed(net, 1234);
+    layer->forward(layer, input);
+    assert(memcmp(first->data, layer->mask->data, first->rows * first->stride * sizeof(float)) == 0);
+    
+    // Roughly half the units are dropped
+    size_t zeros = 0;
+    for (size_t i = 0; i < first->rows * first->cols; i++) {
+        if (first->data[i] == 0.0f) zeros++;
+    }
+    float dropped = (float)zeros / (first->rows * first->cols);
+    assert(dropped > 0.45f && dropped < 0.55f);
+    
+    printf("Seeded dropout masks: PASSED\n");
+    
+    // Cleanup
+    matrix_free(first);
+    matrix_free(input);
+    network_free(net);
+}
+
+void test_attention_heads() {
+    printf("Testing multi-head attention...\n");
+    
+    size_t seq = 6, embed = 12;
+    Matrix* input = matrix_create(seq, embed);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    
+    int head_counts[2] = {1, 3};
+    for (int t = 0; t < 2; t++) {
+        size_t heads = (size_t)head_counts[t];
+        size_t d = embed / heads;
+        Layer* layer = attention_layer((int)embed, (int)heads);
+        layer->forward(layer, input);
+        assert(layer->output->rows == seq && layer->output->cols == embed);
+        
+        // Every head is softmax(x_h x_h^T / sqrt(d)) x_h on its own columns
+        for (size_t h = 0; h < heads; h++) {
+            for (size_t i = 0; i < seq; i++) {
+                double weights[6];
+                double max = -1e30, total = 0.0;
+                for (size_t j = 0; j < seq; j++) {
+                    double dot = 0.0;
+                    for (size_t p = 0; p < d; p++) {
+                        dot += (double)input->data[i * input->stride + h * d + p] *
+                               input->data[j * input->stride + h * d + p];
+                    }
+                    weights[j] = dot / sqrt((double)d);
+                    if (weights[j] > max) max = weights[j];
+                }
+                for (size_t j = 0; j < seq; j++) {
+                    weights[j] = exp(weights[j] - max);
+                    total += weights[j];
+                }
+                for (size_t p = 0; p < d; p++) {
+                    double expected = 0.0;
+                    for (size_t j = 0; j < seq; j++) {
+                        expected += weights[j] / total * input->data[j * input->stride + h * d + p];
+                    }
+                    float actual = layer->output->data[i * layer->output->stride + h * d + p];
+                    assert(fabs(actual - expected) < 1e-5);
+                }
+            }
+        }
+        layer->free(layer);
+    }
+    
+    printf("Multi-head attention: PASSED\n");
+    
+    // Cleanup
+    matrix_free(input);
+}
+
+void test_network_quantize() {
+    printf("Testing int8 quantized inference...\n");
+    
+    Network* net = network_create();
+    network_add_layer(net, dense_layer(64, 128, ACTIVATION_RELU));
+    network_add_layer(net, dropout_layer(0.2f));
+    network_add_layer(net, dense_layer(128, 10, ACTIVATION_SOFTMAX));
+    
+    Matrix* input = matrix_create(32, 64);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    
+    // Float reference with dropout off
+    net->input_layer->next->is_training = 0;
+    Matrix* expected = network_forward(net, input);
+    net->input_layer->next->is_training = 1;
+    
+    int quantized = network_quantize(net, input);
+    assert(quantized == 2);
+    assert(net->input_layer->quantized != NULL);
+    assert(net->input_layer->input_scale > 0.0f);
+    assert(net->input_layer->next->is_training == 1);  // Restored after calibration
+    
+    net->input_layer->next->is_training = 0;
+    Matrix* actual = network_forward(net, input);
+    assert(matrix_equal(expected, actual, 0.02f));
+    matrix_free(actual);
+    
+    // Per-batch scaling without calibration
+    quantized = network_quantize(net, NULL);
+    assert(quantized == 2);
+    (void)quantized;
+    assert(net->input_layer->input_scale == 0.0f);
+    actual = network_forward(net, input);
+    assert(matrix_equal(expected, actual, 0.02f));
+    matrix_free(actual);
+    
+    // Back to float: bit-identical to the reference again
+    network_dequantize(net);
+    assert(net->input_layer->quantized == NULL);
+    actual = network_forward(net, input);
+    assert(matrix_equal(expected, actual, 0.0f));
+    
+    printf("int8 quantized inference: PASSED\n");
+    
+    // Cleanup
+    matrix_free(actual);
+    matrix_free(expected);
+    matrix_free(input);
+    network_free(net);
+}
+
+void test_network_quantize_labels() {
+    printf("Testing label loss on int8 and sparse output layers...\n");
+    
+    // Sharp logits, labelled with the predicted class: the loss is small
+    // when taken from logits and near log(5) if probabilities slip through
+    random_seed(11);
+    Network* net = network_create();
+    network_add_layer(net, dense_layer(16, 32, ACTIVATION_RELU));
+    network_add_layer(net, dense_layer(32, 5, ACTIVATION_SOFTMAX));
+    matrix_scale(net->output_layer->weights, 8.0f);
+    
+    Matrix* input = matrix_create(24, 16);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    Matrix* output = network_forward(net, input);
+    int labels[24];
+    for (size_t i = 0; i < output->rows; i++) {
+        const float* row = output->data + i * output->stride;
+        labels[i] = 0;
+        for (int j = 1; j < 5; j++) {
+            if (row[j] > row[labels[i]]) labels[i] = j;
+        }
+    }
+    float expected = network_test_labels(net, input, labels);
+    assert(expected < 0.5f);
+    
+    int quantized = network_quantize(net, input);
+    assert(quantized == 2);
+    (void)quantized;
+    float loss = network_test_labels(net, input, labels);
+    assert(fabsf(loss - expected) < 0.05f);
+    network_dequantize(net);
+    
+    int rc = dense_layer_sparsify(net->output_layer, 0.0f, 1, 1);
+    assert(rc == 0);
+    (void)rc;
+    loss = network_test_labels(net, input, labels);
+    assert(fabsf(loss - expected) < 1e-4f);
+    
+    printf("Label loss on int8 and sparse output layers: PASSED\n");
+    
+    // Cleanup
+    matrix_free(output);
+    matrix_free(input);
+    network_free(net);
+}
+
+void test_dense_layer_sparse() {
+    printf("Testing sparse dense layer...\n");
+    
+    Layer* layer = dense_layer(50, 30, ACTIVATION_RELU);
+    Matrix* input = matrix_create(6, 50);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    
+    layer->forward(layer, input);
+    Matrix* expected = matrix_create(6, 30);
+    matrix_copy(expected, layer->output);
+    
+    // Nothing pruned: same result as the dense weights, in both formats
+    int rc = dense_layer_sparsify(layer, 0.0f, 1, 1);
+    assert(rc == 0);
+    (void)rc;
+    assert(layer->sparse_weights->format == SPARSE_CSR);
+    layer->forward(layer, input);
+    assert(matrix_equal(expected, layer->output, 1e-5f));
+    
+    rc = dense_layer_sparsify(layer, 0.0f, 4, 4);
+    assert(rc == 0);
+    assert(layer->sparse_weights->format == SPARSE_BSR);
+    layer->forward(layer, input);
+    assert(matrix_equal(expected, layer->output, 1e-5f));
+    
+    // Pruned: matches a dense layer holding the pruned weights
+    rc = dense_layer_sparsify(layer, 0.2f, 1, 1);
+    assert(rc == 0);
+    assert(sparse_density(layer->sparse_weights) < 0.9f);
+    Layer* reference = dense_layer(50, 30, ACTIVATION_RELU);
+    Matrix* pruned = matrix_create(30, 50);
+    sparse_to_dense(layer->sparse_weights, pruned);
+    matrix_transpose(pruned, reference->weights);
+    matrix_copy(reference->biases, layer->biases);
+    reference->forward(reference, input);
+    layer->forward(layer, input);
+    assert(matrix_equal(reference->output, layer->output, 1e-5f));
+    
+    // int8 and sparse inference replace each other
+    rc = dense_layer_quantize(layer, 0.0f);
+    assert(rc == 0);
+    assert(layer->sparse_weights == NULL);
+    rc = dense_layer_sparsify(layer, 0.2f, 1, 1);
+    assert(rc == 0);
+    assert(layer->quantized == NULL);
+    
+    dense_layer_densify(layer);
+    assert(layer->sparse_weights == NULL);
+    layer->forward(layer, input);
+    assert(matrix_equal(expected, layer->output, 0.0f));
+    
+    Layer* dropout = dropout_layer(0.5f);
+    rc = dense_layer_sparsify(dropout, 0.1f, 1, 1);
+    assert(rc == -1);
+    
+    printf("Sparse dense layer: PASSED\n");
+    
+    // Cleanup
+    matrix_free(pruned);
+    matrix_free(expected);
+    matrix_free(input);
+    layer->free(layer);
+    reference->free(reference);
+    dropout->free(dropout);
+}
+
+void test_network_workspace_steady_state() {
+    printf("Testing network workspace reuse...\n");
+    
+    Network* net = network_create();
+    network_add_layer(net, dense_layer(8, 16, ACTIVATION_RELU));
+    network_add_layer(net, dropout_layer(0.1f));
+    network_add_layer(net, dense_layer(16, 4, ACTIVATION_SOFTMAX));
+    network_compile(net, adam_optimizer(0.01f, 0.9f, 0.999f, 1e-8f), 0.0f);
+    
+    Matrix* input = matrix_create(32, 8);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    Matrix* target = matrix_create(32, 4);
+    for (size_t i = 0; i < target->rows; i++) {
+        target->data[i * target->stride + i % 4] = 1.0f;
+    }
+    
+    // Warm up, then the arena must serve every later step on its own
+    network_train(net, input, target);
+    network_train(net, input, target);
+    size_t allocs = net->workspace->heap_allocs;
+    Matrix* first_input_buffer = net->input_layer->input;
+    
+    float first_loss = network_train(net, input, target);
+    float loss = first_loss;
+    for (int step = 0; step < 20; step++) {
+        loss = network_train(net, input, target);
+    }
+    assert(net->workspace->heap_allocs == allocs);
+    assert(net->input_layer->input == first_input_buffer);
+    assert(loss < first_loss);
+    
+    printf("Network workspace reuse: PASSED\n");
+    
+    // Cleanup
+    matrix_free(input);
+    matrix_free(target);
+    network_free(net);
+}
+
+void test_network_train_labels() {
+    printf("Testing training with class labels...\n");
+    
+    // The same network trained on labels and on one-hot targets must follow
+    // the same loss curve
+    Network* nets[2];
+    for (int n = 0; n < 2; n++) {
+        random_seed(7);
+        nets[n] = network_create();
+        network_add_layer(nets[n], dense_layer(6, 12, ACTIVATION_TANH));
+        network_add_layer(nets[n], dense_layer(12, 5, ACTIVATION_SOFTMAX));
+        network_compile(nets[n], adam_optimizer(0.01f, 0.9f, 0.999f, 1e-8f), 0.0f);
+    }
+    
+    Matrix* input = matrix_create(20, 6);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    int labels[20];
+    Matrix* target = matrix_create(20, 5);
+    matrix_fill(target, 0.0f);
+    for (size_t i = 0; i < 20; i++) {
+        labels[i] = (int)(i % 5);
+        target->data[i * target->stride + labels[i]] = 1.0f;
+    }
+    
+    float first = 0.0f, loss = 0.0f;
+    for (int step = 0; step < 30; step++) {
+        loss = network_train_labels(nets[0], input, labels);
+        float loss_onehot = network_train(nets[1], input, target);
+        assert(fabsf(loss - loss_onehot) < 1e-4f * (1.0f + loss));
+        if (step == 0) first = loss;
+    }
+    assert(loss < first);
+    
+    // Inference still ends in probabilities, and the test loss matches them
+    Matrix* output = network_forward(nets[0], input);
+    for (size_t i = 0; i < output->rows; i++) {
+        float sum = 0.0f;
+        for (size_t j = 0; j < output->cols; j++) sum += output->data[i * output->stride + j];
+        assert(fabsf(sum - 1.0f) < 1e-4f);
+    }
+    float test_loss = network_test_labels(nets[0], input, labels);
+    assert(fabsf(test_loss - cross_entropy_loss(output, target)) < 1e-4f);
+    
+    printf("Training with class labels: PASSED\n");
+    
+    // Cleanup
+    matrix_free(output);
+    matrix_free(target);
+    matrix_free(input);
+    network_free(nets[0]);
+    network_free(nets[1]);
+}
+
+void test_network_alloc_policy() {
+    printf("Testing network allocation policy...\n");
+    
+    // 1024 x 1024 weights are past MATRIX_LARGE_ALLOC_BYTES, so they move
+    Network* net = network_create();
+    network_add_layer(net, dense_layer(1024, 1024, ACTIVATION_RELU));
+    network_add_layer(net, dense_layer(1024, 10, ACTIVATION_SOFTMAX));
+    
+    Matrix* input = matrix_create(8, 1024);
+    matrix_random_uniform(input, -1.0f, 1.0f);
+    Matrix* expected = network_forward(net, input);
+    
+    MatrixAllocPolicy policy = {MATRIX_PAGES_HUGE, MATRIX_NUMA_FIRST_TOUCH};
+    int rc = network_set_alloc_policy(net, policy);
+    (void)rc;
+#ifdef __linux__
+    assert(rc == 0);
+    assert(net->has_alloc_policy);
+    
+    // The global policy is only in force while the network runs
+    assert(matrix_get_alloc_policy().pages == MATRIX_PAGES_DEFAULT);
+    
+    Matrix* actual = network_forward(net, input);
+    assert(matrix_equal(expected, actual, 0.0f));
+    assert(matrix_get_alloc_policy().pages == MATRIX_PAGES_DEFAULT);
+    matrix_free(actual);
+#else
+    assert(rc == -1);
+#endif
+    
+    printf("Network allocation policy: PASSED\n");
+    
+    // Cleanup
+    matrix_free(expected);
+    matrix_free(input);
+    network_free(net);
+}
+
+void test_network_inference_mode() {
+    printf("Testing inference mode...\n");
+    
+    Network* net = network_create();
+    network_add_layer(net, dense_layer(6, 16, ACTIVATION_RELU));
+    network_add_layer(net, dropout_layer(0.5f));
+    network_add_layer(net, dense_layer(16, 3, ACTIVATION_SIGMOID));
+    assert(net->is_training && net->input_layer->is_training);
+    
+    // The batch stays in the caller's buffer
+    float batch[4 * 6];
+    for (int i = 0; i < 4 * 6; i++) batch[i] = 0.1f * (i % 7) - 0.3f;
+    Matrix* input = matrix_wrap(batch, 4, 6, 6);
+    
+    // Inference: no dropout, and no input or pre-activation copies
+    network_set_training(net, 0);
+    assert(!net->input_layer->next->is_training);
+    Matrix* first = network_forward(net, input);
+    Matrix* second = network_forward(net, input);
+    assert(matrix_equal(first, second, 0.0f));
+    assert(net->input_layer->input == NULL);
+    assert(net->input_layer->pre_activation == NULL);
+    assert(net->output_layer->input == NULL);
+    
+    // Training keeps them for the backward pass
+    network_set_training(net, 1);
+    Matrix* target = matrix_create(4, 3);
+    matrix_fill(target, 0.5f);
+    network_compile(net, sgd_optimizer(0.1f, 0.0f), 0.0f);
+    network_train(net, input, target);
+    assert(net->input_layer->input != NULL);
+    assert(matrix_equal(net->input_layer->input, input, 0.0f));
+    
+    printf("Inference mode: PASSED\n");
+    
+    // Cleanup
+    matrix_free(first);
+    matrix_free(second);
+    matrix_free(input);
+    matrix_free(target);
+    network_free(net);
+}
+
 int main() {
     printf("Running layer tests...\n\n");
     
     test_dense_layer_forward();
     test_dense_layer_backward();
+    test_dense_layer_input_gradient();
+    test_dense_layer_fused_forward();
+    test_dense_layer_backward_state();
     test_dense_layer_update();
+    test_dense_layer_padded_storage();
+    test_dense_layer_bf16_weights();
+    test_network_quantize();
+    test_network_quantize_labels();
+    test_dense_layer_sparse();
+    test_conv2d_forward();
+    test_conv2d_backward();
+    test_conv2d_winograd();
+    test_conv2d_algorithm_plan();
+    test_conv_layout_convert();
+    test_conv2d_blocked_layout();
     test_activation_functions();
+    test_activation_precision();
+    test_softmax_cross_entropy();
     test_dropout_layer();
+    test_dropout_seeded_masks();
+    test_attention_heads();
+    test_network_workspace_steady_state();
+    test_network_train_labels();
+    test_network_blocked_pipeline();
+    test_network_alloc_policy();
+    test_network_inference_mode();
     
     printf("\nAll layer tests PASSED!\n");
     return 0;
@@ -162,13 +162,9 @@ void test_adam_optimizer() {
     matrix_free(original_param);
     matrix_free(param);
     matrix_free(grad);
-    matrix_free(optimizer->m[0]);
-    matrix_free(optimizer->v[0]);
     free(optimizer->params);
     free(optimizer->grads);
-    free(optimizer->m);
-    free(optimizer->v);
-    optimizer->free(optimizer);
+    optimizer->free(optimizer);  // Also frees m and v
 }
 
 void test_adam_optimizer_multiple_steps() {
@@ -225,13 +221,9 @@ void test_adam_optimizer_multiple_steps() {
     matrix_free(original_param);
     matrix_free(param);
     matrix_free(grad);
-    matrix_free(optimizer->m[0]);
-    matrix_free(optimizer->v[0]);
     free(optimizer->params);
     free(optimizer->grads);
-    free(optimizer->m);
-    free(optimizer->v);
-    optimizer->free(optimizer);
+    optimizer->free(optimizer);  // Also frees m and v
 }
 
 void test_optimizer_with_multiple_parameters() {
@@ -313,15 +305,53 @@ void test_optimizer_with_multiple_parameters() {
     matrix_free(param2);
     matrix_free(grad1);
     matrix_free(grad2);
-    matrix_free(optimizer->m[0]);
-    matrix_free(optimizer->m[1]);
-    matrix_free(optimizer->v[0]);
-    matrix_free(optimizer->v[1]);
     free(optimizer->params);
     free(optimizer->grads);
-    free(optimizer->m);
-    free(optimizer->v);
-    optimizer->free(optimizer);
+    optimizer->free(optimizer);  // Also frees m and v
+}
+
+void test_rmsprop_optimizer() {
+    printf("Testing RMSProp optimizer...\n");
+    
+    float lr = 0.01f, decay = 0.9f, eps = 1e-8f;
+    Optimizer* optimizer = rmsprop_optimizer(lr, decay, eps);
+    
+    // Mixed-sign gradients: each parameter must move against its gradient
+    Matrix* param = matrix_create(2, 2);
+    matrix_fill(param, 1.0f);
+    Matrix* grad = matrix_create(2, 2);
+    float grad_data[] = {0.1f, -0.2f, 0.5f, -1.0f};
+    matrix_from_array(grad, grad_data);
+    
+    optimizer->params = (Matrix**)malloc(sizeof(Matrix*));
+    optimizer->grads = (Matrix**)malloc(sizeof(Matrix*));
+    optimizer->v = (Matrix**)malloc(sizeof(Matrix*));
+    optimizer->params[0] = param;
+    optimizer->grads[0] = grad;
+    optimizer->v[0] = matrix_create(2, 2);
+    optimizer->param_count = 1;
+    
+    optimizer->update(optimizer);
+    
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            float g = grad_data[i * 2 + j];
+            float cache = (1.0f - decay) * g * g;
+            float expected = 1.0f - lr * g / (sqrtf(cache) + eps);
+            assert(fabsf(param->data[i * param->stride + j] - expected) < 1e-5f);
+            assert(fabsf(optimizer->v[0]->data[i * optimizer->v[0]->stride + j] - cache) < 1e-7f);
+        }
+    }
+    assert(fabs(matrix_sum(grad)) < 1e-6);
+    
+    printf("RMSProp optimizer: PASSED\n");
+    
+    // Cleanup
+    matrix_free(param);
+    matrix_free(grad);
+    free(optimizer->params);
+    free(optimizer->grads);
+    optimizer->free(optimizer);  // Also frees v
 }
 
 int main() {
@@ -332,6 +362,7 @@ int main() {
     test_adam_optimizer();
     test_adam_optimizer_multiple_steps();
     test_optimizer_with_multiple_parameters();
+    test_rmsprop_optimizer();
     
     printf("\nAll optimizer tests PASSED!\n");
     return 0;
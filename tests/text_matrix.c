@@ -3,7 +3,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include "../src/matrix.h"
+#include "../src/workspace.h"
+#include "../src/random.h"
+#include "../src/vecops.h"
+#include "../src/quantize.h"
+#include "../src/sparse.h"
+#include "../src/cpu.h"
+#include "../src/activations/activation.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 void test_matrix_operations() {
     printf("Testing basic matrix operations...\n");
@@ -93,6 +105,232 @@ void test_matrix_multiplication() {
     matrix_free(c);
 }
 
+void test_matrix_multiplication_blocked() {
+    printf("Testing blocked matrix multiplication...\n");
+    
+    // Sizes that are not multiples of the micro-kernel tile and span
+    // several cache blocks along every dimension
+    size_t m = 131, k = 517, n = 77;
+    Matrix* parent = matrix_create(m + 3, k + 5);
+    matrix_random_uniform(parent, -1.0f, 1.0f);
+    Matrix* a = matrix_view(parent, 2, 3, m, k);  // strided operand
+    Matrix* b = matrix_create(k, n);
+    Matrix* c = matrix_create(m, n);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    
+    matrix_multiply(a, b, c);
+    
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double expected = 0.0;
+            for (size_t p = 0; p < k; p++) {
+                expected += (double)a->data[i * a->stride + p] * b->data[p * b->stride + j];
+            }
+            assert(fabs(c->data[i * c->stride + j] - expected) < 1e-3);
+        }
+    }
+    
+    printf("Blocked matrix multiplication: PASSED\n");
+    
+    // Cleanup
+    matrix_free(a);
+    matrix_free(parent);
+    matrix_free(b);
+    matrix_free(c);
+}
+
+void test_matrix_gemm_transposed() {
+    printf("Testing transposed GEMM...\n");
+    
+    // c = 0.5 * a^T * b^T + 2 * c, with a stored as k x m and b as n x k
+    size_t m = 45, n = 61, k = 83;
+    Matrix* a = matrix_create(k, m);
+    Matrix* b = matrix_create(n, k);
+    Matrix* c = matrix_create(m, n);
+    Matrix* c0 = matrix_create(m, n);
+    matrix_random_uniform(a, -1.0f, 1.0f);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    matrix_random_uniform(c, -1.0f, 1.0f);
+    matrix_copy(c0, c);
+    
+    matrix_gemm(MATRIX_TRANS, MATRIX_TRANS, 0.5f, a, b, 2.0f, c);
+    
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double expected = 0.0;
+            for (size_t p = 0; p < k; p++) {
+                expected += (double)a->data[p * a->stride + i] * b->data[j * b->stride + p];
+            }
+            expected = 0.5 * expected + 2.0 * c0->data[i * c0->stride + j];
+            assert(fabs(c->data[i * c->stride + j] - expected) < 1e-4);
+        }
+    }
+    
+    printf("Transposed GEMM: PASSED\n");
+    
+    // Cleanup
+    matrix_free(a);
+    matrix_free(b);
+    matrix_free(c);
+    matrix_free(c0);
+}
+
+void test_matrix_transpose() {
+    printf("Testing matrix transpose...\n");
+    
+    // Ragged shapes cover the partial tiles; the view has a wider stride
+    size_t shapes[3][2] = {{37, 53}, {64, 96}, {5, 3}};
+    for (int s = 0; s < 3; s++) {
+        size_t rows = shapes[s][0], cols = shapes[s][1];
+        Matrix* parent = matrix_create(rows + 2, cols + 9);
+        matrix_random_uniform(parent, -1.0f, 1.0f);
+        Matrix* src = matrix_view(parent, 1, 4, rows, cols);
+        Matrix* dst = matrix_create(cols, rows);
+        
+        matrix_transpose(src, dst);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                assert(dst->data[j * dst->stride + i] == src->data[i * src->stride + j]);
+            }
+        }
+        
+        matrix_free(src);
+        matrix_free(parent);
+        matrix_free(dst);
+    }
+    
+    // In place, including sizes that are not a multiple of the 8 x 8 blocks
+    size_t sizes[4] = {1, 8, 67, 130};
+    for (int s = 0; s < 4; s++) {
+        size_t n = sizes[s];
+        Matrix* m = matrix_create(n, n);
+        Matrix* original = matrix_create(n, n);
+        matrix_random_uniform(m, -1.0f, 1.0f);
+        matrix_copy(original, m);
+        
+        matrix_transpose_inplace(m);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                assert(m->data[j * m->stride + i] == original->data[i * original->stride + j]);
+            }
+        }
+        
+        matrix_free(m);
+        matrix_free(original);
+    }
+    
+    printf("Matrix transpose: PASSED\n");
+}
+
+void test_matrix_gemm_batched() {
+    printf("Testing batched GEMM...\n");
+    
+    // Heads side by side: product h reads columns h * d .. (h + 1) * d of x
+    // and writes rows h * seq .. (h + 1) * seq of the stacked result. Small
+    // shapes take the unpacked path, larger ones the packed one.
+    size_t shapes[2][2] = {{7, 4}, {70, 48}};  // {seq, d}
+    size_t heads = 5;
+    for (int s = 0; s < 2; s++) {
+        size_t seq = shapes[s][0], d = shapes[s][1];
+        Matrix* x = matrix_create(seq, heads * d);
+        Matrix* stacked = matrix_create(heads * seq, seq);
+        Matrix* expected = matrix_create(seq, seq);
+        matrix_random_uniform(x, -1.0f, 1.0f);
+        matrix_fill(stacked, 1.0f);
+        
+        Matrix* x0 = matrix_view(x, 0, 0, seq, d);
+        Matrix* c0 = matrix_view(stacked, 0, 0, seq, seq);
+        matrix_gemm_batched(MATRIX_NO_TRANS, MATRIX_TRANS, 0.5f, x0, d, x0, d,
+                            2.0f, c0, seq * stacked->stride, heads);
+        
+        for (size_t h = 0; h < heads; h++) {
+            Matrix* xh = matrix_view(x, 0, h * d, seq, d);
+            Matrix* ch = matrix_view(stacked, h * seq, 0, seq, seq);
+            matrix_fill(expected, 1.0f);
+            matrix_gemm(MATRIX_NO_TRANS, MATRIX_TRANS, 0.5f, xh, xh, 2.0f, expected);
+            assert(matrix_equal(ch, expected, 1e-5f));
+            matrix_free(xh);
+            matrix_free(ch);
+        }
+        
+        matrix_free(x0);
+        matrix_free(c0);
+        matrix_free(x);
+        matrix_free(stacked);
+        matrix_free(expected);
+    }
+    
+    // Stacked sequences, both operands transposed
+    size_t batch = 6, m = 40, n = 33, k = 57;
+    Matrix* a = matrix_create(batch * k, m);
+    Matrix* b = matrix_create(n, batch * k);
+    Matrix* c = matrix_create(batch * m, n);
+    Matrix* expected = matrix_create(m, n);
+    matrix_random_uniform(a, -1.0f, 1.0f);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    
+    Matrix* a0 = matrix_view(a, 0, 0, k, m);
+    Matrix* b0 = matrix_view(b, 0, 0, n, k);
+    Matrix* c0 = matrix_view(c, 0, 0, m, n);
+    matrix_gemm_batched(MATRIX_TRANS, MATRIX_TRANS, 1.0f, a0, k * a->stride, b0, k,
+                        0.0f, c0, m * c->stride, batch);
+    for (size_t i = 0; i < batch; i++) {
+        Matrix* ai = matrix_view(a, i * k, 0, k, m);
+        Matrix* bi = matrix_view(b, 0, i * k, n, k);
+        Matrix* ci = matrix_view(c, i * m, 0, m, n);
+        matrix_gemm(MATRIX_TRANS, MATRIX_TRANS, 1.0f, ai, bi, 0.0f, expected);
+        assert(matrix_equal(ci, expected, 1e-5f));
+        matrix_free(ai);
+        matrix_free(bi);
+        matrix_free(ci);
+    }
+    
+    printf("Batched GEMM: PASSED\n");
+    
+    // Cleanup
+    matrix_free(a0);
+    matrix_free(b0);
+    matrix_free(c0);
+    matrix_free(a);
+    matrix_free(b);
+    matrix_free(c);
+    matrix_free(expected);
+}
+
+void test_matrix_gemm_backends() {
+    printf("Testing GEMM backend selection...\n");
+    
+    Matrix* a = matrix_create(70, 90);
+    Matrix* b = matrix_create(90, 50);
+    Matrix* expected = matrix_create(70, 50);
+    Matrix* c = matrix_create(70, 50);
+    matrix_random_uniform(a, -1.0f, 1.0f);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    
+    MatrixGemmBackend original = matrix_get_gemm_backend();
+    int rc = matrix_set_gemm_backend(MATRIX_GEMM_BUILTIN);
+    assert(rc == 0);
+    (void)rc;
+    matrix_multiply(a, b, expected);
+    
+    // The BLAS backend is optional; when it is compiled in it must agree
+    if (matrix_set_gemm_backend(MATRIX_GEMM_BLAS) == 0) {
+        assert(matrix_get_gemm_backend() == MATRIX_GEMM_BLAS);
+        matrix_multiply(a, b, c);
+        assert(matrix_equal(c, expected, 1e-4f));
+    }
+    
+    matrix_set_gemm_backend(original);
+    
+    printf("GEMM backend selection: PASSED\n");
+    
+    // Cleanup
+    matrix_free(a);
+    matrix_free(b);
+    matrix_free(expected);
+    matrix_free(c);
+}
+
 void test_matrix_utility_functions() {
     printf("Testing matrix utility functions...\n");
     
@@ -153,13 +391,826 @@ void test_matrix_views() {
     matrix_free(parent);
 }
 
+void test_matrix_aligned_padded() {
+    printf("Testing aligned and padded allocation...\n");
+    
+    // Default policy: aligned base pointer, dense rows
+    Matrix* dense = matrix_create(5, 1024);
+    assert(((uintptr_t)dense->data % MATRIX_DEFAULT_ALIGNMENT) == 0);
+    assert(dense->stride == 1024);
+    assert(matrix_is_contiguous(dense));
+    
+    assert(matrix_set_alignment(48) == -1);
+    int rc = matrix_set_alignment(128);
+    assert(rc == 0);
+    (void)rc;
+    matrix_set_padding(1);
+    
+    // Every row aligned; 4 KiB wide rows get one extra alignment unit
+    Matrix* padded = matrix_create(5, 1024);
+    assert(padded->stride == 1024 + 128 / sizeof(float));
+    Matrix* odd = matrix_create(3, 37);
+    assert(odd->stride == 64);
+    assert(!matrix_is_contiguous(odd));
+    for (size_t i = 0; i < odd->rows; i++) {
+        assert(((uintptr_t)(odd->data + i * odd->stride) % 128) == 0);
+        for (size_t j = 0; j < odd->stride; j++) {
+            assert(odd->data[i * odd->stride + j] == 0.0f);
+        }
+    }
+    
+    // Kernels must ignore the padding
+    matrix_random_uniform(dense, -1.0f, 1.0f);
+    matrix_copy(padded, dense);
+    matrix_fill(odd, 2.0f);
+    assert(fabsf(matrix_sum(odd) - 2.0f * 3 * 37) < 1e-4f);
+    assert(fabsf(matrix_sum(padded) - matrix_sum(dense)) < 1e-2f);
+    
+    Matrix* b = matrix_create(1024, 37);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    Matrix* c_padded = matrix_create(5, 37);
+    Matrix* c_dense = matrix_create_strided(5, 37, 37);
+    matrix_multiply(padded, b, c_padded);
+    matrix_multiply(dense, b, c_dense);
+    assert(matrix_equal(c_padded, c_dense, 1e-4f));
+    
+    printf("Aligned and padded allocation: PASSED\n");
+    
+    matrix_set_padding(0);
+    matrix_set_alignment(MATRIX_DEFAULT_ALIGNMENT);
+    
+    // Cleanup
+    matrix_free(dense);
+    matrix_free(padded);
+    matrix_free(odd);
+    matrix_free(b);
+    matrix_free(c_padded);
+    matrix_free(c_dense);
+}
+
+void test_workspace() {
+    printf("Testing workspace arena...\n");
+    
+    Workspace* ws = workspace_create(0);
+    
+    // Matrices are aligned, freed with the arena rather than matrix_free
+    Matrix* a = workspace_matrix(ws, 7, 13);
+    Matrix* b = workspace_matrix(ws, 3, 5);
+    assert(a->is_workspace && b->is_workspace);
+    assert(((uintptr_t)a->data % matrix_get_alignment()) == 0);
+    assert(((uintptr_t)b->data % matrix_get_alignment()) == 0);
+    assert(b->data >= a->data + a->rows * a->stride);
+    matrix_fill(a, 1.0f);
+    matrix_fill(b, 2.0f);
+    assert(matrix_sum(a) == 7.0f * 13.0f);
+    matrix_free(a);  // No-op
+    
+    // A step that overflows into several blocks is merged into one on reset
+    for (int i = 0; i < 64; i++) {
+        Matrix* big = workspace_matrix(ws, 64, 100);
+        matrix_fill(big, (float)i);
+    }
+    assert(ws->blocks != NULL);
+    workspace_reset(ws);
+    size_t allocs = ws->heap_allocs;
+    
+    // Steady state: the same step no longer touches the heap
+    for (int step = 0; step < 3; step++) {
+        workspace_reset(ws);
+        workspace_matrix(ws, 7, 13);
+        workspace_matrix(ws, 3, 5);
+        for (int i = 0; i < 64; i++) {
+            workspace_matrix(ws, 64, 100);
+        }
+    }
+    assert(ws->heap_allocs == allocs);
+    
+    // Without a workspace the helper falls back to the heap
+    Matrix* heap = workspace_matrix(NULL, 2, 2);
+    assert(!heap->is_workspace);
+    matrix_free(heap);
+    
+    printf("Workspace arena: PASSED\n");
+    
+    // Cleanup
+    workspace_free(ws);
+}
+
+void test_matrix_elementwise_kernels() {
+    printf("Testing elementwise kernels...\n");
+    
+    // 5x37 exercises the vector body and the scalar tail; the view takes the
+    // strided path and must leave the surrounding parent elements alone
+    Matrix* parent = matrix_create(7, 45);
+    matrix_fill(parent, -5.0f);
+    Matrix* views[2] = {matrix_create(5, 37), matrix_view(parent, 1, 3, 5, 37)};
+    Matrix* b = matrix_create(5, 37);
+    float ref[5 * 37], bval[5 * 37];
+    
+    for (int v = 0; v < 2; v++) {
+        Matrix* a = views[v];
+        for (size_t i = 0; i < 5 * 37; i++) {
+            ref[i] = (float)(i % 11) + 0.5f;
+            bval[i] = (float)(i % 7) - 3.0f;
+        }
+        matrix_from_array(a, ref);
+        matrix_from_array(b, bval);
+        
+        matrix_add(a, b);
+        matrix_multiply_elementwise(a, b);
+        matrix_subtract(a, b);
+        matrix_scale(a, 0.5f);
+        matrix_add_scalar(a, 10.0f);
+        matrix_sqrt(a);
+        for (size_t i = 0; i < 5; i++) {
+            for (size_t j = 0; j < 37; j++) {
+                size_t k = i * 37 + j;
+                float expected = sqrtf(((ref[k] + bval[k]) * bval[k] - bval[k]) * 0.5f + 10.0f);
+                assert(fabsf(a->data[i * a->stride + j] - expected) < 1e-5f);
+            }
+        }
+        
+        matrix_copy(a, b);
+        assert(matrix_equal(a, b, 0.0f));
+        matrix_fill(a, 0.0f);
+        assert(matrix_sum(a) == 0.0f);
+        matrix_fill(a, -0.0f);
+        assert(signbit(a->data[a->stride + 36]));
+    }
+    
+    // Parent elements outside the view are untouched
+    assert(parent->data[0] == -5.0f);
+    assert(parent->data[1 * parent->stride + 2] == -5.0f);
+    assert(parent->data[1 * parent->stride + 40] == -5.0f);
+    assert(parent->data[6 * parent->stride + 3] == -5.0f);
+    
+    printf("Elementwise kernels: PASSED\n");
+    
+    // Cleanup
+    matrix_free(views[0]);
+    matrix_free(views[1]);
+    matrix_free(parent);
+    matrix_free(b);
+}
+
+void test_matrix_fused_updates() {
+    printf("Testing fused update primitives...\n");
+    
+    // Contiguous and strided operands, 3x21 so the scalar tail is covered
+    Matrix* parent = matrix_create(4, 30);
+    Matrix* y = matrix_view(parent, 1, 5, 3, 21);
+    Matrix* a = matrix_create(3, 21);
+    Matrix* b = matrix_create(3, 21);
+    float y0[3 * 21], av[3 * 21], bv[3 * 21];
+    for (size_t i = 0; i < 3 * 21; i++) {
+        y0[i] = (float)(i % 5) - 2.0f;
+        av[i] = (float)(i % 9) * 0.25f - 1.0f;
+        bv[i] = (float)(i % 4) + 0.5f;
+    }
+    matrix_from_array(a, av);
+    matrix_from_array(b, bv);
+    
+    matrix_from_array(y, y0);
+    matrix_axpy(y, 2.0f, a);
+    matrix_axpby(y, -0.5f, b, 3.0f);
+    matrix_fma(y, 0.25f, a, b, 0.5f);
+    matrix_addcmul(y, -1.5f, b, b);
+    matrix_addcdiv(y, 0.1f, a, b, 1e-3f);
+    
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 21; j++) {
+            size_t k = i * 21 + j;
+            float e = y0[k] + 2.0f * av[k];
+            e = -0.5f * bv[k] + 3.0f * e;
+            e = 0.25f * av[k] * bv[k] + 0.5f * e;
+            e += -1.5f * bv[k] * bv[k];
+            e += 0.1f * av[k] / (sqrtf(bv[k]) + 1e-3f);
+            assert(fabsf(y->data[i * y->stride + j] - e) < 1e-4f);
+        }
+    }
+    
+    printf("Fused update primitives: PASSED\n");
+    
+    // Cleanup
+    matrix_free(y);
+    matrix_free(parent);
+    matrix_free(a);
+    matrix_free(b);
+}
+
+void test_matrix_reductions() {
+    printf("Testing reductions...\n");
+    
+    // A million-element sum stays close to the double-precision reference
+    Matrix* big = matrix_create(1000, 1000);
+    double reference = 0.0;
+    for (size_t i = 0; i < big->rows * big->cols; i++) {
+        big->data[i] = 0.1f + (float)(i % 1000) * 1e-4f;
+        reference += big->data[i];
+    }
+    assert(fabs(matrix_sum(big) - reference) / reference < 1e-6);
+    
+    big->data[123456] = 7.5f;
+    big->data[654321] = -3.25f;
+    assert(matrix_max(big) == 7.5f);
+    assert(matrix_min(big) == -3.25f);
+    
+    // Strided input takes the row path
+    Matrix* view = matrix_view(big, 10, 3, 500, 777);
+    double view_reference = 0.0;
+    for (size_t i = 0; i < view->rows; i++) {
+        for (size_t j = 0; j < view->cols; j++) {
+            view_reference += view->data[i * view->stride + j];
+        }
+    }
+    assert(fabs(matrix_sum(view) - view_reference) / view_reference < 1e-6);
+    
+    // Deterministic mode: identical bits for any thread count
+    matrix_random_uniform(big, -1.0f, 1.0f);
+    Matrix* target = matrix_create(1000, 1000);
+    matrix_random_uniform(target, 0.0f, 1.0f);
+    matrix_set_deterministic(1);
+    assert(matrix_get_deterministic());
+    float sums[3], losses[3];
+    int threads[3] = {1, 3, 8};
+    for (int t = 0; t < 3; t++) {
+#ifdef _OPENMP
+        omp_set_num_threads(threads[t]);
+#endif
+        (void)threads;
+        sums[t] = matrix_sum(big);
+        losses[t] = mse_loss(big, target);
+    }
+    for (int t = 1; t < 3; t++) {
+        assert(memcmp(&sums[t], &sums[0], sizeof(float)) == 0);
+        assert(memcmp(&losses[t], &losses[0], sizeof(float)) == 0);
+    }
+    matrix_set_deterministic(0);
+    
+    printf("Reductions: PASSED\n");
+    
+    // Cleanup
+    matrix_free(view);
+    matrix_free(big);
+    matrix_free(target);
+}
+
+void test_vec_math() {
+    printf("Testing vectorized exp/tanh/sigmoid/log1p/erf...\n");
+    
+    // 1003 values over [-20, 20], so both the vector body and the tail run
+    enum { N = 1003 };
+    static float x[N], y[N];
+    const float tolerance[] = {1e-6f, 2e-6f, 1e-3f};  // precise, accurate, fast
+    
+    for (int p = VEC_MATH_PRECISE; p <= VEC_MATH_FAST; p++) {
+        VecMathPrecision precision = (VecMathPrecision)p;
+        for (int f = 0; f < 5; f++) {
+            for (size_t i = 0; i < N; i++) {
+                x[i] = -20.0f + 40.0f * (float)i / (N - 1);
+                if (f == 3) x[i] = x[i] > -1.0f ? x[i] : -0.999f;  // log1p domain
+                y[i] = x[i];
+            }
+            switch (f) {
+                case 0: vec_exp(y, N, precision); break;
+                case 1: vec_tanh(y, N, precision); break;
+                case 2: vec_sigmoid(y, N, precision); break;
+                case 3: vec_log1p(y, N, precision); break;
+                default: vec_erf(y, N, precision); break;
+            }
+            for (size_t i = 0; i < N; i++) {
+                double v = x[i];
+                double expected = f == 0 ? exp(v) : f == 1 ? tanh(v) :
+                                  f == 2 ? 1.0 / (1.0 + exp(-v)) : f == 3 ? log1p(v) : erf(v);
+                assert(fabs(y[i] - expected) <= tolerance[p] * fabs(expected) + 1e-30);
+            }
+        }
+        
+        // Small arguments keep their relative accuracy
+        float small[4] = {1e-6f, -3e-5f, 1e-3f, 0.0f};
+        float t[4];
+        memcpy(t, small, sizeof(t));
+        vec_tanh(t, 4, precision);
+        for (int i = 0; i < 4; i++) assert(fabsf(t[i] - small[i]) <= 1e-3f * fabsf(small[i]));
+        memcpy(t, small, sizeof(t));
+        vec_log1p(t, 4, precision);
+        for (int i = 0; i < 4; i++) {
+            assert(fabs(t[i] - log1p(small[i])) <= tolerance[p] * fabs(log1p(small[i])));
+        }
+        
+        // Limits and special values
+        float special[5] = {100.0f, -110.0f, -1.0f, -2.0f, NAN};
+        memcpy(t, special, 2 * sizeof(float));
+        vec_exp(t, 2, precision);
+        assert(isinf(t[0]) && t[1] == 0.0f);
+        float l[3] = {special[2], special[3], special[4]};
+        vec_log1p(l, 3, precision);
+        assert(isinf(l[0]) && l[0] < 0 && isnan(l[1]) && isnan(l[2]));
+        float e[3] = {6.0f, -6.0f, NAN};
+        vec_erf(e, 3, precision);
+        assert(e[0] == 1.0f && e[1] == -1.0f && isnan(e[2]));
+    }
+    
+    printf("Vectorized exp/tanh/sigmoid/log1p/erf: PASSED\n");
+}
+
+void test_matrix_random() {
+    printf("Testing counter-based random numbers...\n");
+    
+    // Same seed, same values
+    Matrix* a = matrix_create(300, 257);
+    Matrix* b = matrix_create(300, 257);
+    random_seed(42);
+    matrix_random_uniform(a, -1.0f, 1.0f);
+    random_seed(42);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    assert(memcmp(a->data, b->data, a->rows * a->stride * sizeof(float)) == 0);
+    
+    // The stream advances, so a second draw differs
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    assert(memcmp(a->data, b->data, a->rows * a->stride * sizeof(float)) != 0);
+    
+    // Any range can be generated on its own
+    RandomStream s = random_stream(7, 3);
+    float all[1000], part[100];
+    random_uniform(&s, all, 1000, 0.0f, 1.0f);
+    assert(s.offset == 1000);
+    random_uniform_at(&s, 0, part, 100, 0.0f, 1.0f);
+    s.offset = 0;
+    random_uniform_at(&s, 333, part, 100, 0.0f, 1.0f);
+    assert(memcmp(part, all + 333, sizeof(part)) == 0);
+    
+    // Independent of the thread count and of the row stride
+    int threads[3] = {1, 2, 4};
+    for (int t = 0; t < 3; t++) {
+#ifdef _OPENMP
+        omp_set_num_threads(threads[t]);
+#endif
+        (void)threads;
+        random_seed(42);
+        matrix_random_uniform(b, -1.0f, 1.0f);
+        assert(memcmp(a->data, b->data, a->rows * a->stride * sizeof(float)) == 0);
+    }
+    matrix_set_padding(1);
+    Matrix* padded = matrix_create(300, 257);
+    matrix_set_padding(0);
+    random_seed(42);
+    matrix_random_uniform(padded, -1.0f, 1.0f);
+    for (size_t i = 0; i < a->rows; i++) {
+        assert(memcmp(padded->data + i * padded->stride, a->data + i * a->stride,
+                      a->cols * sizeof(float)) == 0);
+    }
+    
+    // Moments
+    size_t n = a->rows * a->cols;
+    float mean = matrix_sum(a) / n;
+    float min = 1.0f, max = -1.0f;
+    for (size_t i = 0; i < n; i++) {
+        if (a->data[i] < min) min = a->data[i];
+        if (a->data[i] > max) max = a->data[i];
+    }
+    assert(fabsf(mean) < 0.01f);
+    assert(min >= -1.0f && max < 1.0f);
+    
+    matrix_random_normal(a, 2.0f, 3.0f);
+    double sum = 0.0, sq = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        assert(isfinite(a->data[i]));
+        sum += a->data[i];
+        sq += (double)a->data[i] * a->data[i];
+    }
+    double normal_mean = sum / n;
+    double normal_var = sq / n - normal_mean * normal_mean;
+    assert(fabs(normal_mean - 2.0) < 0.05);
+    assert(fabs(normal_var - 9.0) < 0.2);
+    
+    printf("Random numbers: PASSED\n");
+    
+    // Cleanup
+    matrix_free(a);
+    matrix_free(b);
+    matrix_free(padded);
+}
+
+void test_matrix_reduced_precision() {
+    printf("Testing bf16/f16 storage...\n");
+    
+    // Scalar conversions: exact values, round to nearest even, specials
+    float in[8] = {1.0f, -2.5f, 65504.0f, 1e6f, 5.960464477539063e-8f, 0.0f, INFINITY, NAN};
+    uint16_t h[8];
+    float out[8];
+    vec_f32_to_f16(h, in, 8);
+    vec_f16_to_f32(out, h, 8);
+    assert(h[0] == 0x3C00 && h[1] == 0xC100 && h[2] == 0x7BFF);
+    assert(h[3] == 0x7C00);  // Overflow
+    assert(h[4] == 0x0001);  // Smallest subnormal
+    assert(out[4] == in[4] && out[5] == 0.0f && isinf(out[6]) && isnan(out[7]));
+    
+    float ties[2] = {1.0f + 1.0f / 256.0f, 1.0f + 3.0f / 256.0f};  // Halfway in bf16
+    uint16_t b[2];
+    vec_f32_to_bf16(b, ties, 2);
+    assert(b[0] == 0x3F80 && b[1] == 0x3F82);
+    float nan_in = NAN;
+    vec_f32_to_bf16(b, &nan_in, 1);
+    vec_bf16_to_f32(out, b, 1);
+    assert(isnan(out[0]));
+    
+    // Matrix round trip: the SIMD and scalar paths must agree
+    Matrix* x = matrix_create(37, 53);
+    matrix_random_uniform(x, -4.0f, 4.0f);
+    MatrixDType types[2] = {MATRIX_BF16, MATRIX_F16};
+    float tolerances[2] = {4.0f / 128.0f, 4.0f / 1024.0f};
+    for (int t = 0; t < 2; t++) {
+        Matrix* r = matrix_to_dtype(x, types[t]);
+        assert(r->dtype == types[t] && r->data == NULL && r->data16 != NULL);
+        Matrix* back = matrix_create(x->rows, x->cols);
+        matrix_copy(back, r);
+        assert(matrix_equal(back, x, tolerances[t]));
+        for (size_t i = 0; i < x->rows; i++) {
+            for (size_t j = 0; j < x->cols; j++) {
+                uint16_t one;
+                float v = x->data[i * x->stride + j];
+                if (types[t] == MATRIX_BF16) {
+                    vec_f32_to_bf16(&one, &v, 1);
+                } else {
+                    vec_f32_to_f16(&one, &v, 1);
+                }
+                assert(one == r->data16[i * r->stride + j]);
+            }
+        }
+        
+        // Elementwise ops read the reduced operand widened
+        Matrix* sum = matrix_create(x->rows, x->cols);
+        matrix_add(sum, r);
+        matrix_axpy(sum, 2.0f, r);
+        for (size_t i = 0; i < x->rows * x->cols; i++) {
+            assert(fabsf(sum->data[i] - 3.0f * back->data[i]) < 1e-5f);
+        }
+        
+        matrix_free(sum);
+        matrix_free(back);
+        matrix_free(r);
+    }
+    
+    // GEMM widens while packing, so it matches a float GEMM on the widened
+    // values exactly, for the packed and the small path and every layout
+    size_t sizes[2][3] = {{70, 90, 300}, {5, 7, 9}};
+    for (int s = 0; s < 2; s++) {
+        size_t m = sizes[s][0], n = sizes[s][1], k = sizes[s][2];
+        for (int ta = 0; ta < 2; ta++) {
+            for (int tb = 0; tb < 2; tb++) {
+                Matrix* a = ta ? matrix_create(k, m) : matrix_create(m, k);
+                Matrix* w = tb ? matrix_create(n, k) : matrix_create(k, n);
+                matrix_random_uniform(a, -1.0f, 1.0f);
+                matrix_random_uniform(w, -1.0f, 1.0f);
+                Matrix* a16 = matrix_to_dtype(a, MATRIX_F16);
+                Matrix* w16 = matrix_to_dtype(w, MATRIX_BF16);
+                matrix_copy(a, a16);
+                matrix_copy(w, w16);
+                
+                Matrix* expected = matrix_create(m, n);
+                Matrix* actual = matrix_create(m, n);
+                MatrixTranspose op_a = ta ? MATRIX_TRANS : MATRIX_NO_TRANS;
+                MatrixTranspose op_b = tb ? MATRIX_TRANS : MATRIX_NO_TRANS;
+                matrix_gemm(op_a, op_b, 0.5f, a, w, 0.0f, expected);
+                matrix_gemm(op_a, op_b, 0.5f, a16, w16, 0.0f, actual);
+                assert(matrix_equal(expected, actual, 1e-5f));
+                
+                matrix_free(a);
+                matrix_free(w);
+                matrix_free(a16);
+                matrix_free(w16);
+                matrix_free(expected);
+                matrix_free(actual);
+            }
+        }
+    }
+    
+    printf("bf16/f16 storage: PASSED\n");
+    
+    // Cleanup
+    matrix_free(x);
+}
+
+void test_quantized_gemm() {
+    printf("Testing int8 GEMM...\n");
+    
+    // Weights that are exact multiples of their channel scale quantize
+    // exactly, so the int8 result must match the float product
+    size_t m = 9, k = 131, n = 10;
+    Matrix* w = matrix_create(k, n);
+    Matrix* x = matrix_create(m, k);
+    for (size_t p = 0; p < k; p++) {
+        for (size_t j = 0; j < n; j++) {
+            int v = p == 0 ? 127 : (int)((p * 7 + j * 13) % 255) - 127;
+            w->data[p * w->stride + j] = v * 0.01f * (j + 1);
+        }
+    }
+    for (size_t i = 0; i < m; i++) {
+        for (size_t p = 0; p < k; p++) {
+            int v = (int)((i * 31 + p * 5) % 255) - 127;
+            x->data[i * x->stride + p] = v * 0.5f;
+        }
+    }
+    
+    QuantizedMatrix* q = quantized_matrix_create(w);
+    assert(q->k_padded % QUANT_K_ALIGN == 0 && q->k_padded >= k);
+    for (size_t j = 0; j < n; j++) {
+        assert(fabsf(q->scales[j] - 0.01f * (j + 1)) < 1e-6f);
+    }
+    
+    float bias[10];
+    for (size_t j = 0; j < n; j++) bias[j] = 0.25f * j;
+    
+    float x_scale = quantize_scale(63.5f);
+    int8_t* a = (int8_t*)malloc(m * q->k_padded);
+    quantize_rows(x, x_scale, a, q->k_padded);
+    for (size_t i = 0; i < m; i++) {
+        for (size_t p = k; p < q->k_padded; p++) {
+            assert(a[i * q->k_padded + p] == 0);
+        }
+    }
+    
+    Matrix* actual = matrix_create(m, n);
+    quantized_gemm(m, a, x_scale, q, bias, ACTIVATION_RELU, actual->data, actual->stride);
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double sum = bias[j];
+            for (size_t p = 0; p < k; p++) {
+                sum += (double)x->data[i * x->stride + p] * w->data[p * w->stride + j];
+            }
+            double expected = sum > 0.0 ? sum : 0.0;
+            assert(fabs(actual->data[i * actual->stride + j] - expected) <= 1e-4 * (1.0 + fabs(expected)));
+        }
+    }
+    
+    // Out-of-range inputs saturate instead of wrapping
+    matrix_fill(x, 1000.0f);
+    quantize_rows(x, 1.0f, a, q->k_padded);
+    assert(a[0] == 127);
+    matrix_fill(x, -1000.0f);
+    quantize_rows(x, 1.0f, a, q->k_padded);
+    assert(a[0] == -127);
+    
+    printf("int8 GEMM: PASSED\n");
+    
+    // Cleanup
+    free(a);
+    quantized_matrix_free(q);
+    matrix_free(w);
+    matrix_free(x);
+    matrix_free(actual);
+}
+
+void test_sparse_matrix() {
+    printf("Testing sparse matrices...\n");
+    
+    // Ragged shapes so the BSR blocks hang over both edges; s is n x k
+    size_t m = 21, k = 45, n = 37;
+    float threshold = 0.6f;
+    Matrix* w = matrix_create(n, k);
+    matrix_random_uniform(w, -1.0f, 1.0f);
+    
+    Matrix* pruned = matrix_create(n, k);
+    size_t kept = 0;
+    for (size_t j = 0; j < n; j++) {
+        for (size_t p = 0; p < k; p++) {
+            float v = w->data[j * w->stride + p];
+            int keep = fabsf(v) > threshold;
+            pruned->data[j * pruned->stride + p] = keep ? v : 0.0f;
+            kept += keep;
+        }
+    }
+    
+    // Two row groups, the second one partial
+    Matrix* x = matrix_create(m, k);
+    matrix_random_uniform(x, -1.0f, 1.0f);
+    float bias[37];
+    for (size_t j = 0; j < n; j++) bias[j] = 0.05f * j - 1.0f;
+    
+    Matrix* expected = matrix_create(m, n);
+    matrix_gemm(MATRIX_NO_TRANS, MATRIX_TRANS, 1.0f, x, pruned, 0.0f, expected);
+    for (size_t i = 0; i < m; i++) {
+        float* row = expected->data + i * expected->stride;
+        for (size_t j = 0; j < n; j++) row[j] += bias[j];
+        activate_array(row, n, ACTIVATION_RELU);
+    }
+    
+    SparseMatrix* csr = sparse_from_dense(w, threshold);
+    SparseMatrix* bsr = sparse_bsr_from_dense(w, 4, 8, threshold);
+    assert(csr->format == SPARSE_CSR && csr->blocks == kept);
+    assert(fabsf(sparse_density(csr) - (float)kept / (k * n)) < 1e-6f);
+    assert(bsr->format == SPARSE_BSR && bsr->blocks <= 10 * 6);  // 4 x 8 blocks
+    assert(sparse_density(bsr) >= sparse_density(csr));
+    
+    Matrix* dense = matrix_create(n, k);
+    Matrix* actual = matrix_create(m, n);
+    SparseMatrix* formats[2] = {csr, bsr};
+    for (int f = 0; f < 2; f++) {
+        sparse_to_dense(formats[f], dense);
+        assert(matrix_equal(dense, pruned, 0.0f));
+        
+        sparse_gemm(x, formats[f], actual, bias, ACTIVATION_RELU);
+        assert(matrix_equal(actual, expected, 1e-5f));
+    }
+    
+    // Everything pruned: only the bias is left
+    SparseMatrix* empty = sparse_bsr_from_dense(w, 4, 8, 2.0f);
+    assert(empty->blocks == 0 && sparse_density(empty) == 0.0f);
+    sparse_gemm(x, empty, actual, bias, ACTIVATION_NONE);
+    for (size_t j = 0; j < n; j++) {
+        assert(actual->data[(m - 1) * actual->stride + j] == bias[j]);
+    }
+    
+    printf("Sparse matrices: PASSED\n");
+    
+    // Cleanup
+    sparse_free(csr);
+    sparse_free(bsr);
+    sparse_free(empty);
+    matrix_free(w);
+    matrix_free(pruned);
+    matrix_free(x);
+    matrix_free(expected);
+    matrix_free(dense);
+    matrix_free(actual);
+}
+
+void test_matrix_alloc_policy() {
+    printf("Testing allocation policy...\n");
+    
+    MatrixAllocPolicy policy = {MATRIX_PAGES_HUGE, MATRIX_NUMA_INTERLEAVE};
+    int rc;
+#ifdef __linux__
+    rc = matrix_set_alloc_policy(policy);
+    assert(rc == 0);
+    assert(matrix_get_alloc_policy().pages == MATRIX_PAGES_HUGE);
+    
+    // Large matrices are mapped on huge page boundaries and start zeroed
+    Matrix* large = matrix_create(1024, 1024);
+    assert(((uintptr_t)large->data % MATRIX_LARGE_ALLOC_BYTES) == 0);
+    assert(matrix_sum(large) == 0.0f);
+    
+    // Small ones stay on the heap, with the usual alignment
+    Matrix* small = matrix_create(3, 37);
+    assert(((uintptr_t)small->data % MATRIX_DEFAULT_ALIGNMENT) == 0);
+    
+    // Moving storage keeps the contents
+    matrix_random_uniform(large, -1.0f, 1.0f);
+    Matrix* copy = matrix_create(1024, 1024);
+    matrix_copy(copy, large);
+    policy.numa = MATRIX_NUMA_FIRST_TOUCH;
+    rc = matrix_set_alloc_policy(policy);
+    assert(rc == 0);
+    matrix_reallocate(large);
+    assert(matrix_equal(large, copy, 0.0f));
+    
+    // First touch writes every page; the storage must still read as zero
+    Matrix* touched = matrix_create(1024, 1024);
+    assert(matrix_sum(touched) == 0.0f);
+    
+    matrix_free(large);
+    matrix_free(small);
+    matrix_free(copy);
+    matrix_free(touched);
+#else
+    rc = matrix_set_alloc_policy(policy);
+    assert(rc == -1);
+#endif
+    
+    policy.pages = MATRIX_PAGES_DEFAULT;
+    policy.numa = MATRIX_NUMA_DEFAULT;
+    rc = matrix_set_alloc_policy(policy);
+    assert(rc == 0);
+    (void)rc;
+    
+    printf("Allocation policy: PASSED\n");
+}
+
+void test_cpu_isa() {
+    printf("Testing kernel dispatch...\n");
+    
+    CpuIsa detected = cpu_detect_isa();
+    printf("  detected %s\n", cpu_isa_name(detected));
+    int rc = cpu_set_isa(CPU_ISA_GENERIC);
+    assert(rc == 0);
+    assert(cpu_get_isa() == CPU_ISA_GENERIC);
+    rc = cpu_set_isa(CPU_ISA_COUNT);
+    assert(rc == -1);
+    
+    // Reference results from the generic kernels
+    Matrix* a = matrix_create(67, 129);
+    Matrix* b = matrix_create(129, 45);
+    matrix_random_uniform(a, -1.0f, 1.0f);
+    matrix_random_uniform(b, -1.0f, 1.0f);
+    Matrix* expected = matrix_create(67, 45);
+    matrix_multiply(a, b, expected);
+    activate(expected, ACTIVATION_TANH);
+    float expected_sum = vec_sum(a->data, a->rows * a->cols);
+    
+    QuantizedMatrix* q = quantized_matrix_create(b);
+    int8_t* a8 = (int8_t*)malloc(a->rows * q->k_padded);
+    quantize_rows(a, quantize_scale(1.0f), a8, q->k_padded);
+    float expected_q[67 * 45];
+    quantized_gemm(a->rows, a8, quantize_scale(1.0f), q, NULL, ACTIVATION_NONE, expected_q, 45);
+    
+    // Every level the CPU runs must agree with them; levels above the
+    // detected one are refused
+    Matrix* actual = matrix_create(67, 45);
+    for (int level = CPU_ISA_GENERIC; level < CPU_ISA_COUNT; level++) {
+        if (cpu_set_isa((CpuIsa)level) != 0) {
+            assert(level > (int)detected);
+            continue;
+        }
+        assert(cpu_get_isa() == (CpuIsa)level);
+        
+        matrix_multiply(a, b, actual);
+        activate(actual, ACTIVATION_TANH);
+        assert(matrix_equal(expected, actual, 1e-4f));
+        assert(fabsf(matrix_sum(a) - expected_sum) < 1e-3f);
+        assert(vec_sum(a->data, a->rows * a->cols) == expected_sum);
+        
+        float actual_q[67 * 45];
+        quantized_gemm(a->rows, a8, quantize_scale(1.0f), q, NULL, ACTIVATION_NONE, actual_q, 45);
+        assert(memcmp(expected_q, actual_q, sizeof(actual_q)) == 0);
+    }
+    
+    rc = cpu_set_isa(detected);
+    assert(rc == 0);
+    (void)rc;
+    
+    printf("Kernel dispatch: PASSED\n");
+    
+    // Cleanup
+    matrix_free(a);
+    matrix_free(b);
+    matrix_free(expected);
+    matrix_free(actual);
+    quantized_matrix_free(q);
+    free(a8);
+}
+
+void test_matrix_wrap() {
+    printf("Testing wrapped matrices...\n");
+    
+    // 3 x 4 matrix in a caller buffer with 6 floats per row
+    float buffer[3 * 6];
+    for (int i = 0; i < 3 * 6; i++) buffer[i] = (float)i;
+    
+    Matrix* m = matrix_wrap(buffer, 3, 4, 6);
+    assert(m->data == buffer);
+    assert(m->rows == 3 && m->cols == 4 && m->stride == 6);
+    assert(m->dtype == MATRIX_F32);
+    assert(!matrix_is_contiguous(m));
+    assert(matrix_sum(m) == 0 + 1 + 2 + 3 + 6 + 7 + 8 + 9 + 12 + 13 + 14 + 15);
+    
+    // Writes land in the caller's memory; the padding is untouched
+    matrix_scale(m, 2.0f);
+    assert(buffer[7] == 14.0f);
+    assert(buffer[4] == 4.0f && buffer[5] == 5.0f);
+    
+    Matrix* b = matrix_create(4, 2);
+    matrix_fill(b, 1.0f);
+    Matrix* c = matrix_create(3, 2);
+    matrix_multiply(m, b, c);
+    assert(c->data[c->stride] == 2.0f * (6 + 7 + 8 + 9));
+    
+    // Only the header is freed; the stack buffer stays usable
+    matrix_free(m);
+    assert(buffer[0] == 0.0f && buffer[1] == 2.0f);
+    
+    printf("Wrapped matrices: PASSED\n");
+    
+    // Cleanup
+    matrix_free(b);
+    matrix_free(c);
+}
+
 int main() {
     printf("Running matrix tests...\n\n");
     
     test_matrix_operations();
     test_matrix_multiplication();
+    test_matrix_multiplication_blocked();
+    test_matrix_gemm_transposed();
+    test_matrix_gemm_batched();
+    test_matrix_transpose();
+    test_matrix_gemm_backends();
     test_matrix_utility_functions();
     test_matrix_views();
+    test_matrix_wrap();
+    test_matrix_elementwise_kernels();
+    test_matrix_fused_updates();
+    test_matrix_reductions();
+    test_vec_math();
+    test_matrix_random();
+    test_matrix_reduced_precision();
+    test_quantized_gemm();
+    test_sparse_matrix();
+    test_cpu_isa();
+    test_matrix_aligned_padded();
+    test_matrix_alloc_policy();
+    test_workspace();
     
     printf("\nAll matrix tests PASSED!\n");
     return 0;